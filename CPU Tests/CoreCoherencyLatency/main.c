@@ -2,39 +2,317 @@
  * Program Name: CoherencyLatencyTest
  * File Name: main.c
  * Date Created: November 11, 2024
- * Date Updated: November 11, 2024
- * Version: 0.1
- * Purpose: Test Core-to-Core Latency of Multi-Core CPU's using Coherency checks.
+ * Date Updated: October 18, 2026
+ * Version: 0.2
+ * Purpose: Test Core-to-Core Latency of Multi-Core CPU's using Coherency checks, along with cache line transfer
+ *          bandwidth, contention scaling and latency under background load.
  */
 
 #include <platformCode.h>
 #include <storage.h>
+#include <timing.h>
+#include <histogram.h>
+#include <threadPool.h>
+#include <pairScheduler.h>
+#include <perfCounters.h>
+#include <systemGuard.h>
+#include <asyncWriter.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <pthread.h>
-#include <sys/time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
-#define ITERATIONS 10000000;
+#define ITERATIONS 1000000;
 
-typedef struct LatencyThreadData {
+// Every table is a numProcs x numProcs matrix written to its own .cnc file, rows are proc1 and columns proc2
+#define TABLE_LATENCY 0
+#define TABLE_P50 1
+#define TABLE_P99 2
+#define TABLE_MAX 3
+#define TABLE_CLASS 4
+#define TABLE_CI 5
+#define TABLE_MEASURED 6
+#define TABLE_MHZ 7
+#define TABLE_CORE_CYCLES 8
+#define TABLE_NOISY 9
+#define TABLE_BANDWIDTH 10
+#define TABLE_LOAD_BANDWIDTH 11
+#define TABLE_COUNTERS 12 // One table per PERF_COUNTER value, counts per round trip of both sides together
+#define TABLE_COUNT (TABLE_COUNTERS + PERF_COUNTER_COUNT)
+
+// Adaptive calibration, see CalibratePairs
+#define CALIBRATION_PILOT_ITERATIONS 1000  // Round trips in the pilot run that sizes a pair class's batches
+#define CALIBRATION_BATCH_NS 2000000.0     // Aim for batches of about 2 ms
+#define CALIBRATION_MIN_ITERATIONS 100
+#define CALIBRATION_MIN_BATCHES 5          // Batches before the confidence interval is trusted
+#define CALIBRATION_MAX_BATCHES 1000
+
+// Topology class sampling, see SelectSamplePairs
+#define SAMPLE_PILOT_PAIRS 8               // Pairs per class measured before sizing the class's sample
+
+// Quiescence guard, see CheckPairNoise
+#define GUARD_FREQUENCY_NS 50000           // Each side clocks its core for 50 us right before its handoff loop
+#define GUARD_FREQUENCY_SPREAD 0.05        // Sides whose clocks differ by more than 5% are noisy
+#define GUARD_INTERRUPT_RATE 2000.0        // Interrupts per second on either CPU, well past a 1000 Hz timer tick
+#define GUARD_MAX_LOAD 1.0                 // One minute load average the pre-flight check warns about
+
+// Producer/consumer transfers, see TransferTestThread
+#define TRANSFER_TOTAL_BYTES (64ULL << 20) // Default transfers per run move about this much
+#define TRANSFER_MIN_COUNT 16
+
+// Background load, see RunLoadGenerator
+#define LOAD_READ 0
+#define LOAD_WRITE 1
+#define LOAD_SNOOP 2
+#define LOAD_KIND_COUNT 3
+#define LOAD_LEVEL_MAX 16
+#define LOAD_BUFFER_BYTES (64ULL << 20)   // Per generator, well past any last level cache
+#define LOAD_CHUNK_BYTES (64 << 10)       // Traffic between checks of the stop flag and the duty cycle
+#define LOAD_SNOOP_BYTES (1 << 20)        // Lines the snoop storm fights over, small enough to stay in caches
+
+// Contention scaling, see RunContention
+#define CONTENTION_DURATION_MS 10          // Every thread count runs each kernel for this long
+#define CONTENTION_CHUNK 64                // Operations between clock reads
+#define CONTENTION_PADDING 128             // Bytes between padded lines, keeps the adjacent line prefetcher out
+#define CONTENTION_DOMAIN_LLC 0
+#define CONTENTION_DOMAIN_PACKAGE 1
+#define CONTENTION_DOMAIN_ALL 2
+#define CONTENTION_DOMAIN_COUNT 3
+
+// Each side of a pair gets its own cache lines, so writing its timestamps never disturbs the other side
+typedef struct __attribute__((aligned(64))) LatencyThreadData {
     uint64_t start;
     uint64_t iters;
     volatile uint64_t *target;
     uint32_t processorIndex;
+    uint32_t sampleInterval;      // Record every Nth round trip into histogram, 0 disables sampling
+    uint32_t countEvents;         // Read the worker's performance counters around the handoff loop
+    uint32_t guard;               // Clock the core before the handoff loop
+    double mhz;
+    LatencyHistogram *histogram;  // Allocated by the test thread itself so it's local and off the target line
+    const TimerInfo *timer;
+    void *(*threadFunc)(void *);
+    SpinBarrier *barrier;         // Shared with the other side, released once both are pinned and ready
+    uint64_t begin;               // Timestamps around this side's own handoff loop
+    uint64_t end;
+    struct LatencyThreadData *partner;
+    uint64_t counts[PERF_COUNTER_COUNT]; // Performance counter deltas over this side's handoff loop
+    uint32_t countedMask;         // Bit per PERF_COUNTER value this side's group actually counted
+    uint64_t durationTicks;       // How long a contention thread keeps going, see ContentionLoop
+    uint64_t ops;                 // Operations and failed attempts a contention thread completed
+    uint64_t retries;
+    char *buffer;                 // Two transfer buffers of transferSize bytes back to back, shared with the other side
+    uint64_t transferSize;
+    uint32_t transferRfo;         // The consumer writes every line instead of reading it
+    uint64_t checksum;            // Transfers the consumer saw torn or stale
+    _Atomic uint64_t ack __attribute__((aligned(64))); // Only written by this side, used by the one way kernel
 } LatencyThreadData;
 
 typedef struct LatencyPairRunData {
     uint32_t proc1;
     uint32_t proc2;
     uint64_t iter;
-    double result;
+    double results[TABLE_COUNT];
     uint64_t *target;
+    const TimerInfo *timer;
+    uint32_t sampleInterval;
+    uint32_t countEvents;
+    uint32_t guard;
+    char *buffer;
+    uint64_t transferSize;
+    uint32_t transferRfo;
+    SpinBarrier barrier;
+    LatencyThreadData threads[2];
+    PoolJob jobs[2];
+    LatencyHistogram *histogram;  // Samples from every run of this pair, merged from both sides
+    double latency;               // Round trip latency of the last run
+    double *batchLatencies;       // Per batch latencies when calibrating
+    uint32_t batchCount;
+    double elapsedNs;             // Time spent in the pair's loops so far
+    int calibrated;               // Set once the pair reached its target precision or budget
 } LatencyPairRunData;
 
+typedef struct ResultTable {
+    const char *suffix;  // Appended to the output file path, empty for the main latency table
+    int enabled;
+    double *values;
+    CnCWriter *writer;
+} ResultTable;
+
+ResultTable resultTables[TABLE_COUNT] = {
+    { .suffix = "", .enabled = 1 },
+    { .suffix = "_p50" },
+    { .suffix = "_p99" },
+    { .suffix = "_max" },
+    { .suffix = "_class" },
+    { .suffix = "_ci" },
+    { .suffix = "_measured" },
+    { .suffix = "_mhz" },
+    { .suffix = "_corecycles" },
+    { .suffix = "_noisy" },
+    { .suffix = "_bandwidth" },
+    { .suffix = "_loadbandwidth" },
+    [TABLE_COUNTERS + PERF_COUNTER_CYCLES] = { .suffix = "_cycles" },
+    [TABLE_COUNTERS + PERF_COUNTER_REF_CYCLES] = { .suffix = "_refcycles" },
+    [TABLE_COUNTERS + PERF_COUNTER_INSTRUCTIONS] = { .suffix = "_instructions" },
+    [TABLE_COUNTERS + PERF_COUNTER_CACHE_REFERENCES] = { .suffix = "_cachereferences" },
+    [TABLE_COUNTERS + PERF_COUNTER_CACHE_MISSES] = { .suffix = "_cachemisses" },
+    [TABLE_COUNTERS + PERF_COUNTER_L1D_MISSES] = { .suffix = "_l1dmisses" },
+    [TABLE_COUNTERS + PERF_COUNTER_LLC_MISSES] = { .suffix = "_llcmisses" },
+};
+
+// Rows and progress lines go through the writer thread, so the coordinating thread never waits on a file or the console
+AsyncWriter *resultWriter;
+
+/*
+ * Writes out everything queued on the result writer and shuts it down.  Safe to call when it was never started.
+ */
+void StopResultWriter(void) {
+    if (resultWriter == NULL)
+        return;
+    asyncSync(resultWriter);
+    if (getAsyncDropped(resultWriter) != 0)
+        fprintf(stderr, "The result writer dropped %lu records, some progress lines are missing\n", getAsyncDropped(resultWriter));
+    destroyAsyncWriter(resultWriter);
+    resultWriter = NULL;
+}
+
 /*
- * Tests the latency using a non-locking algorithm.
+ * Ends the run early.  Lines and rows already queued on the result writer are written out first, so the error
+ * shows up after the progress lines that led up to it.
+ * @Param format: printf format string for the error, NULL if it has been reported already.
+ * @return: Will always return -1, for main to return.
+ */
+int AbortRun(const char *format, ...) {
+    StopResultWriter();
+    if (format != NULL) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+    }
+    return -1;
+}
+
+// Every pool worker opens its own counter group the first time it runs a side that wants one, and keeps it until
+// CloseWorkerCounters.  The baseline is what a start and stop with nothing between them counts.
+static __thread PerfCounterGroup workerCounters;
+static __thread uint64_t workerCounterBaseline[PERF_COUNTER_COUNT];
+static __thread int workerCountersOpened;
+
+// Legacy -offset runs and the default run space concurrent pairs a page apart, like the original 512 uint64_t
+#define DEFAULT_PAIR_STRIDE 4096
+#define PLACEMENT_MAX 16
+
+// Special homes for the target line, anything from zero up is a fixed NUMA node
+#define HOME_FIRST_TOUCH -1 // Wherever the main thread first touches it, the original behavior
+#define HOME_PROC1 -2       // On the node of the CPU that makes the first handoff
+#define HOME_PROC2 -3       // On the node of the CPU that answers it
+
+/* Where each pair's target lands: pair p of a batch bounces the uint64_t at region + p * stride + offset. */
+typedef struct Placement {
+    char name[32];  // File suffix, empty writes to the plain output path
+    size_t offset;
+    size_t stride;
+} Placement;
+
+/*
+ * Handoff primitives.  Each one attempts a single handoff on the target: if it holds current - 1 (the other
+ * side's last write) it is replaced with current.
+ * @return: Non zero if the handoff went through.
+ */
+static inline int TryPlainHandoff(volatile uint64_t *target, uint64_t current) {
+    if (*target == current - 1) {
+        *target = current;
+        return 1;
+    }
+    return 0;
+}
+
+static inline int TrySyncCasHandoff(volatile uint64_t *target, uint64_t current) {
+    return __sync_bool_compare_and_swap(target, current - 1, current);
+}
+
+static inline int TryCasStrongHandoff(volatile uint64_t *target, uint64_t current) {
+    uint64_t expected = current - 1;
+    return atomic_compare_exchange_strong((_Atomic uint64_t *)target, &expected, current);
+}
+
+static inline int TryCasWeakHandoff(volatile uint64_t *target, uint64_t current) {
+    uint64_t expected = current - 1;
+    return atomic_compare_exchange_weak((_Atomic uint64_t *)target, &expected, current);
+}
+
+// Only the side whose turn it is ever writes, so the increment always lands on current - 1
+static inline int TryFetchAddHandoff(volatile uint64_t *target, uint64_t current) {
+    _Atomic uint64_t *atomicTarget = (_Atomic uint64_t *)target;
+    if (atomic_load_explicit(atomicTarget, memory_order_acquire) != current - 1)
+        return 0;
+    atomic_fetch_add_explicit(atomicTarget, 1, memory_order_acq_rel);
+    return 1;
+}
+
+static inline int TryExchangeHandoff(volatile uint64_t *target, uint64_t current) {
+    _Atomic uint64_t *atomicTarget = (_Atomic uint64_t *)target;
+    if (atomic_load_explicit(atomicTarget, memory_order_acquire) != current - 1)
+        return 0;
+    atomic_exchange_explicit(atomicTarget, current, memory_order_acq_rel);
+    return 1;
+}
+
+static inline int TryReleaseAcquireHandoff(volatile uint64_t *target, uint64_t current) {
+    _Atomic uint64_t *atomicTarget = (_Atomic uint64_t *)target;
+    if (atomic_load_explicit(atomicTarget, memory_order_acquire) != current - 1)
+        return 0;
+    atomic_store_explicit(atomicTarget, current, memory_order_release);
+    return 1;
+}
+
+static inline int TrySeqCstHandoff(volatile uint64_t *target, uint64_t current) {
+    _Atomic uint64_t *atomicTarget = (_Atomic uint64_t *)target;
+    if (atomic_load_explicit(atomicTarget, memory_order_seq_cst) != current - 1)
+        return 0;
+    atomic_store_explicit(atomicTarget, current, memory_order_seq_cst);
+    return 1;
+}
+
+/*
+ * Same handoff loop as the latency test threads, but every sampleInterval-th round trip is timestamped into
+ * the thread's histogram.  A round trip runs from this thread's write to its next successful handoff.
+ * Always inlined, so the primitive is a constant and never an indirect call.
+ * @Param latencyData: The LatencyThreadData being operated on, sampling is skipped if it has no histogram.
+ * @Param tryHandoff: The handoff primitive to loop on.
+ */
+static inline __attribute__((always_inline)) void SampledLatencyLoop(LatencyThreadData *latencyData,
+                                                                     int (*tryHandoff)(volatile uint64_t *, uint64_t)) {
+    uint64_t current = latencyData->start;
+    uint32_t untilSample = latencyData->histogram != NULL ? latencyData->sampleInterval : 0;
+    LatencyHistogram *histogram = latencyData->histogram;
+    uint64_t stamp = 0;
+    int pending = 0;
+
+    while (current <= 2 * latencyData->iters) {
+        if (tryHandoff(latencyData->target, current)) {
+            current += 2;
+            if (pending) {
+                recordHistogram(histogram, timerRead(latencyData->timer) - stamp);
+                pending = 0;
+            }
+            else if (untilSample != 0 && --untilSample == 0) {
+                stamp = timerRead(latencyData->timer);
+                pending = 1;
+                untilSample = latencyData->sampleInterval;
+            }
+        }
+    }
+}
+
+/*
+ * Tests the latency using a non-locking algorithm.  Runs on a pool worker that is already pinned.
  * @Param param: Pointer to the LatencyThreadData structure to operate on.
  * @return: Will always return NULL.
  */
@@ -42,7 +320,10 @@ void *NoLockLatencyTestThread(void *param) {
     LatencyThreadData *latencyData = (LatencyThreadData *)param;
     uint64_t current = latencyData->start;
 
-    setAffinity(pthread_self(), latencyData->processorIndex);
+    if (latencyData->sampleInterval != 0) {
+        SampledLatencyLoop(latencyData, TryPlainHandoff);
+        return NULL;
+    }
 
     while (current <= 2 * latencyData->iters) {
         if (*(latencyData->target) == current - 1) {
@@ -55,76 +336,265 @@ void *NoLockLatencyTestThread(void *param) {
 } 
 
 /*
- * Run all the tests and gather latency data.
- * @Param proc1: Processor index for the first processor in the test.
- * @Param proc2: Processor index for the second processor in the test.
- * @Param iter: Number of times to iterate over the tests, higher is more accurate.
- * @Param lat1: Pointer to LatencyThreadData for the first processor.
- * @Param lat2: Pointer to LatencyThreadData for the second processor.
- * @Param threadfunc: Function pointer to test across both processors.
- * @return: Latency between both processors.
+ * Runs one side of a pair measurement on the pool worker pinned to its processor.  Both sides line up on the
+ * barrier first, then each one timestamps only its own handoff loop.
+ * @Param param: Pointer to the LatencyThreadData structure to operate on.
+ * @return: Will always return NULL.
  */
-double TimeThreads(uint32_t proc1,
-                  uint32_t proc2,
-                  uint64_t iter,
-                  LatencyThreadData *lat1,
-                  LatencyThreadData *lat2,
-                  void *(*threadFunc)(void *)) {
-    struct timeval startTv, endTv;
-    struct timezone startTz, endTz;
-    pthread_t testThreads[2];
-    int t1rc, t2rc;
-    void *res1, *res2;
+void *TimeThread(void *param) {
+    LatencyThreadData *latencyData = (LatencyThreadData *)param;
 
-    gettimeofday(&startTv, &startTz);
-    t1rc = pthread_create(&testThreads[0], NULL, threadFunc, (void *)lat1);
-    t2rc = pthread_create(&testThreads[1], NULL, threadFunc, (void *)lat2);
-    if (t1rc != 0 || t2rc != 0) {
-      fprintf(stderr, "Could not create threads\n");
-      return 0;
-    }
+    // Allocated here so the histogram is local to this side, and before the barrier so it's never timed.  A side
+    // without one is reported by FinishTest.
+    if (latencyData->sampleInterval != 0)
+        latencyData->histogram = createHistogram();
+
+    // Right before the barrier so it sees the clock the loop is about to run at, and warms the core up for it
+    if (latencyData->guard)
+        latencyData->mhz = measureCoreFrequency(GUARD_FREQUENCY_NS);
 
-    pthread_join(testThreads[0], &res1);
-    pthread_join(testThreads[1], &res2);
-    gettimeofday(&endTv, &endTz);
+    if (latencyData->countEvents && !workerCountersOpened) {
+        openPerfCounters(&workerCounters);
+        if (startPerfCounters(&workerCounters) == 0 && stopPerfCounters(&workerCounters) == 0)
+            memcpy(workerCounterBaseline, workerCounters.values, sizeof(workerCounterBaseline));
+        workerCountersOpened = 1;
+    }
 
-    uint64_t time_diff_ms = 1000 * (endTv.tv_sec - startTv.tv_sec) + ((endTv.tv_usec - startTv.tv_usec) / 1000);
-    double latency = 1e6 * (double)time_diff_ms / (double)iter;
-    return latency;
+    // Both sides start their counters and then line up again, so neither timed loop waits out the other side's
+    // read().  The reads themselves are the baseline taken off, the short spin on the second barrier stays in.
+    spinBarrierWait(latencyData->barrier);
+    if (latencyData->countEvents) {
+        startPerfCounters(&workerCounters);
+        spinBarrierWait(latencyData->barrier);
+    }
+    latencyData->begin = timerBegin(latencyData->timer);
+    latencyData->threadFunc(latencyData);
+    latencyData->end = timerEnd(latencyData->timer);
+    if (latencyData->countEvents && stopPerfCounters(&workerCounters) == 0) {
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++) {
+            if (!isPerfCounterAvailable(&workerCounters, counter))
+                continue;
+            uint64_t count = workerCounters.values[counter];
+            latencyData->counts[counter] = count > workerCounterBaseline[counter] ? count - workerCounterBaseline[counter] : 0;
+            latencyData->countedMask |= 1U << counter;
+        }
+    }
+    return NULL;
 }
 
+/*
+ * Closes the calling pool worker's counter group, if it ever opened one.
+ * @Param param: Unused.
+ * @return: Will always return NULL.
+ */
+void *CloseWorkerCounters(void *param) {
+    (void)param;
+    if (workerCountersOpened)
+        closePerfCounters(&workerCounters);
+    workerCountersOpened = 0;
+    return NULL;
+}
 
 /*
- * Test the latency across two logical processors using the TimeThreads function.
- * @Param param: Pointer to the LatencyThreadData structure to clone for both.
- * @return: Will always return NULL directly, but returns a double in the provided LatencyThreadData.
+ * Queues both sides of a latency test on the already pinned pool workers.
+ * @Param pool: Thread pool with a worker on both processors.
+ * @Param pairRunData: Pointer to the LatencyPairRunData to fill in and run.
+ * @Param threadFunc: Function pointer to test across both processors.
+ * @return: Zero if both sides were queued.
  */
-void *RunTest(void *param) {
-  LatencyPairRunData *pairRunData = (LatencyPairRunData *)param;
-  uint32_t processor1 = pairRunData->proc1;
-  uint32_t processor2 = pairRunData->proc2;
-  uint64_t iter = pairRunData->iter;
-  LatencyThreadData lat1, lat2;
-  double latency;
+int StartTest(ThreadPool *pool, LatencyPairRunData *pairRunData, void *(*threadFunc)(void *)) {
+  uint32_t processors[2] = { pairRunData->proc1, pairRunData->proc2 };
 
   *(pairRunData->target) = 0;
-  lat1.iters = iter;
-  lat1.start = 1;
-  lat1.target = pairRunData->target;
-  lat1.processorIndex = processor1;
-  lat2.iters = iter;
-  lat2.start = 2;
-  lat2.target = pairRunData->target;
-  lat2.processorIndex = processor2;
-  latency = TimeThreads(processor1, processor2, iter, &lat1, &lat2, NoLockLatencyTestThread);
-  fprintf(stderr, "%d to %d: %f ns\n", processor1, processor2, latency);
-  pairRunData->result = latency;
-  return NULL;
+  initSpinBarrier(&pairRunData->barrier, 2);
+  for (int side = 0; side < 2; side++) {
+      LatencyThreadData *lat = &pairRunData->threads[side];
+      memset(lat, 0, sizeof(LatencyThreadData));
+      lat->iters = pairRunData->iter;
+      lat->start = side + 1;
+      lat->target = pairRunData->target;
+      lat->processorIndex = processors[side];
+      lat->sampleInterval = pairRunData->sampleInterval;
+      lat->countEvents = pairRunData->countEvents;
+      lat->guard = pairRunData->guard;
+      lat->buffer = pairRunData->buffer;
+      lat->transferSize = pairRunData->transferSize;
+      lat->transferRfo = pairRunData->transferRfo;
+      lat->timer = pairRunData->timer;
+      lat->threadFunc = threadFunc;
+      lat->barrier = &pairRunData->barrier;
+      initJob(&pairRunData->jobs[side], TimeThread, lat);
+  }
+  pairRunData->threads[0].partner = &pairRunData->threads[1];
+  pairRunData->threads[1].partner = &pairRunData->threads[0];
+
+  // A side queued without its partner spins forever, so the caller has to give up on the run when this fails
+  if (submitJob(pool, processors[0], &pairRunData->jobs[0]) != 0 ||
+      submitJob(pool, processors[1], &pairRunData->jobs[1]) != 0)
+      return -1;
+  return 0;
+}
+
+/*
+ * Waits for both sides of a latency test and gathers the results.
+ * @Param pairRunData: Pointer to a LatencyPairRunData started with StartTest.
+ */
+void FinishTest(LatencyPairRunData *pairRunData) {
+  LatencyThreadData *lat1 = &pairRunData->threads[0];
+  LatencyThreadData *lat2 = &pairRunData->threads[1];
+  TimerResult elapsed;
+
+  waitJob(&pairRunData->jobs[0]);
+  waitJob(&pairRunData->jobs[1]);
+
+  // Each side's loop covers every handoff, the longer one is the one that also waited out the last handoff
+  if (lat1->end - lat1->begin > lat2->end - lat2->begin)
+      timerElapsed(pairRunData->timer, lat1->begin, lat1->end, &elapsed);
+  else
+      timerElapsed(pairRunData->timer, lat2->begin, lat2->end, &elapsed);
+  pairRunData->latency = elapsed.nanoseconds / (double)pairRunData->iter;
+  pairRunData->elapsedNs += elapsed.nanoseconds;
+  pairRunData->results[TABLE_LATENCY] = pairRunData->latency;
+  if (pairRunData->transferSize != 0) {
+      pairRunData->results[TABLE_BANDWIDTH] = pairRunData->transferSize / pairRunData->latency;
+      if (lat2->checksum != 0)
+          asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d to %d: %lu transfers arrived torn\n", pairRunData->proc1,
+                     pairRunData->proc2, lat2->checksum);
+  }
+  if (pairRunData->guard)
+      pairRunData->results[TABLE_MHZ] = (lat1->mhz + lat2->mhz) / 2;
+  // A side whose group couldn't open an event the probe could has no count for it, so the cell is NaN and not 0
+  for (int counter = 0; counter < PERF_COUNTER_COUNT && pairRunData->countEvents; counter++)
+      pairRunData->results[TABLE_COUNTERS + counter] = (lat1->countedMask & lat2->countedMask & (1U << counter)) ?
+          (lat1->counts[counter] + lat2->counts[counter]) / (double)pairRunData->iter : NAN;
+
+  // Both threads sampled the same round trips from opposite ends, so their histograms describe one distribution.
+  // Repeated runs of the pair keep adding to the same one.
+  LatencyHistogram *sides[2] = { lat1->histogram, lat2->histogram };
+  for (int side = 0; side < 2; side++) {
+      if (sides[side] == NULL) {
+          if (pairRunData->sampleInterval != 0)
+              asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d to %d: could not allocate a histogram, one side isn't sampled\n",
+                         pairRunData->proc1, pairRunData->proc2);
+          continue;
+      }
+      if (pairRunData->histogram == NULL)
+          pairRunData->histogram = sides[side];
+      else {
+          mergeHistogram(pairRunData->histogram, sides[side]);
+          destroyHistogram(sides[side]);
+      }
+  }
+  if (pairRunData->histogram != NULL) {
+      double ticksPerNs = pairRunData->timer->ticksPerNs;
+      pairRunData->results[TABLE_P50] = histogramPercentile(pairRunData->histogram, 50) / ticksPerNs;
+      pairRunData->results[TABLE_P99] = histogramPercentile(pairRunData->histogram, 99) / ticksPerNs;
+      pairRunData->results[TABLE_MAX] = histogramPercentile(pairRunData->histogram, 100) / ticksPerNs;
+  }
+}
+
+/*
+ * Calibration settings, see CalibratePairs.
+ */
+typedef struct CalibrationConfig {
+    double targetRelativeCI;  // Stop once the 95% confidence interval half width is this fraction of the mean
+    double budgetNs;          // Stop once a pair has spent this long in its loops, whatever the precision
+    uint64_t maxIterations;   // Upper bound on the round trips in a single batch
+    double classEstimate[PAIR_CLASS_COUNT]; // Pilot latency per pair class, 0 until a pilot has run
+} CalibrationConfig;
+
+/*
+ * Runs every pair of a batch as repeated short batches instead of one long run.  The first pair of each
+ * topology class gets a pilot run that sizes the batches for the whole class, so every batch lasts about
+ * CALIBRATION_BATCH_NS.  Pairs stop on their own once consecutive batches agree to the target relative
+ * confidence interval, or their time budget runs out.  Latency becomes the mean of the batches, and the
+ * confidence interval half width goes to TABLE_CI.
+ * @Param pool: Thread pool with a worker on every processor.
+ * @Param pairRunData: Pairs to measure, filled in as for StartTest.
+ * @Param pairCount: Number of pairs in pairRunData.
+ * @Param threadFunc: Function pointer to test across both processors.
+ * @Param topology: Used to look up the class of every pair.
+ * @Param calibration: Settings and the per class pilot results, which carry over between calls.
+ * @return: Zero if every run could be queued.
+ */
+int CalibratePairs(ThreadPool *pool, LatencyPairRunData *pairRunData, int pairCount, void *(*threadFunc)(void *),
+                   const CpuTopology *topology, CalibrationConfig *calibration) {
+    // Pilot every class this batch is the first to see, all together since the pairs are disjoint anyway
+    int piloted[PAIR_CLASS_COUNT] = { 0 };
+    int pilots = 0;
+    for (int idx = 0; idx < pairCount; idx++) {
+        int pairClass = getPairClass(topology, pairRunData[idx].proc1, pairRunData[idx].proc2);
+        pairRunData[idx].iter = CALIBRATION_PILOT_ITERATIONS;
+        if (calibration->classEstimate[pairClass] == 0 && !piloted[pairClass]) {
+            piloted[pairClass] = 1;
+            if (StartTest(pool, pairRunData + idx, threadFunc) != 0)
+                return -1;
+            pilots++;
+        }
+    }
+    for (int idx = 0; idx < pairCount && pilots != 0; idx++) {
+        int pairClass = getPairClass(topology, pairRunData[idx].proc1, pairRunData[idx].proc2);
+        if (piloted[pairClass] == 1) {
+            FinishTest(pairRunData + idx);
+            calibration->classEstimate[pairClass] = pairRunData[idx].latency > 0 ? pairRunData[idx].latency : 1;
+            piloted[pairClass] = 2;
+        }
+    }
+
+    for (int idx = 0; idx < pairCount; idx++) {
+        LatencyPairRunData *pair = &pairRunData[idx];
+        double estimate = calibration->classEstimate[getPairClass(topology, pair->proc1, pair->proc2)];
+        double batchIterations = CALIBRATION_BATCH_NS / estimate;
+        if (batchIterations < CALIBRATION_MIN_ITERATIONS)
+            batchIterations = CALIBRATION_MIN_ITERATIONS;
+        if (batchIterations > calibration->maxIterations)
+            batchIterations = calibration->maxIterations;
+        pair->iter = (uint64_t)batchIterations;
+        pair->batchCount = 0;
+        pair->elapsedNs = 0;
+        pair->calibrated = 0;
+        pair->batchLatencies = (double *)malloc(sizeof(double) * CALIBRATION_MAX_BATCHES);
+        if (pair->batchLatencies == NULL)
+            return -1;
+    }
+
+    int remaining = pairCount;
+    while (remaining != 0) {
+        for (int idx = 0; idx < pairCount; idx++)
+            if (!pairRunData[idx].calibrated && StartTest(pool, pairRunData + idx, threadFunc) != 0)
+                return -1;
+
+        for (int idx = 0; idx < pairCount; idx++) {
+            LatencyPairRunData *pair = &pairRunData[idx];
+            if (pair->calibrated)
+                continue;
+            FinishTest(pair);
+            pair->batchLatencies[pair->batchCount++] = pair->latency;
+            if (pair->batchCount < CALIBRATION_MIN_BATCHES)
+                continue;
+
+            BenchmarkStats stats;
+            computeStats(pair->batchLatencies, pair->batchCount, 0, &stats, NULL);
+            pair->results[TABLE_LATENCY] = stats.mean;
+            pair->results[TABLE_CI] = stats.ciHalfWidth;
+            if (stats.ciHalfWidth <= calibration->targetRelativeCI * stats.mean ||
+                pair->elapsedNs >= calibration->budgetNs || pair->batchCount == CALIBRATION_MAX_BATCHES) {
+                pair->calibrated = 1;
+                remaining--;
+            }
+        }
+    }
+
+    for (int idx = 0; idx < pairCount; idx++) {
+        free(pairRunData[idx].batchLatencies);
+        pairRunData[idx].batchLatencies = NULL;
+    }
+    return 0;
 }
 
 
 /*
- * Tests the latency using a locking algorithm.
+ * Tests the latency using a locking algorithm.  Runs on a pool worker that is already pinned.
  * @Param param: Pointer to the LatencyThreadData structure to operate on.
  * @return: Will always return NULL.
  */
@@ -132,8 +602,10 @@ void *LatencyTestThread(void *param) {
     LatencyThreadData *latencyData = (LatencyThreadData *)param;
     uint64_t current = latencyData->start;
 
-    setAffinity(pthread_self(), latencyData->processorIndex);
-    //fprintf(stderr, "thread %ld set affinity %d\n", gettid(), latencyData->processorIndex);
+    if (latencyData->sampleInterval != 0) {
+        SampledLatencyLoop(latencyData, TrySyncCasHandoff);
+        return NULL;
+    }
 
     while (current <= 2 * latencyData->iters) {
         if (__sync_bool_compare_and_swap(latencyData->target, current - 1, current)) current += 2;
@@ -142,27 +614,1111 @@ void *LatencyTestThread(void *param) {
     return NULL;
 }
 
-void *(*testFunc)(void *) = LatencyTestThread;
+/*
+ * Ping-pong loop shared by the C11 atomics kernels, inlined into each one with its primitive.
+ * @Param param: Pointer to the LatencyThreadData structure to operate on.
+ * @Param tryHandoff: The handoff primitive to loop on.
+ */
+static inline __attribute__((always_inline)) void HandoffLoop(void *param, int (*tryHandoff)(volatile uint64_t *, uint64_t)) {
+    LatencyThreadData *latencyData = (LatencyThreadData *)param;
+    uint64_t current = latencyData->start;
+
+    if (latencyData->sampleInterval != 0) {
+        SampledLatencyLoop(latencyData, tryHandoff);
+        return;
+    }
+
+    while (current <= 2 * latencyData->iters) {
+        if (tryHandoff(latencyData->target, current)) current += 2;
+    }
+}
+
+void *CasStrongLatencyTestThread(void *param) { HandoffLoop(param, TryCasStrongHandoff); return NULL; }
+void *CasWeakLatencyTestThread(void *param) { HandoffLoop(param, TryCasWeakHandoff); return NULL; }
+void *FetchAddLatencyTestThread(void *param) { HandoffLoop(param, TryFetchAddHandoff); return NULL; }
+void *ExchangeLatencyTestThread(void *param) { HandoffLoop(param, TryExchangeHandoff); return NULL; }
+void *ReleaseAcquireLatencyTestThread(void *param) { HandoffLoop(param, TryReleaseAcquireHandoff); return NULL; }
+void *SeqCstLatencyTestThread(void *param) { HandoffLoop(param, TrySeqCstHandoff); return NULL; }
+
+/*
+ * Tests one way latency with a producer/consumer flag.  Unlike the ping-pong kernels every line has a single
+ * writer: the first side publishes a sequence number on the target line and the second side acknowledges it
+ * on its own ack line, so a round trip is two plain one way transfers without any line changing owners.
+ * @Param param: Pointer to the LatencyThreadData structure to operate on.
+ * @return: Will always return NULL.
+ */
+void *OneWayLatencyTestThread(void *param) {
+    LatencyThreadData *latencyData = (LatencyThreadData *)param;
+    _Atomic uint64_t *flag = (_Atomic uint64_t *)latencyData->target;
+
+    if (latencyData->start != 1) {
+        for (uint64_t sequence = 1; sequence <= latencyData->iters; sequence++) {
+            while (atomic_load_explicit(flag, memory_order_acquire) != sequence);
+            atomic_store_explicit(&latencyData->ack, sequence, memory_order_release);
+        }
+        return NULL;
+    }
+
+    // Only the producer sees whole round trips, so only its histogram gets samples
+    _Atomic uint64_t *ack = &latencyData->partner->ack;
+    uint32_t untilSample = latencyData->histogram != NULL ? latencyData->sampleInterval : 0;
+    for (uint64_t sequence = 1; sequence <= latencyData->iters; sequence++) {
+        uint64_t stamp = 0;
+        int sampled = untilSample != 0 && --untilSample == 0;
+        if (sampled)
+            stamp = timerRead(latencyData->timer);
+        atomic_store_explicit(flag, sequence, memory_order_release);
+        while (atomic_load_explicit(ack, memory_order_acquire) != sequence);
+        if (sampled) {
+            recordHistogram(latencyData->histogram, timerRead(latencyData->timer) - stamp);
+            untilSample = latencyData->sampleInterval;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Moves whole buffers from the producer (proc1) to the consumer (proc2) instead of a single line.  The producer
+ * fills a buffer with the transfer's sequence number and publishes it with a release store to the target line,
+ * the consumer reads every word (or writes every line with -rfo) and acknowledges it on its own ack line.  Two
+ * buffers take turns, so the producer fills the next one while the consumer is still pulling the last.  A round
+ * trip is one transfer, so the latency table holds ns per buffer.
+ * @Param param: Pointer to the LatencyThreadData structure to operate on.
+ * @return: Will always return NULL.
+ */
+void *TransferTestThread(void *param) {
+    LatencyThreadData *latencyData = (LatencyThreadData *)param;
+    _Atomic uint64_t *published = (_Atomic uint64_t *)latencyData->target;
+    uint64_t words = latencyData->transferSize / sizeof(uint64_t);
+
+    if (latencyData->start != 1) {
+        uint64_t torn = 0;
+        for (uint64_t sequence = 1; sequence <= latencyData->iters; sequence++) {
+            uint64_t *buffer = (uint64_t *)(latencyData->buffer + (sequence & 1) * latencyData->transferSize);
+            while (atomic_load_explicit(published, memory_order_acquire) < sequence);
+            if (latencyData->transferRfo) {
+                for (uint64_t word = 0; word < words; word += 8)
+                    torn += buffer[word]++ != sequence;
+            }
+            else {
+                uint64_t sum = 0;
+                for (uint64_t word = 0; word < words; word++)
+                    sum += buffer[word];
+                torn += sum != sequence * words;
+            }
+            atomic_store_explicit(&latencyData->ack, sequence, memory_order_release);
+        }
+        latencyData->checksum = torn;
+        return NULL;
+    }
+
+    // A buffer is free again once the consumer acknowledged the transfer before the last one
+    _Atomic uint64_t *ack = &latencyData->partner->ack;
+    for (uint64_t sequence = 1; sequence <= latencyData->iters; sequence++) {
+        uint64_t *buffer = (uint64_t *)(latencyData->buffer + (sequence & 1) * latencyData->transferSize);
+        while (atomic_load_explicit(ack, memory_order_acquire) + 2 < sequence);
+        for (uint64_t word = 0; word < words; word++)
+            buffer[word] = sequence;
+        atomic_store_explicit(published, sequence, memory_order_release);
+    }
+    while (atomic_load_explicit(ack, memory_order_acquire) != latencyData->iters);
+    return NULL;
+}
+
+typedef struct LatencyKernel {
+    const char *name;
+    const char *description;
+    void *(*threadFunc)(void *);
+} LatencyKernel;
+
+// Selected by name with -kernel, and recorded in the metadata of every output file
+const LatencyKernel latencyKernels[] = {
+    { "lock", "__sync_bool_compare_and_swap ping-pong", LatencyTestThread },
+    { "nolock", "volatile load and store ping-pong", NoLockLatencyTestThread },
+    { "cas_strong", "atomic_compare_exchange_strong ping-pong", CasStrongLatencyTestThread },
+    { "cas_weak", "atomic_compare_exchange_weak ping-pong", CasWeakLatencyTestThread },
+    { "fetch_add", "acquire load then atomic_fetch_add ping-pong", FetchAddLatencyTestThread },
+    { "exchange", "acquire load then atomic_exchange ping-pong", ExchangeLatencyTestThread },
+    { "relacq", "acquire load and release store ping-pong", ReleaseAcquireLatencyTestThread },
+    { "seqcst", "seq_cst load and seq_cst store ping-pong", SeqCstLatencyTestThread },
+    { "oneway", "release/acquire flag with a separate ack line", OneWayLatencyTestThread },
+    { "transfer", "double buffered producer/consumer transfers, set the size with -transfer", TransferTestThread },
+};
+#define KERNEL_COUNT (sizeof(latencyKernels) / sizeof(latencyKernels[0]))
+
+/*
+ * Looks up a kernel by name.
+ * @return: The kernel, or NULL if there is none by that name.
+ */
+const LatencyKernel *FindKernel(const char *name) {
+    for (size_t k = 0; k < KERNEL_COUNT; k++)
+        if (strcmp(latencyKernels[k].name, name) == 0)
+            return &latencyKernels[k];
+    return NULL;
+}
+
+/*
+ * Opens a streaming writer for every enabled result table.
+ * @Param basePath: Output path the table suffixes are appended to.
+ * @Param numProcs: Number of processors, the row and column count of every table.
+ * @Param names: Column names shared by every table.
+ * @Param format: CNC_FORMAT_TEXT or CNC_FORMAT_BINARY.
+ * @Param metadata: Written to the header of every table.
+ * @return: Zero if every table was opened.
+ */
+int OpenResultTables(const char *basePath, int numProcs, char (*names)[256], uint8_t format, const char *metadata) {
+    for (int t = 0; t < TABLE_COUNT; t++) {
+        if (!resultTables[t].enabled) continue;
+        char tablePath[256];
+        snprintf(tablePath, sizeof(tablePath), "%s%s", basePath, resultTables[t].suffix);
+        memset(resultTables[t].values, 0, sizeof(double) * numProcs * numProcs);
+        resultTables[t].writer = open_CNC(tablePath, numProcs, names, format, metadata);
+        if (resultTables[t].writer == NULL || setAsyncStream(resultWriter, t, resultTables[t].writer) != 0) {
+            fprintf(stderr, "Could not open %s.cnc for writing\n", tablePath);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Queues one completed row of every enabled result table for the writer thread.  Rows are copied into the ring,
+ * so the tables can be refilled right away.  This runs between rounds, so a full ring waits for the writer
+ * instead of losing the row.
+ * @Param row: The row (proc1 index) to append.
+ * @Param numProcs: Number of processors.
+ */
+void AppendResultRow(int row, int numProcs) {
+    for (int t = 0; t < TABLE_COUNT; t++) {
+        if (!resultTables[t].enabled) continue;
+        if (asyncAppendRowBlocking(resultWriter, 0, t, resultTables[t].values + row * numProcs) != 0)
+            asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Could not queue row %d of %s\n", row, resultTables[t].suffix);
+    }
+}
+
+/*
+ * Flushes or closes every enabled result table.  Flushes are queued behind the rows for the writer thread, closing
+ * waits for the writer thread to catch up first.
+ * @Param close: Close the writers instead of only flushing them.
+ * @return: Zero if every table was written successfully.
+ */
+int FinishResultTables(int close) {
+    int status = 0;
+    if (close)
+        asyncSync(resultWriter);
+    for (int t = 0; t < TABLE_COUNT; t++) {
+        if (!resultTables[t].enabled) continue;
+        if (!close) {
+            asyncFlushBlocking(resultWriter, 0, t);
+            continue;
+        }
+        setAsyncStream(resultWriter, t, NULL);
+        if (close_CNC(resultTables[t].writer) != 0)
+            status = -1;
+        resultTables[t].writer = NULL;
+    }
+    return status;
+}
+
+/*
+ * Appends one placement to the sweep.
+ * @return: The new placement count, or -1 if there is no room for it.
+ */
+static int AddPlacement(Placement *placements, int count, const char *name, size_t offset, size_t stride) {
+    if (count < 0)
+        return count;
+    if (count == PLACEMENT_MAX) {
+        fprintf(stderr, "At most %d placements can run, %s doesn't fit\n", PLACEMENT_MAX, name);
+        return -1;
+    }
+    snprintf(placements[count].name, sizeof(placements[count].name), "%s", name);
+    placements[count].offset = offset;
+    placements[count].stride = stride;
+    return count + 1;
+}
+
+/*
+ * Expands a comma separated list of sweep presets into placements.
+ *   inline: every 8 byte offset inside one line, concurrent pairs a page apart.
+ *   line:   concurrent pairs on adjacent lines, so they share a 128 byte sector and the adjacent line prefetcher.
+ *   sector: concurrent pairs on adjacent 128 byte sectors.
+ *   page:   concurrent pairs a page apart.
+ *   set:    concurrent pairs one last level cache way apart, so they index the same set.  Caches are physically
+ *           indexed, so this only holds past a page when the region is backed by huge pages, see main.
+ *   all:    every preset above.
+ * line, sector, page and set only move concurrent pairs apart, so they are skipped with a single pair at a time.
+ * @Param sweep: The preset list.
+ * @Param topology: Supplies the last level cache geometry for the set preset.
+ * @Param parallelism: Pairs running at the same time.
+ * @Param placements: Array of PLACEMENT_MAX placements to fill.
+ * @return: Number of placements, 0 if the list has an unknown preset or doesn't fit.
+ */
+static int ParseSweep(const char *sweep, const CpuTopology *topology, int parallelism, Placement *placements) {
+    char list[256], name[32];
+    int count = 0;
+    snprintf(list, sizeof(list), "%s", sweep);
+
+    for (char *preset = strtok(list, ","); preset != NULL; preset = strtok(NULL, ",")) {
+        int all = strcmp(preset, "all") == 0, known = all;
+        if (all || strcmp(preset, "inline") == 0) {
+            for (size_t offset = 0; offset < 64; offset += sizeof(uint64_t)) {
+                snprintf(name, sizeof(name), "_inline%zu", offset);
+                count = AddPlacement(placements, count, name, offset, DEFAULT_PAIR_STRIDE);
+            }
+            known = 1;
+        }
+        if (parallelism < 2 && (strcmp(preset, "line") == 0 || strcmp(preset, "sector") == 0 ||
+                                strcmp(preset, "page") == 0 || strcmp(preset, "set") == 0)) {
+            fprintf(stderr, "Skipping the %s placement, it only moves concurrent pairs apart and needs -parallel 2 or more\n", preset);
+            continue;
+        }
+        if (all && parallelism < 2) {
+            fprintf(stderr, "Only sweeping inline placements, the others need -parallel 2 or more\n");
+            all = 0;
+        }
+        if (all || strcmp(preset, "line") == 0) {
+            count = AddPlacement(placements, count, "_line", 0, 64);
+            known = 1;
+        }
+        if (all || strcmp(preset, "sector") == 0) {
+            count = AddPlacement(placements, count, "_sector", 0, 128);
+            known = 1;
+        }
+        if (all || strcmp(preset, "page") == 0) {
+            count = AddPlacement(placements, count, "_page", 0, DEFAULT_PAIR_STRIDE);
+            known = 1;
+        }
+        if (all || strcmp(preset, "set") == 0) {
+            const CacheInfo *llc = topology->llcLevel > 0 ? &topology->caches[topology->llcLevel - 1] : NULL;
+            size_t wayStride = (llc != NULL && llc->sets != 0) ? (size_t)llc->sets * llc->lineSize : DEFAULT_PAIR_STRIDE;
+            snprintf(name, sizeof(name), "_set%zu", wayStride);
+            count = AddPlacement(placements, count, name, 0, wayStride);
+            known = 1;
+        }
+        if (!known) {
+            fprintf(stderr, "Unknown sweep preset %s\n", preset);
+            return 0;
+        }
+    }
+    return count < 0 ? 0 : count;
+}
+
+/*
+ * Flags the pairs of a batch that ran on a noisy system: either CPU took interrupts faster than
+ * GUARD_INTERRUPT_RATE, or the two sides clocked more than GUARD_FREQUENCY_SPREAD apart.  Also converts
+ * every latency to core cycles at the pair's measured clock.  Noisy pairs are moved to the front, and when
+ * they are going to be retried, reset so they can be run again.
+ * @Param pairRunData: Pairs of the batch, all measured with the guard on.
+ * @Param pairCount: Number of pairs in pairRunData.
+ * @Param interruptsBefore: Interrupt counts by CPU ID from before the batch.
+ * @Param interruptsAfter: Interrupt counts by CPU ID from after the batch.
+ * @Param batchNs: Wall time the batch took.
+ * @Param iter: Iterations to reset retried pairs to.
+ * @Param retry: Reset the noisy pairs for another run.
+ * @return: Number of noisy pairs.
+ */
+int CheckPairNoise(LatencyPairRunData *pairRunData, int pairCount, const uint64_t *interruptsBefore,
+                   const uint64_t *interruptsAfter, double batchNs, uint64_t iter, int retry) {
+    int noisyCount = 0;
+    for (int idx = 0; idx < pairCount; idx++) {
+        LatencyPairRunData *pair = &pairRunData[idx];
+        double mhz1 = pair->threads[0].mhz, mhz2 = pair->threads[1].mhz;
+        double spread = fabs(mhz1 - mhz2) / (mhz1 > mhz2 ? mhz1 : mhz2);
+        uint64_t interrupts1 = interruptsAfter[pair->proc1] - interruptsBefore[pair->proc1];
+        uint64_t interrupts2 = interruptsAfter[pair->proc2] - interruptsBefore[pair->proc2];
+        double rate = (interrupts1 > interrupts2 ? interrupts1 : interrupts2) * 1e9 / batchNs;
+
+        pair->results[TABLE_CORE_CYCLES] = pair->results[TABLE_LATENCY] * pair->results[TABLE_MHZ] / 1000.0;
+        pair->results[TABLE_NOISY] = spread > GUARD_FREQUENCY_SPREAD || rate > GUARD_INTERRUPT_RATE;
+        if (pair->results[TABLE_NOISY] == 0)
+            continue;
+        asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d to %d is noisy: %.0f MHz vs %.0f MHz, %.0f interrupts/s\n", pair->proc1, pair->proc2, mhz1, mhz2, rate);
+
+        if (idx != noisyCount) {
+            LatencyPairRunData swap = pairRunData[noisyCount];
+            pairRunData[noisyCount] = *pair;
+            *pair = swap;
+            pair = &pairRunData[noisyCount];
+        }
+        noisyCount++;
+        if (retry) {
+            destroyHistogram(pair->histogram);
+            pair->histogram = NULL;
+            pair->elapsedNs = 0;
+            pair->iter = iter;
+        }
+    }
+    return noisyCount;
+}
+
+/*
+ * Checks the system before a guarded run: cpufreq governors and clocks of every CPU under test, and the load
+ * average.  Everything it finds is only reported, the in-run guard decides what gets retried.
+ * @Param procIds: CPU IDs under test.
+ * @Param numProcs: Number of entries in procIds.
+ * @return: Number of warnings.
+ */
+int PreflightCheck(const int *procIds, int numProcs) {
+    int warnings = 0, governed = 0, otherGovernors = 0;
+    double minMHz = 0, maxMHz = 0;
+    CpuFrequencyInfo info, first;
+    for (int i = 0; i < numProcs; i++) {
+        if (getCpuFrequencyInfo(procIds[i], &info) != 0)
+            continue;
+        if (governed++ == 0) {
+            first = info;
+            minMHz = maxMHz = info.currentMHz;
+        }
+        if (strcmp(info.governor, first.governor) != 0)
+            otherGovernors++;
+        if (info.currentMHz < minMHz)
+            minMHz = info.currentMHz;
+        if (info.currentMHz > maxMHz)
+            maxMHz = info.currentMHz;
+    }
+
+    if (governed == 0)
+        fprintf(stderr, "Pre-flight: cpufreq is not exposed, clocks will only be measured\n");
+    else {
+        fprintf(stderr, "Pre-flight: %s governor, %.0f to %.0f MHz requested\n", first.governor, minMHz, maxMHz);
+        if (strcmp(first.governor, "performance") != 0 || otherGovernors != 0) {
+            fprintf(stderr, "Warning: %d CPUs are not on one performance governor, clocks may ramp during the run\n",
+                    otherGovernors != 0 ? otherGovernors : governed);
+            warnings++;
+        }
+        if (maxMHz > minMHz * (1 + GUARD_FREQUENCY_SPREAD)) {
+            fprintf(stderr, "Warning: requested clocks differ by more than %.0f%%\n", GUARD_FREQUENCY_SPREAD * 100);
+            warnings++;
+        }
+    }
+
+    double load;
+    if (getLoadAverage(&load) == 0) {
+        fprintf(stderr, "Pre-flight: load average %.2f\n", load);
+        if (load > GUARD_MAX_LOAD) {
+            fprintf(stderr, "Warning: the system is busy, expect noisy pairs\n");
+            warnings++;
+        }
+    }
+    return warnings;
+}
+
+/*
+ * Sampling settings and the per class pair lists, see BuildClassSamples.
+ */
+typedef struct SampleConfig {
+    double targetRelativeCI;  // Size each class's sample so the 95% confidence interval of its mean is within this fraction
+    int maxPairs;             // Most distinct pairs measured per class
+    int symmetricPairs;       // Sampled pairs per class that also get measured in the reverse direction
+    uint64_t seed;
+    int pairCount[PAIR_CLASS_COUNT];     // Candidate pairs in each class
+    SchedulePair *pairs[PAIR_CLASS_COUNT]; // Shuffled, so any prefix is a uniform random sample
+    int selected[PAIR_CLASS_COUNT];      // Prefix of pairs measured so far in the current run
+} SampleConfig;
+
+/*
+ * Sorts every unordered pair of processors into its topology class and shuffles each class.  Every pair
+ * gets a random direction too, so the sample doesn't always have the lower CPU ID make the first handoff.
+ * @Param sample: Settings, the per class lists are filled in.
+ * @Param procIds: CPU ID of every table index.
+ * @Param numProcs: Number of entries in procIds.
+ * @Param topology: Used to classify the pairs.
+ * @Param skipSmt: Leave SMT sibling pairs out.
+ * @return: Zero on success, -1 on allocation failure.
+ */
+static int BuildClassSamples(SampleConfig *sample, const int *procIds, int numProcs, const CpuTopology *topology, int skipSmt) {
+    uint64_t state = sample->seed != 0 ? sample->seed : 1;
+    memset(sample->pairCount, 0, sizeof(sample->pairCount));
+    for (int i = 0; i < numProcs; i++)
+        for (int j = i + 1; j < numProcs; j++)
+            sample->pairCount[getPairClass(topology, procIds[i], procIds[j])]++;
+
+    for (int c = 0; c < PAIR_CLASS_COUNT; c++) {
+        sample->pairs[c] = (SchedulePair *)malloc(sizeof(SchedulePair) * (sample->pairCount[c] + 1));
+        if (sample->pairs[c] == NULL)
+            return -1;
+        if (skipSmt && c == PAIR_CLASS_SMT)
+            sample->pairCount[c] = 0;
+        sample->selected[c] = 0;
+    }
+
+    int fill[PAIR_CLASS_COUNT] = { 0 };
+    for (int i = 0; i < numProcs; i++) {
+        for (int j = i + 1; j < numProcs; j++) {
+            int pairClass = getPairClass(topology, procIds[i], procIds[j]);
+            if (fill[pairClass] == sample->pairCount[pairClass])
+                continue;
+            int flip = nextRandom(&state) & 1;
+            sample->pairs[pairClass][fill[pairClass]].first = flip ? procIds[j] : procIds[i];
+            sample->pairs[pairClass][fill[pairClass]].second = flip ? procIds[i] : procIds[j];
+            fill[pairClass]++;
+        }
+    }
+
+    // Fisher-Yates
+    for (int c = 0; c < PAIR_CLASS_COUNT; c++) {
+        for (int p = sample->pairCount[c] - 1; p > 0; p--) {
+            int other = (int)(nextRandom(&state) % (uint64_t)(p + 1));
+            SchedulePair swap = sample->pairs[c][p];
+            sample->pairs[c][p] = sample->pairs[c][other];
+            sample->pairs[c][other] = swap;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Picks the pairs for one sampling stage.  The first stage takes SAMPLE_PILOT_PAIRS from every class.  The second
+ * one uses their spread to work out how many pairs each class needs to reach the target precision, tops the
+ * sample up to that, and adds the symmetric spot checks.
+ * @Param sample: Settings and class lists from BuildClassSamples.
+ * @Param stage: 0 or 1.
+ * @Param latencies: Latency table, read in the second stage.
+ * @Param procIndex: Table index of every CPU ID.
+ * @Param numProcs: Number of processors.
+ * @Param stagePairs: Receives the pairs, needs room for every candidate pair plus the spot checks.
+ * @return: Number of pairs picked.
+ */
+static int SelectSamplePairs(SampleConfig *sample, int stage, const double *latencies, const int *procIndex,
+                             int numProcs, SchedulePair *stagePairs) {
+    int count = 0;
+    for (int c = 0; c < PAIR_CLASS_COUNT; c++) {
+        int limit = sample->pairCount[c] < sample->maxPairs ? sample->pairCount[c] : sample->maxPairs;
+        int wanted = SAMPLE_PILOT_PAIRS < limit ? SAMPLE_PILOT_PAIRS : limit;
+        int already = sample->selected[c];
+
+        if (stage == 1 && already > 1) {
+            double *values = (double *)malloc(sizeof(double) * already);
+            if (values == NULL)
+                return count;
+            for (int p = 0; p < already; p++)
+                values[p] = latencies[procIndex[sample->pairs[c][p].second] + procIndex[sample->pairs[c][p].first] * numProcs];
+            BenchmarkStats stats;
+            computeStats(values, already, 0, &stats, NULL);
+            free(values);
+
+            // The interval shrinks with the square root of the sample size
+            double needed = already;
+            if (stats.mean > 0 && stats.ciHalfWidth > sample->targetRelativeCI * stats.mean) {
+                double ratio = stats.ciHalfWidth / (sample->targetRelativeCI * stats.mean);
+                needed = already * ratio * ratio;
+            }
+            wanted = needed < limit ? (int)(needed + 0.999) : limit;
+            asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%s: %d of %d pairs, %f ns +/- %f ns from %d so far\n", getPairClassName(c),
+                       wanted, sample->pairCount[c], stats.mean, stats.ciHalfWidth, already);
+        }
+
+        for (int p = already; p < wanted; p++)
+            stagePairs[count++] = sample->pairs[c][p];
+        if (wanted > already)
+            sample->selected[c] = wanted;
+
+        if (stage == 1) {
+            int checks = sample->symmetricPairs < sample->selected[c] ? sample->symmetricPairs : sample->selected[c];
+            for (int p = 0; p < checks; p++) {
+                stagePairs[count].first = sample->pairs[c][p].second;
+                stagePairs[count].second = sample->pairs[c][p].first;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ * Fills every pair that wasn't measured with its class mean, in every table that holds a latency.  The
+ * uncertainty of an inferred pair goes to TABLE_CI as the half width of the class's 95% prediction interval,
+ * so it covers how far a single unmeasured pair can be from the mean, not just how well the mean is known.
+ * Symmetric spot checks are reported on the way.
+ * @Param sample: Settings and class lists from BuildClassSamples.
+ * @Param procIds: CPU ID of every table index.
+ * @Param procIndex: Table index of every CPU ID.
+ * @Param numProcs: Number of processors.
+ * @Param topology: Used to classify the pairs.
+ * @Param parallelTestState: Pairs left at zero are inferred and marked done.
+ */
+static void InferUnmeasuredPairs(const SampleConfig *sample, const int *procIds, const int *procIndex, int numProcs,
+                                 const CpuTopology *topology, int *parallelTestState) {
+    static const int inferredTables[] = { TABLE_LATENCY, TABLE_P50, TABLE_P99, TABLE_MAX,
+        TABLE_COUNTERS + PERF_COUNTER_CYCLES, TABLE_COUNTERS + PERF_COUNTER_REF_CYCLES,
+        TABLE_COUNTERS + PERF_COUNTER_INSTRUCTIONS, TABLE_COUNTERS + PERF_COUNTER_CACHE_REFERENCES,
+        TABLE_COUNTERS + PERF_COUNTER_CACHE_MISSES, TABLE_COUNTERS + PERF_COUNTER_L1D_MISSES,
+        TABLE_COUNTERS + PERF_COUNTER_LLC_MISSES, TABLE_MHZ, TABLE_CORE_CYCLES, TABLE_BANDWIDTH, TABLE_LOAD_BANDWIDTH };
+    double *measured = resultTables[TABLE_MEASURED].values;
+    double *values = (double *)malloc(sizeof(double) * numProcs * numProcs);
+    if (values == NULL)
+        return;
+
+    for (int c = 0; c < PAIR_CLASS_COUNT; c++) {
+        if (sample->selected[c] == 0)
+            continue;
+
+        // Both directions of the spot checks count, they are just as much samples of the class
+        double estimate[TABLE_COUNT] = { 0 };
+        BenchmarkStats stats;
+        for (size_t k = 0; k < sizeof(inferredTables) / sizeof(inferredTables[0]); k++) {
+            int t = inferredTables[k], count = 0;
+            for (int cell = 0; cell < numProcs * numProcs; cell++)
+                if (measured[cell] != 0 && !isnan(resultTables[t].values[cell]) &&
+                    getPairClass(topology, procIds[cell / numProcs], procIds[cell % numProcs]) == c)
+                    values[count++] = resultTables[t].values[cell];
+            if (count == 0) {
+                estimate[t] = NAN;
+                continue;
+            }
+            computeStats(values, count, 0, &stats, NULL);
+            estimate[t] = stats.mean;
+            if (t == TABLE_LATENCY)
+                estimate[TABLE_CI] = stats.ciHalfWidth * sqrt(stats.sampleCount + 1.0);
+        }
+
+        double asymmetry = 0;
+        int checks = sample->symmetricPairs < sample->selected[c] ? sample->symmetricPairs : sample->selected[c];
+        for (int p = 0; p < checks; p++) {
+            int i = procIndex[sample->pairs[c][p].first], j = procIndex[sample->pairs[c][p].second];
+            double forward = resultTables[TABLE_LATENCY].values[j + i * numProcs];
+            double reverse = resultTables[TABLE_LATENCY].values[i + j * numProcs];
+            asymmetry += fabs(forward - reverse) / ((forward + reverse) / 2);
+        }
+        fprintf(stderr, "%s: %f ns +/- %f ns for unmeasured pairs, %d of %d measured", getPairClassName(c),
+                estimate[TABLE_LATENCY], estimate[TABLE_CI], sample->selected[c], sample->pairCount[c]);
+        if (checks != 0)
+            fprintf(stderr, ", reverse direction differs by %.2f%% on average", asymmetry / checks * 100);
+        fprintf(stderr, "\n");
+
+        for (int cell = 0; cell < numProcs * numProcs; cell++) {
+            int i = cell / numProcs, j = cell % numProcs;
+            if (i == j || parallelTestState[cell] == 2 || getPairClass(topology, procIds[i], procIds[j]) != c)
+                continue;
+            for (size_t k = 0; k < sizeof(inferredTables) / sizeof(inferredTables[0]); k++)
+                resultTables[inferredTables[k]].values[cell] = estimate[inferredTables[k]];
+            resultTables[TABLE_CI].values[cell] = estimate[TABLE_CI];
+            parallelTestState[cell] = 2;
+        }
+    }
+    free(values);
+}
+
+/*
+ * Background load, see RunLoadGenerator.  Every generator runs on a pool worker that isn't part of any pair in
+ * the current round, and keeps going until the round is done.
+ */
+typedef struct __attribute__((aligned(64))) LoadGeneratorData {
+    int kind;
+    int intensity;                // Percent of the time spent generating traffic, the rest is spent idle
+    uint64_t bufferSize;          // Per generator buffer for the read and write loads
+    volatile uint64_t *snoopLines; // Lines every snoop generator writes, shared by all of them
+    uint32_t index;
+    const TimerInfo *timer;
+    _Atomic int *stop;
+    uint64_t bytes;               // Traffic generated, a whole line for every line touched
+    uint64_t sink;
+    PoolJob job;
+} LoadGeneratorData;
+
+// Every pool worker allocates its own buffer the first time it generates load at a level, so it's local and only
+// paid for once per level, and ReleaseLoadBuffer frees it again when the level is done
+static __thread uint64_t *workerLoadBuffer;
+static __thread uint64_t workerLoadBufferSize;
+
+static const char *loadKindNames[LOAD_KIND_COUNT] = { "read", "write", "snoop" };
+
+/*
+ * Generates background traffic in chunks of LOAD_CHUNK_BYTES until told to stop.  Reads and writes stream over
+ * the worker's own buffer, one access per line, and the snoop storm writes lines that every other snoop generator
+ * writes too, so every store is an RFO that has to snoop the line out of another core, across packages when
+ * there are several.  Below 100% intensity every chunk is followed by enough idle time to hit the duty cycle.
+ * @Param param: Pointer to the LoadGeneratorData to run.
+ * @return: NULL, or param if the buffer could not be allocated.
+ */
+void *RunLoadGenerator(void *param) {
+    LoadGeneratorData *load = (LoadGeneratorData *)param;
+    uint64_t lines = LOAD_CHUNK_BYTES / 64, cursor = 0, sink = 0;
+
+    if (load->kind != LOAD_SNOOP && workerLoadBufferSize != load->bufferSize) {
+        freePages(workerLoadBuffer, workerLoadBufferSize, PAGES_SMALL);
+        workerLoadBuffer = (uint64_t *)allocatePages(load->bufferSize, PAGES_SMALL);
+        workerLoadBufferSize = workerLoadBuffer != NULL ? load->bufferSize : 0;
+        if (workerLoadBuffer == NULL)
+            return param;
+    }
+    uint64_t bufferWords = workerLoadBufferSize / sizeof(uint64_t);
+    uint64_t snoopWords = LOAD_SNOOP_BYTES / sizeof(uint64_t);
+
+    while (!atomic_load_explicit(load->stop, memory_order_relaxed)) {
+        uint64_t begin = timerRead(load->timer);
+        if (load->kind == LOAD_READ) {
+            volatile uint64_t *buffer = workerLoadBuffer;
+            for (uint64_t line = 0; line < lines; line++, cursor = (cursor + 8) % bufferWords)
+                sink += buffer[cursor];
+        }
+        else if (load->kind == LOAD_WRITE) {
+            volatile uint64_t *buffer = workerLoadBuffer;
+            for (uint64_t line = 0; line < lines; line++, cursor = (cursor + 8) % bufferWords)
+                buffer[cursor] = line;
+        }
+        else {
+            // Every generator starts somewhere else, so they keep running into each other's lines
+            for (uint64_t line = 0; line < lines; line++) {
+                uint64_t word = (cursor + load->index * 8 * 61 + line * 8) % snoopWords;
+                load->snoopLines[word] = line;
+            }
+            cursor = (cursor + 8 * lines) % snoopWords;
+        }
+        load->bytes += lines * 64;
+
+        if (load->intensity < 100) {
+            uint64_t now = timerRead(load->timer);
+            uint64_t idleUntil = now + (now - begin) * (100 - load->intensity) / load->intensity;
+            while (timerRead(load->timer) < idleUntil);
+        }
+    }
+    load->sink = sink;
+    return NULL;
+}
+
+/*
+ * Frees the calling worker's load buffer.  Run on a worker, like RunLoadGenerator.
+ * @Param param: Unused.
+ * @return: Will always return NULL.
+ */
+void *ReleaseLoadBuffer(void *param) {
+    (void)param;
+    freePages(workerLoadBuffer, workerLoadBufferSize, PAGES_SMALL);
+    workerLoadBuffer = NULL;
+    workerLoadBufferSize = 0;
+    return NULL;
+}
+
+/*
+ * Frees the load buffer of every worker that may have generated load, once a load level is done.  Only call it while
+ * no generator is running, it borrows their jobs.
+ * @Param pool: Thread pool with a worker on every processor.
+ * @Param generators: One entry per online CPU.
+ * @Param procIds: Online CPU IDs.
+ * @Param numProcs: Number of entries in procIds.
+ */
+void ReleaseLoadBuffers(ThreadPool *pool, LoadGeneratorData *generators, const int *procIds, int numProcs) {
+    int submitted = 0;
+    for (int i = 0; i < numProcs; i++) {
+        initJob(&generators[submitted].job, ReleaseLoadBuffer, NULL);
+        if (submitJob(pool, procIds[i], &generators[submitted].job) == 0)
+            submitted++;
+        else
+            fprintf(stderr, "Could not free the load buffer on CPU %d\n", procIds[i]);
+    }
+    for (int g = 0; g < submitted; g++)
+        waitJob(&generators[g].job);
+}
+
+/*
+ * Starts a load generator on every online CPU that doesn't share a core with a pair in the round.
+ * @Param pool: Thread pool with a worker on every processor.
+ * @Param generators: One entry per online CPU.
+ * @Param pairRunData: The pairs of the round.
+ * @Param pairCount: Number of pairs in the round.
+ * @Param procIds: Online CPU IDs.
+ * @Param numProcs: Number of entries in procIds.
+ * @Param topology: Used to keep generators off the pairs' cores.
+ * @Param stop: Cleared here, set it to end the generators.
+ * @return: The number of generators started, they occupy the start of generators.
+ */
+int StartLoadGenerators(ThreadPool *pool, LoadGeneratorData *generators, const LatencyPairRunData *pairRunData, int pairCount,
+                        const int *procIds, int numProcs, const CpuTopology *topology, _Atomic int *stop) {
+    int started = 0;
+    atomic_store(stop, 0);
+    for (int i = 0; i < numProcs; i++) {
+        int busy = 0;
+        int core = topology->cpus[procIds[i]].coreDomain;
+        for (int p = 0; p < pairCount && !busy; p++)
+            busy = topology->cpus[pairRunData[p].proc1].coreDomain == core || topology->cpus[pairRunData[p].proc2].coreDomain == core;
+        if (busy)
+            continue;
+        LoadGeneratorData *load = &generators[started];
+        load->index = started;
+        load->stop = stop;
+        load->bytes = 0;
+        initJob(&load->job, RunLoadGenerator, load);
+        if (submitJob(pool, procIds[i], &load->job) != 0) {
+            AbortRun("Could not queue a load generator on CPU %d\n", procIds[i]);
+            exit(0);
+        }
+        started++;
+    }
+    return started;
+}
+
+/*
+ * Stops the load generators of a round.
+ * @Param generators: Generators started with StartLoadGenerators.
+ * @Param count: Number of generators started.
+ * @Param stop: The stop flag they were started with.
+ * @Param elapsedNs: How long they ran for.
+ * @return: The background bandwidth they generated in GB/s.
+ */
+double StopLoadGenerators(LoadGeneratorData *generators, int count, _Atomic int *stop, double elapsedNs) {
+    uint64_t bytes = 0;
+    atomic_store(stop, 1);
+    for (int g = 0; g < count; g++) {
+        if (waitJob(&generators[g].job) != NULL)
+            asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Could not allocate a load generator buffer\n");
+        bytes += generators[g].bytes;
+    }
+    return elapsedNs > 0 ? bytes / elapsedNs : 0;
+}
+
+/*
+ * Contention primitives.  Each one completes a single increment of the count on the target line, however many
+ * attempts it takes, and adds the attempts that failed to retries.
+ */
+static inline void FetchAddContention(volatile uint64_t *target, uint64_t *retries) {
+    (void)retries;
+    atomic_fetch_add((_Atomic uint64_t *)target, 1);
+}
+
+static inline void CasContention(volatile uint64_t *target, uint64_t *retries) {
+    _Atomic uint64_t *atomicTarget = (_Atomic uint64_t *)target;
+    uint64_t expected = atomic_load_explicit(atomicTarget, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(atomicTarget, &expected, expected + 1))
+        (*retries)++;
+}
+
+// Test and test and set, the lock is the first word of the line and the count it protects is the second
+static inline void SpinlockContention(volatile uint64_t *target, uint64_t *retries) {
+    _Atomic uint64_t *lock = (_Atomic uint64_t *)target;
+    while (atomic_exchange_explicit(lock, 1, memory_order_acquire) != 0) {
+        (*retries)++;
+        while (atomic_load_explicit(lock, memory_order_relaxed) != 0)
+            ;
+    }
+    target[1]++;
+    atomic_store_explicit(lock, 0, memory_order_release);
+}
+
+/*
+ * Runs a contention primitive until the thread's time is up.  The clock is only read every CONTENTION_CHUNK
+ * operations, always inlined so the primitive is a constant like in HandoffLoop.
+ * @Param latencyData: The LatencyThreadData being operated on, begin is already set by TimeThread.
+ * @Param contend: The contention primitive to loop on.
+ */
+static inline __attribute__((always_inline)) void ContentionLoop(LatencyThreadData *latencyData,
+                                                                 void (*contend)(volatile uint64_t *, uint64_t *)) {
+    uint64_t ops = 0, retries = 0;
+    uint64_t stop = latencyData->begin + latencyData->durationTicks;
+    do {
+        for (int i = 0; i < CONTENTION_CHUNK; i++)
+            contend(latencyData->target, &retries);
+        ops += CONTENTION_CHUNK;
+    } while (timerRead(latencyData->timer) < stop);
+    latencyData->ops = ops;
+    latencyData->retries = retries;
+}
+
+void *FetchAddContentionThread(void *param) { ContentionLoop(param, FetchAddContention); return NULL; }
+void *CasContentionThread(void *param) { ContentionLoop(param, CasContention); return NULL; }
+void *SpinlockContentionThread(void *param) { ContentionLoop(param, SpinlockContention); return NULL; }
+
+typedef struct ContentionKernel {
+    const char *name;
+    void *(*threadFunc)(void *);
+    int countWord;  // Word of the target line that ends up holding the number of completed operations
+} ContentionKernel;
+
+const ContentionKernel contentionKernels[] = {
+    { "fetchadd", FetchAddContentionThread, 0 },
+    { "cas", CasContentionThread, 0 },
+    { "spinlock", SpinlockContentionThread, 1 },
+};
+#define CONTENTION_KERNEL_COUNT (sizeof(contentionKernels) / sizeof(contentionKernels[0]))
+#define CONTENTION_METRIC_COUNT 3  // Throughput, fairness and retries per operation for every kernel and target
+
+static const char *contentionDomainNames[CONTENTION_DOMAIN_COUNT] = { "llc", "package", "all" };
+
+/*
+ * Runs one contention primitive on a set of CPUs at once, every thread pinned through its pool worker and
+ * started on a shared barrier like the two sides of a latency test.
+ * @Param pool: Thread pool with a worker on every CPU in cpus.
+ * @Param cpus: CPUs to run on.
+ * @Param threadCount: Number of entries in cpus.
+ * @Param kernel: The contention primitive.
+ * @Param region: Zeroed lines to contend on, CONTENTION_PADDING bytes apart and one per thread.
+ * @Param padded: Give every thread its own line instead of all of them sharing the first one.
+ * @Param durationTicks: How long every thread runs, in timer ticks.
+ * @Param timer: A calibrated timer.
+ * @Param results: Receives the throughput in millions of operations per second, Jain's fairness index over the
+ *                 threads' operation counts (1 is perfectly fair, 1 / threadCount is one thread doing everything)
+ *                 and the failed attempts per operation.
+ * @return: Zero on success.
+ */
+int RunContention(ThreadPool *pool, const int *cpus, int threadCount, const ContentionKernel *kernel, char *region,
+                  int padded, uint64_t durationTicks, const TimerInfo *timer, double *results) {
+    LatencyThreadData *threads = (LatencyThreadData *)allocateAligned(64, sizeof(LatencyThreadData) * threadCount);
+    PoolJob *jobs = (PoolJob *)malloc(sizeof(PoolJob) * threadCount);
+    SpinBarrier barrier;
+    if (threads == NULL || jobs == NULL) {
+        freeAligned(threads);
+        free(jobs);
+        return -1;
+    }
+
+    memset(region, 0, (size_t)CONTENTION_PADDING * threadCount);
+    initSpinBarrier(&barrier, threadCount);
+    for (int t = 0; t < threadCount; t++) {
+        LatencyThreadData *lat = &threads[t];
+        memset(lat, 0, sizeof(LatencyThreadData));
+        lat->target = (uint64_t *)(region + (padded ? (size_t)CONTENTION_PADDING * t : 0));
+        lat->processorIndex = cpus[t];
+        lat->durationTicks = durationTicks;
+        lat->timer = timer;
+        lat->threadFunc = kernel->threadFunc;
+        lat->barrier = &barrier;
+        initJob(&jobs[t], TimeThread, lat);
+    }
+    for (int t = 0; t < threadCount; t++) {
+        if (submitJob(pool, cpus[t], &jobs[t]) != 0) {
+            fprintf(stderr, "Could not queue CPU %d on the thread pool\n", cpus[t]);
+            exit(0);
+        }
+    }
+    for (int t = 0; t < threadCount; t++)
+        waitJob(&jobs[t]);
+
+    uint64_t first = UINT64_MAX, last = 0, ops = 0, retries = 0, counted = 0;
+    double sumSquares = 0;
+    for (int t = 0; t < threadCount; t++) {
+        if (threads[t].begin < first)
+            first = threads[t].begin;
+        if (threads[t].end > last)
+            last = threads[t].end;
+        ops += threads[t].ops;
+        retries += threads[t].retries;
+        sumSquares += (double)threads[t].ops * threads[t].ops;
+        if (padded || t == 0)
+            counted += threads[t].target[kernel->countWord];
+    }
+
+    // A lost update means the primitive is broken, not slow
+    if (counted != ops)
+        fprintf(stderr, "%s lost updates: counted %lu of %lu operations\n", kernel->name, counted, ops);
+
+    TimerResult elapsed;
+    timerElapsed(timer, first, last, &elapsed);
+    results[0] = ops / elapsed.nanoseconds * 1000.0;
+    results[1] = (double)ops * ops / (threadCount * sumSquares);
+    results[2] = (double)retries / ops;
+    freeAligned(threads);
+    free(jobs);
+    return 0;
+}
+
+/*
+ * Measures how atomic operations scale as more cores contend on them.  Threads are added one per core first and
+ * then on SMT siblings, within the last level cache of the first CPU, then its package, then the whole system.
+ * Every thread count runs every contention primitive on one shared line and on padded per thread lines, and
+ * each domain is written to `<outfile>_contention_<domain>.cnc` with a row per thread count.  Domains no larger
+ * than the one before them are skipped.
+ * @Param topology: The CPU topology.
+ * @Param procIds: Online CPU IDs.
+ * @Param numProcs: Number of entries in procIds.
+ * @Param outFilePath: Output path the domain suffixes are appended to.
+ * @Param format: CNC_FORMAT_TEXT or CNC_FORMAT_BINARY.
+ * @Param durationMs: How long every run lasts.
+ * @Param timer: A calibrated timer.
+ * @return: Zero on success.
+ */
+int RunContentionScaling(const CpuTopology *topology, const int *procIds, int numProcs, const char *outFilePath,
+                         uint8_t format, double durationMs, const TimerInfo *timer) {
+    int columnCount = 1 + 2 * CONTENTION_KERNEL_COUNT * CONTENTION_METRIC_COUNT;
+    static const char *metricNames[CONTENTION_METRIC_COUNT] = { "mops", "fairness", "retries" };
+    char (*names)[256] = malloc(columnCount * (256 * sizeof(char)));
+    int *cpus = (int *)malloc(sizeof(int) * numProcs);
+    int *coresFirst = (int *)malloc(sizeof(int) * numProcs);
+    double *row = (double *)malloc(sizeof(double) * columnCount);
+    char *region = (char *)allocateAligned(4096, (size_t)CONTENTION_PADDING * numProcs);
+    ThreadPool *pool = createThreadPool(NULL, 0);
+    if (names == NULL || cpus == NULL || coresFirst == NULL || row == NULL || region == NULL || pool == NULL) {
+        fprintf(stderr, "Could not start the thread pool\n");
+        return -1;
+    }
+
+    snprintf(names[0], 256, "Threads");
+    for (size_t k = 0; k < CONTENTION_KERNEL_COUNT; k++)
+        for (int padded = 0; padded < 2; padded++)
+            for (int metric = 0; metric < CONTENTION_METRIC_COUNT; metric++)
+                snprintf(names[1 + (k * 2 + padded) * CONTENTION_METRIC_COUNT + metric], 256, "%s_%s_%s",
+                         contentionKernels[k].name, padded ? "padded" : "shared", metricNames[metric]);
+    uint64_t durationTicks = (uint64_t)(durationMs * 1000000.0 * timer->ticksPerNs);
+
+    // The first part of every curve never shares a core
+    int status = 0, previousCount = 0;
+    int anchor = procIds[0];
+    int coresFirstCount = orderCoresFirst(topology, procIds, numProcs, coresFirst);
+    for (int domain = 0; domain < CONTENTION_DOMAIN_COUNT && status == 0; domain++) {
+        int threadCount = 0;
+        for (int i = 0; i < coresFirstCount; i++) {
+            const CpuInfo *cpu = &topology->cpus[coresFirst[i]];
+            if ((domain == CONTENTION_DOMAIN_LLC && cpu->llcDomain != topology->cpus[anchor].llcDomain) ||
+                (domain == CONTENTION_DOMAIN_PACKAGE && cpu->package != topology->cpus[anchor].package))
+                continue;
+            cpus[threadCount++] = coresFirst[i];
+        }
+        if (threadCount <= previousCount) {
+            fprintf(stderr, "Contention domain %s has no more CPUs than the last one, skipping it\n", contentionDomainNames[domain]);
+            continue;
+        }
+        previousCount = threadCount;
+
+        char tablePath[256], metadata[256];
+        snprintf(tablePath, sizeof(tablePath), "%s_contention_%s", outFilePath, contentionDomainNames[domain]);
+        snprintf(metadata, sizeof(metadata), "contention domain=%s anchor=%d duration_ms=%g", contentionDomainNames[domain], anchor, durationMs);
+        CnCWriter *writer = open_CNC(tablePath, columnCount, names, format, metadata);
+        if (writer == NULL) {
+            fprintf(stderr, "Could not open %s.cnc for writing\n", tablePath);
+            status = -1;
+            break;
+        }
+
+        printf("Contention within %s, %d CPUs\n", contentionDomainNames[domain], threadCount);
+        for (int count = 1; count <= threadCount && status == 0; count++) {
+            row[0] = count;
+            for (size_t k = 0; k < CONTENTION_KERNEL_COUNT && status == 0; k++)
+                for (int padded = 0; padded < 2 && status == 0; padded++)
+                    status = RunContention(pool, cpus, count, &contentionKernels[k], region, padded, durationTicks, timer,
+                                           row + 1 + (k * 2 + padded) * CONTENTION_METRIC_COUNT);
+            printf("%d threads:", count);
+            for (size_t k = 0; k < CONTENTION_KERNEL_COUNT; k++)
+                printf(" %s %.1f/%.1f Mops", contentionKernels[k].name, row[1 + k * 2 * CONTENTION_METRIC_COUNT],
+                       row[1 + (k * 2 + 1) * CONTENTION_METRIC_COUNT]);
+            printf("\n");
+            if (append_CNC(writer, row) != 0 || flush_CNC(writer) != 0)
+                fprintf(stderr, "Could not write the %d thread row\n", count);
+        }
+        if (close_CNC(writer) != 0)
+            status = -1;
+    }
+
+    destroyThreadPool(pool);
+    freeAligned(region);
+    free(row);
+    free(cpus);
+    free(coresFirst);
+    free(names);
+    return status;
+}
 
 /*
  * Runs latency tests across all present processors, and then outputs the results.
  * @Param iterations: Number of iterations to use in the latency tests, higher is more accurate.
- * @Param nolock: Tells the benchmark to use the non-locking test algorithm.
- * @Param offsets: TODO.
+ * @Param nolock: Tells the benchmark to use the non-locking test algorithm, same as -kernel nolock.
+ * @Param kernel: Name of the handoff kernel to measure (see latencyKernels), lock by default.  The kernel and
+ *                the run settings are recorded in the metadata of every output file.
+ * @Param offsets: Number of placements to run, each moving the target one cache line further along.
+ * @Param sweep: Comma separated placement presets (inline, line, sector, page, set or all, see ParseSweep),
+ *               each placement is written to `<outfile>_<placement>.cnc`.  Replaces -offset.  All but inline need
+ *               -parallel 2 or more, and set backs the target region with huge pages.
+ * @Param home: NUMA placement of the target line: proc1 or proc2 follow one side of each pair, a node number
+ *              fixes it, and all runs every node in turn to build a (requester, responder, home) cube.  Each home
+ *              is written to `<outfile>_home<node>.cnc`, or `<outfile>_homeproc1.cnc` / `<outfile>_homeproc2.cnc`.
+ *              Without it the line stays wherever it was first touched.
  * @Param parallel: How many processors to test in parallel.
- * @Param outfile: File path for output data, automatically has `.cnc` appended.
+ * @Param outfile: File path for output data, automatically has `.cnc` appended.  Offsets after the first
+ *                 are written to `<outfile>_offset<N>.cnc`.  Rows are streamed out as soon as they complete.
+ * @Param binary: Write the output in the binary (version 2) .cnc format instead of text.
+ * @Param histogram: Sample every Nth round trip into per-thread histograms and also write round trip
+ *                   p50/p99/max matrices to `<outfile>_p50.cnc`, `<outfile>_p99.cnc` and `<outfile>_max.cnc`.
+ * @Param counters: Count cycles, reference cycles, instructions and cache events on both sides of every pair with
+ *                  perf_event_open, and write the counts per round trip to `<outfile>_<event>.cnc` (see
+ *                  getPerfCounterName).  Events the platform doesn't allow are skipped, and a cell is NaN when
+ *                  either side's worker couldn't count the event.
+ * @Param guard: Number of retries for noisy pairs.  Checks cpufreq governors and the load average up front, then clocks
+ *              both cores right before every run and counts their interrupts.  Pairs whose clocks differ or that
+ *              took too many interrupts (see CheckPairNoise) are run again up to this many times, and flagged in
+ *              `<outfile>_noisy.cnc` if they never settle.  The measured clock goes to `<outfile>_mhz.cnc` and the
+ *              latency in core cycles to `<outfile>_corecycles.cnc`.
+ * @Param calibrate: Target relative precision (for example 0.01), measures every pair in short batches until the
+ *                   95% confidence interval of the mean is within it, see CalibratePairs.  -iterations then caps the
+ *                   size of a single batch, and the interval half widths are written to `<outfile>_ci.cnc`.
+ * @Param budget: Most milliseconds a calibrated pair may spend measuring before settling for its current precision,
+ *                100 by default.
+ * @Param sample: Target relative precision per topology class (for example 0.05).  Instead of every ordered pair,
+ *                measures a random sample from each class sized so the 95% confidence interval of the class mean is
+ *                within it, and fills the other pairs with their class mean (see InferUnmeasuredPairs).  Inferred pairs
+ *                get a prediction interval half width in `<outfile>_ci.cnc`, and `<outfile>_measured.cnc` holds 1 for
+ *                every measured pair and 0 for inferred ones.
+ * @Param samplemax: Most distinct pairs sampled from one class, 64 by default.
+ * @Param symmetric: Sampled pairs per class that are also measured in the reverse direction, 2 by default.
+ * @Param seed: Seed for picking the sample, so runs can pick the same pairs again.
+ * @Param nosmt: Skip pairs of SMT siblings, they are left at zero in every table.
+ * @Param isolatellc: Keep pairs that run in parallel from sharing a last level cache, not just a core.
+ * @Param labels: Write the PAIR_CLASS of every pair to `<outfile>_class.cnc`.
+ * @Param contention: Instead of pair latencies, measure fetch_add, CAS retry loop and spinlock throughput, fairness and
+ *                    retry rates as 1..N threads contend on one line, see RunContentionScaling.
+ * @Param duration: Milliseconds every contention run lasts, 10 by default.
+ * @Param transfer: Buffer size in bytes (K, M or G suffix allowed, rounded up to whole lines) for pairwise
+ *                  producer/consumer transfers, see TransferTestThread.  Selects the transfer kernel, makes
+ *                  -iterations count buffers (enough for 64 MiB by default) and writes the GB/s of every pair to
+ *                  `<outfile>_bandwidth.cnc` next to the ns per buffer in the latency table.
+ * @Param rfo: Have the consumer write every transferred line instead of reading it.
+ * @Param load: Background traffic to measure under, read or write (streaming over a 64 MiB buffer per CPU) or snoop
+ *              (every generator writing the same 1 MiB of lines), see RunLoadGenerator.  Generators run on every CPU
+ *              that doesn't share a core with a pair of the round.  Every load level is written to
+ *              `<outfile>_load<percent>.cnc`, the background GB/s during each pair to `<outfile>_load<percent>_loadbandwidth.cnc`,
+ *              and `<outfile>_loadcurve.cnc` gets a row per level with the background GB/s and the mean latency of
+ *              every pair class.
+ * @Param loadlevels: Comma separated load intensities in percent of the time the generators are busy, 0,25,50,100 by default.
+ * @Param housekeeping: CPU to keep out of the measurement.  The main thread and the result writer thread (see
+ *                      asyncWriter.h) are pinned to it, so writing results and progress lines never lands on a core
+ *                      being measured.  Without it the writer thread is left to the scheduler.
  * @return: Status code, zero is successful.
  */
 int main(int argc, char *argv[]) {
-    double **latencies;
     int *parallelTestState;
-    int numProcs, offsets = 1, parallelismFactor = 1;
-    char *outFilePath;
+    int numProcs, offsets = 1, parallelismFactor = 1, binaryOutput = 0;
+    uint32_t sampleInterval = 0, countEvents = 0;
+    int skipSmt = 0, isolateLlc = 0;
+    CpuTopology topology;
+    char *outFilePath = "CoherencyLatency";
     uint64_t iter = ITERATIONS;
-    uint64_t *bouncyArr;
+    char *bouncyRegion, *sweep = NULL, *homeArg = NULL;
+    Placement placements[PLACEMENT_MAX];
+    const LatencyKernel *kernel = FindKernel("lock");
+    CalibrationConfig calibration = { .budgetNs = 100000000.0 };
+    int calibrate = 0;
+    SampleConfig sample = { .maxPairs = 64, .symmetricPairs = 2, .seed = 1 };
+    int sampling = 0;
+    int guard = 0, guardRetries = 0;
+    int contention = 0;
+    double contentionMs = CONTENTION_DURATION_MS;
+    uint64_t transferSize = 0;
+    uint32_t transferRfo = 0;
+    int iterSet = 0;
+    int loadKind = -1, loadLevelCount = 1;
+    int loadLevels[LOAD_LEVEL_MAX] = { 0 };
+    char *loadLevelArg = "0,25,50,100";
+    int housekeeping = -1;
+    TimerInfo timer;
+
+    if (getTopology(&topology) != 0) {
+        fprintf(stderr, "Could not read CPU topology\n");
+        return -1;
+    }
 
-    numProcs = getThreadCount();
+    // Tables only hold online CPUs, CPU IDs can have offline holes so every table index maps back to an ID
+    numProcs = topology.onlineCount;
+    int *procIds = (int *)malloc(sizeof(int) * numProcs);
+    int *procIndex = (int *)malloc(sizeof(int) * topology.cpuCount);
+    for (int cpu = 0, index = 0; cpu < topology.cpuCount; cpu++) {
+        procIndex[cpu] = topology.cpus[cpu].online ? index : -1;
+        if (topology.cpus[cpu].online)
+            procIds[index++] = cpu;
+    }
     fprintf(stderr, "Number of CPUs: %u\n", numProcs);
+    fprintf(stderr, "Topology: %d packages, %d NUMA nodes, L%d is the last level cache\n",
+            topology.packageCount, topology.nodeCount, topology.llcLevel);
+
+    calibrateTimer(&timer);
+    fprintf(stderr, "Timer: %s at %.3f ticks/ns, %lu ticks overhead\n",
+            timer.backend == TIMER_BACKEND_TSC ? "invariant TSC" : "clock_gettime", timer.ticksPerNs, timer.overheadTicks);
 
     for (int argIdx = 1; argIdx < argc; argIdx++) {
         if (*(argv[argIdx]) == '-') {
@@ -170,17 +1726,38 @@ int main(int argc, char *argv[]) {
             if (strncmp(arg, "iterations", 10) == 0) {
                 argIdx++;
                 iter = atoi(argv[argIdx]);
+                iterSet = 1;
                 fprintf(stderr, "%lu iterations requested\n", iter);
             }
             else if (strncmp(arg, "nolock", 6) == 0) {
                 fprintf(stderr, "No locks, plain loads and stores\n");
-                testFunc = NoLockLatencyTestThread;
+                kernel = FindKernel("nolock");
+            }
+            else if (strncmp(arg, "kernel", 6) == 0) {
+                argIdx++;
+                kernel = FindKernel(argv[argIdx]);
+                if (kernel == NULL) {
+                    fprintf(stderr, "Unknown kernel %s, available kernels:\n", argv[argIdx]);
+                    for (size_t k = 0; k < KERNEL_COUNT; k++)
+                        fprintf(stderr, "  %-12s %s\n", latencyKernels[k].name, latencyKernels[k].description);
+                    return -1;
+                }
             }
             else if (strncmp(arg, "offset", 6) == 0) {
                 argIdx++;
                 offsets = atoi(argv[argIdx]);
                 fprintf(stderr, "Offsets: %d\n", offsets);
             }
+            else if (strncmp(arg, "sweep", 5) == 0) {
+                argIdx++;
+                sweep = argv[argIdx];
+                fprintf(stderr, "Sweeping placements: %s\n", sweep);
+            }
+            else if (strncmp(arg, "home", 4) == 0) {
+                argIdx++;
+                homeArg = argv[argIdx];
+                fprintf(stderr, "Target line home: %s\n", homeArg);
+            }
             else if (strncmp(arg, "parallel", 8) == 0) {
                 argIdx++;
                 parallelismFactor = atoi(argv[argIdx]);
@@ -191,107 +1768,587 @@ int main(int argc, char *argv[]) {
                 outFilePath = argv[argIdx];
                 fprintf(stderr, "Outputting data to %s\n", outFilePath);
             }
+            else if (strncmp(arg, "binary", 6) == 0) {
+                fprintf(stderr, "Writing binary .cnc output\n");
+                binaryOutput = 1;
+            }
+            else if (strncmp(arg, "histogram", 9) == 0) {
+                argIdx++;
+                sampleInterval = atoi(argv[argIdx]);
+                fprintf(stderr, "Sampling every %u round trips into histograms\n", sampleInterval);
+                resultTables[TABLE_P50].enabled = resultTables[TABLE_P99].enabled = resultTables[TABLE_MAX].enabled = (sampleInterval != 0);
+            }
+            else if (strncmp(arg, "counters", 8) == 0) {
+                countEvents = 1;
+            }
+            else if (strncmp(arg, "guard", 5) == 0) {
+                argIdx++;
+                guard = 1;
+                guardRetries = atoi(argv[argIdx]);
+                resultTables[TABLE_MHZ].enabled = resultTables[TABLE_CORE_CYCLES].enabled = resultTables[TABLE_NOISY].enabled = 1;
+                fprintf(stderr, "Guarding against noise, up to %d retries\n", guardRetries);
+            }
+            else if (strncmp(arg, "calibrate", 9) == 0) {
+                argIdx++;
+                calibration.targetRelativeCI = atof(argv[argIdx]);
+                calibrate = calibration.targetRelativeCI > 0;
+                resultTables[TABLE_CI].enabled = calibrate;
+                fprintf(stderr, "Calibrating every pair to %.2f%% relative error\n", calibration.targetRelativeCI * 100);
+            }
+            else if (strncmp(arg, "budget", 6) == 0) {
+                argIdx++;
+                calibration.budgetNs = atof(argv[argIdx]) * 1000000.0;
+                fprintf(stderr, "Calibration budget: %s ms per pair\n", argv[argIdx]);
+            }
+            else if (strncmp(arg, "samplemax", 9) == 0) {
+                argIdx++;
+                sample.maxPairs = atoi(argv[argIdx]);
+                fprintf(stderr, "Sampling at most %d pairs per class\n", sample.maxPairs);
+            }
+            else if (strncmp(arg, "sample", 6) == 0) {
+                argIdx++;
+                sample.targetRelativeCI = atof(argv[argIdx]);
+                sampling = sample.targetRelativeCI > 0;
+                resultTables[TABLE_CI].enabled |= sampling;
+                resultTables[TABLE_MEASURED].enabled = sampling;
+                fprintf(stderr, "Sampling every pair class to %.2f%% relative error\n", sample.targetRelativeCI * 100);
+            }
+            else if (strncmp(arg, "symmetric", 9) == 0) {
+                argIdx++;
+                sample.symmetricPairs = atoi(argv[argIdx]);
+                fprintf(stderr, "Checking %d reversed pairs per class\n", sample.symmetricPairs);
+            }
+            else if (strncmp(arg, "seed", 4) == 0) {
+                argIdx++;
+                sample.seed = strtoull(argv[argIdx], NULL, 0);
+                fprintf(stderr, "Sampling seed: %lu\n", sample.seed);
+            }
+            else if (strncmp(arg, "nosmt", 5) == 0) {
+                fprintf(stderr, "Skipping SMT sibling pairs\n");
+                skipSmt = 1;
+            }
+            else if (strncmp(arg, "isolatellc", 10) == 0) {
+                fprintf(stderr, "Parallel pairs will not share a last level cache\n");
+                isolateLlc = 1;
+            }
+            else if (strncmp(arg, "labels", 6) == 0) {
+                fprintf(stderr, "Writing pair classes\n");
+                resultTables[TABLE_CLASS].enabled = 1;
+            }
+            else if (strncmp(arg, "contention", 10) == 0) {
+                fprintf(stderr, "Measuring contention scaling\n");
+                contention = 1;
+            }
+            else if (strncmp(arg, "transfer", 8) == 0) {
+                argIdx++;
+                char *end;
+                double value = strtod(argv[argIdx], &end);
+                transferSize = (uint64_t)(value * (*end == 'G' ? 1ULL << 30 : *end == 'M' ? 1ULL << 20 : *end == 'K' ? 1ULL << 10 : 1));
+                transferSize = (transferSize + 63) & ~(uint64_t)63;
+                kernel = FindKernel("transfer");
+                resultTables[TABLE_BANDWIDTH].enabled = transferSize != 0;
+                fprintf(stderr, "Transferring %lu byte buffers\n", transferSize);
+            }
+            else if (strncmp(arg, "loadlevels", 10) == 0) {
+                argIdx++;
+                loadLevelArg = argv[argIdx];
+            }
+            else if (strncmp(arg, "load", 4) == 0) {
+                argIdx++;
+                for (int k = 0; k < LOAD_KIND_COUNT; k++)
+                    if (strcmp(argv[argIdx], loadKindNames[k]) == 0)
+                        loadKind = k;
+                if (loadKind < 0) {
+                    fprintf(stderr, "Unknown load %s, use read, write or snoop\n", argv[argIdx]);
+                    return -1;
+                }
+                resultTables[TABLE_LOAD_BANDWIDTH].enabled = 1;
+                fprintf(stderr, "Background load: %s\n", argv[argIdx]);
+            }
+            else if (strncmp(arg, "rfo", 3) == 0) {
+                fprintf(stderr, "Consumer takes transferred lines for ownership\n");
+                transferRfo = 1;
+            }
+            else if (strncmp(arg, "housekeeping", 12) == 0) {
+                argIdx++;
+                housekeeping = atoi(argv[argIdx]);
+                fprintf(stderr, "Housekeeping on CPU %d\n", housekeeping);
+            }
+            else if (strncmp(arg, "duration", 8) == 0) {
+                argIdx++;
+                contentionMs = atof(argv[argIdx]);
+                fprintf(stderr, "Contention runs last %s ms\n", argv[argIdx]);
+            }
+        }
+    }
+
+    // The housekeeping CPU drops out of every table and schedule, which shifts the table indices behind it
+    if (housekeeping >= 0) {
+        if (housekeeping >= topology.cpuCount || !topology.cpus[housekeeping].online || numProcs < 3) {
+            fprintf(stderr, "CPU %d can't be used for housekeeping\n", housekeeping);
+            return -1;
         }
+        numProcs = 0;
+        for (int cpu = 0; cpu < topology.cpuCount; cpu++) {
+            procIndex[cpu] = topology.cpus[cpu].online && cpu != housekeeping ? numProcs : -1;
+            if (procIndex[cpu] >= 0)
+                procIds[numProcs++] = cpu;
+        }
+        if (setAffinity(pthread_self(), housekeeping) != 0)
+            fprintf(stderr, "Could not move the main thread to CPU %d\n", housekeeping);
     }
 
-    latencies = (double **)malloc(sizeof(double *) * offsets);
+    if (contention) {
+        int status = RunContentionScaling(&topology, procIds, numProcs, outFilePath,
+                                          binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, contentionMs, &timer);
+        free(procIds);
+        free(procIndex);
+        freeTopology(&topology);
+        return status;
+    }
+
+    // Only one matrix per table is held at a time, each placement is streamed to its own files as rows complete
+    for (int t = 0; t < TABLE_COUNT; t++)
+        resultTables[t].values = (double *)malloc(sizeof(double) * numProcs * numProcs);
+    double *latenciesPtr = resultTables[TABLE_LATENCY].values;
     parallelTestState = (int *)malloc(sizeof(int) * numProcs * numProcs);
-    memset(latencies, 0, sizeof(double) * offsets);
-    bouncyArr = aligned_alloc(4096 * parallelismFactor, 4096);
-    if (bouncyArr == NULL) {
+    fprintf(stderr, "Kernel: %s (%s)\n", kernel->name, kernel->description);
+
+    // Every load level is a full pass over the homes and placements
+    if (loadKind >= 0) {
+        char levelList[256];
+        snprintf(levelList, sizeof(levelList), "%s", loadLevelArg);
+        loadLevelCount = 0;
+        for (char *token = strtok(levelList, ","); token != NULL && loadLevelCount < LOAD_LEVEL_MAX; token = strtok(NULL, ",")) {
+            int level = atoi(token);
+            loadLevels[loadLevelCount++] = level < 0 ? 0 : level > 100 ? 100 : level;
+        }
+        if (loadLevelCount == 0) {
+            fprintf(stderr, "No load levels to run\n");
+            return -1;
+        }
+    }
+
+    // A transfer run counts buffers, not round trips of one line
+    if (kernel->threadFunc == TransferTestThread && transferSize == 0)
+        transferSize = 64;
+    if (transferSize != 0) {
+        resultTables[TABLE_BANDWIDTH].enabled = 1;
+        if (!iterSet)
+            iter = TRANSFER_TOTAL_BYTES / transferSize > TRANSFER_MIN_COUNT ? TRANSFER_TOTAL_BYTES / transferSize : TRANSFER_MIN_COUNT;
+    }
+
+    uint64_t *interruptsBefore = (uint64_t *)calloc(topology.cpuCount, sizeof(uint64_t));
+    uint64_t *interruptsAfter = (uint64_t *)calloc(topology.cpuCount, sizeof(uint64_t));
+    if (guard)
+        PreflightCheck(procIds, numProcs);
+
+    // Workers open their own groups, a probe on this thread finds out which events the platform allows
+    if (countEvents) {
+        PerfCounterGroup probe;
+        countEvents = openPerfCounters(&probe) != 0;
+        fprintf(stderr, "Performance counters:");
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++) {
+            resultTables[TABLE_COUNTERS + counter].enabled = isPerfCounterAvailable(&probe, counter);
+            if (isPerfCounterAvailable(&probe, counter))
+                fprintf(stderr, " %s", getPerfCounterName(counter));
+        }
+        fprintf(stderr, countEvents ? "\n" : " none available, check perf_event_paranoid\n");
+        closePerfCounters(&probe);
+    }
+
+    int placementCount = 0;
+    if (sweep != NULL)
+        placementCount = ParseSweep(sweep, &topology, parallelismFactor, placements);
+    else if (offsets > PLACEMENT_MAX)
+        fprintf(stderr, "At most %d offsets can run\n", PLACEMENT_MAX);
+    else {
+        for (int offsetIdx = 0; offsetIdx < offsets; offsetIdx++) {
+            char name[32] = "";
+            if (offsetIdx != 0)
+                snprintf(name, sizeof(name), "_offset%d", offsetIdx);
+            placementCount = AddPlacement(placements, placementCount, name, 64 * offsetIdx, DEFAULT_PAIR_STRIDE);
+        }
+    }
+    if (placementCount == 0) {
+        fprintf(stderr, "No placements to run\n");
+        return -1;
+    }
+
+    // One region covers the widest placement, page aligned so in-page offsets mean the same thing in every run
+    size_t regionSize = 0;
+    for (int placementIdx = 0; placementIdx < placementCount; placementIdx++) {
+        size_t extent = placements[placementIdx].stride * (parallelismFactor - 1) + placements[placementIdx].offset + 64;
+        if (extent > regionSize)
+            regionSize = extent;
+    }
+    regionSize = (regionSize + 4095) & ~(size_t)4095;
+
+    // Strides past a page (the set preset) only keep the set index on huge pages, small pages map anywhere
+    int regionPages = PAGES_SMALL;
+    for (int placementIdx = 0; placementIdx < placementCount; placementIdx++)
+        if (placements[placementIdx].stride > DEFAULT_PAIR_STRIDE)
+            regionPages = PAGES_HUGE;
+    bouncyRegion = (char *)allocatePages(regionSize, regionPages);
+    if (bouncyRegion == NULL && regionPages == PAGES_HUGE) {
+        fprintf(stderr, "No huge pages reserved, set placements only share a set where transparent huge pages back the region\n");
+        regionPages = PAGES_TRANSPARENT;
+        bouncyRegion = (char *)allocatePages(regionSize, regionPages);
+    }
+    if (bouncyRegion == NULL) {
         fprintf(stderr, "Could not allocate aligned mem\n");
         return 0;
-    } 
+    }
+    if (regionPages != PAGES_SMALL && homeArg != NULL)
+        fprintf(stderr, "Warning: -home regions use small pages, set placements won't share a set there\n");
+
+    // Every home is a full pass over the placements, all nodes in turn gives the full cube
+    int *homes = (int *)malloc(sizeof(int) * (topology.nodeCount + 1));
+    int homeCount = 1;
+    homes[0] = HOME_FIRST_TOUCH;
+    if (homeArg != NULL) {
+        if (strcmp(homeArg, "proc1") == 0)
+            homes[0] = HOME_PROC1;
+        else if (strcmp(homeArg, "proc2") == 0)
+            homes[0] = HOME_PROC2;
+        else if (strcmp(homeArg, "all") == 0) {
+            for (int node = 0; node < topology.nodeCount; node++)
+                homes[node] = node;
+            homeCount = topology.nodeCount;
+        }
+        else if (*homeArg >= '0' && *homeArg <= '9' && atoi(homeArg) < topology.nodeCount)
+            homes[0] = atoi(homeArg);
+        else {
+            fprintf(stderr, "Unknown home %s\n", homeArg);
+            return -1;
+        }
+    }
+
+    // Any home but first touch needs a copy of the region bound to every node a target can land on
+    char **nodeRegions = (char **)calloc(topology.nodeCount, sizeof(char *));
+    if (homes[0] != HOME_FIRST_TOUCH) {
+        for (int node = 0; node < topology.nodeCount; node++) {
+            nodeRegions[node] = (char *)allocateOnNode(regionSize, node);
+            if (nodeRegions[node] == NULL) {
+                fprintf(stderr, "Could not bind the target region to node %d\n", node);
+                return -1;
+            }
+        }
+    }
+
+    // Every pair running side by side gets its own pair of transfer buffers
+    char *transferRegion = NULL;
+    if (transferSize != 0) {
+        transferRegion = (char *)allocateAligned(4096, 2 * transferSize * parallelismFactor);
+        if (transferRegion == NULL) {
+            fprintf(stderr, "Could not allocate transfer buffers\n");
+            return -1;
+        }
+        memset(transferRegion, 0, 2 * transferSize * parallelismFactor);
+    }
+
+    // One generator per CPU at most, and the lines the snoop storm fights over
+    LoadGeneratorData *generators = NULL;
+    uint64_t *snoopLines = NULL;
+    _Atomic int loadStop = 0;
+    if (loadKind >= 0) {
+        generators = (LoadGeneratorData *)allocateAligned(64, sizeof(LoadGeneratorData) * numProcs);
+        snoopLines = (uint64_t *)allocateAligned(4096, LOAD_SNOOP_BYTES);
+        if (generators == NULL || snoopLines == NULL) {
+            fprintf(stderr, "Could not allocate load generators\n");
+            return -1;
+        }
+        memset(generators, 0, sizeof(LoadGeneratorData) * numProcs);
+        memset(snoopLines, 0, LOAD_SNOOP_BYTES);
+    }
+    CnCWriter *loadCurve = NULL;
+    double loadCurveRow[2 + PAIR_CLASS_COUNT];
+    char loadCurveNames[2 + PAIR_CLASS_COUNT][256] = { "Intensity", "LoadGBps" };
+    for (int c = 0; c < PAIR_CLASS_COUNT; c++)
+        snprintf(loadCurveNames[2 + c], 256, "%s", getPairClassName(c));
+
+    // Pair data holds both sides' cache line aligned thread data, so it has to keep that alignment itself
+    LatencyPairRunData *pairRunData = (LatencyPairRunData *)allocateAligned(64, sizeof(LatencyPairRunData) * parallelismFactor);
+
+    // Workers are created and pinned once, so no run pays for thread creation or migration
+    ThreadPool *pool = createThreadPool(NULL, 0);
+    resultWriter = createAsyncWriter(housekeeping, 1, 0);
+    if (pairRunData == NULL || pool == NULL || resultWriter == NULL)
+        return AbortRun("Could not start the thread pool\n");
 
-    LatencyPairRunData *pairRunData = (LatencyPairRunData *)malloc(sizeof(LatencyPairRunData) * parallelismFactor);
+    // Every ordered pair gets scheduled once up front, pairs running side by side can't share a core (or LLC when asked).
+    // Sampling instead schedules each of its stages as it goes, from the class lists.
+    int isolation = isolateLlc ? SCHEDULE_ISOLATE_LLC : SCHEDULE_ISOLATE_CORE;
+    PairSchedule schedule = { 0 };
+    SchedulePair *stagePairs = NULL;
+    if (sampling) {
+        stagePairs = (SchedulePair *)malloc(sizeof(SchedulePair) * ((size_t)numProcs * numProcs + 1));
+        if (stagePairs == NULL || BuildClassSamples(&sample, procIds, numProcs, &topology, skipSmt) != 0)
+            return AbortRun("Could not build the pair samples\n");
+        for (int c = 0; c < PAIR_CLASS_COUNT; c++)
+            if (sample.pairCount[c] != 0)
+                fprintf(stderr, "%s: %d pairs\n", getPairClassName(c), sample.pairCount[c]);
+    }
+    else if (buildPairSchedule(&schedule, procIds, numProcs, parallelismFactor, &topology, isolation, skipSmt) != 0)
+        return AbortRun("Could not build the pair schedule\n");
+    else
+        fprintf(stderr, "Scheduled %d pairs in %d rounds\n", schedule.pairCount, schedule.batchCount);
+
+    // Allocate a place for all the column names to be placed, then fill it with names
+    char (*names)[256] = malloc(numProcs * (256 * sizeof(char)));
+    for (int i = 0; i < numProcs; i++)
+        snprintf(&names[i][0], 256, "Proc%u", procIds[i]);
 
-    for (int offsetIdx = 0; offsetIdx < offsets; offsetIdx++) {
-        latencies[offsetIdx] = (double *)malloc(sizeof(double) * numProcs * numProcs);
+    for (int runIdx = 0; runIdx < homeCount * placementCount * loadLevelCount; runIdx++) {
+        int levelIdx = runIdx % loadLevelCount;
+        Placement *placement = &placements[(runIdx / loadLevelCount) % placementCount];
+        int home = homes[runIdx / (loadLevelCount * placementCount)];
+        int loadLevel = loadLevels[levelIdx];
         memset(parallelTestState, 0, sizeof(int) * numProcs * numProcs);
-        double *latenciesPtr = latencies[offsetIdx];
-
-        while (1) {
-            // select parallelismFactor threads
-            int selectedParallelTestCount = 0;
-            memset(pairRunData, 0, sizeof(LatencyPairRunData) * parallelismFactor);
-            for (int i = 0;i < numProcs && selectedParallelTestCount < parallelismFactor; i++) {
-                for (int j = 0;j < numProcs && selectedParallelTestCount < parallelismFactor; j++) {
-                    if (j == i) { latenciesPtr[j + i * numProcs] = 0; continue; }
-                    if (parallelTestState[j + i * numProcs] == 1) {
-                        fprintf(stderr, "Thread unexpectedly did not complete\n");
-                        exit(0);
+        memset(sample.selected, 0, sizeof(sample.selected));
+
+        char homeName[32] = "";
+        if (home == HOME_PROC1 || home == HOME_PROC2)
+            snprintf(homeName, sizeof(homeName), "_homeproc%d", home == HOME_PROC1 ? 1 : 2);
+        else if (home >= 0)
+            snprintf(homeName, sizeof(homeName), "_home%d", home);
+
+        char placementFilePath[256], loadName[32] = "";
+        if (loadKind >= 0)
+            snprintf(loadName, sizeof(loadName), "_load%d", loadLevel);
+        if (snprintf(placementFilePath, sizeof(placementFilePath), "%s%s%s%s", outFilePath, placement->name, homeName, loadName) >= (int)sizeof(placementFilePath))
+            return AbortRun("Output path is too long\n");
+        for (int g = 0; g < numProcs && loadKind >= 0; g++) {
+            generators[g].kind = loadKind;
+            generators[g].intensity = loadLevel;
+            generators[g].bufferSize = LOAD_BUFFER_BYTES;
+            generators[g].snoopLines = snoopLines;
+            generators[g].timer = &timer;
+        }
+
+        char metadata[256];
+        int metadataLength = snprintf(metadata, sizeof(metadata), "kernel=%s iterations=%lu parallel=%d offset=%zu stride=%zu home=%s calibrate=%g budget_ms=%g",
+                 kernel->name, iter, parallelismFactor, placement->offset, placement->stride, homeName[0] ? homeName + 5 : "firsttouch",
+                 calibrate ? calibration.targetRelativeCI : 0.0, calibrate ? calibration.budgetNs / 1000000.0 : 0.0);
+        if (guard && metadataLength < (int)sizeof(metadata))
+            metadataLength += snprintf(metadata + metadataLength, sizeof(metadata) - metadataLength, " guard=%d", guardRetries);
+        if (transferSize != 0 && metadataLength < (int)sizeof(metadata))
+            metadataLength += snprintf(metadata + metadataLength, sizeof(metadata) - metadataLength, " transfer=%lu rfo=%u", transferSize, transferRfo);
+        if (loadKind >= 0 && metadataLength < (int)sizeof(metadata))
+            metadataLength += snprintf(metadata + metadataLength, sizeof(metadata) - metadataLength, " load=%s", loadKindNames[loadKind]);
+        if (sampling && metadataLength < (int)sizeof(metadata))
+            metadataLength += snprintf(metadata + metadataLength, sizeof(metadata) - metadataLength, " sample=%g sample_max=%d symmetric=%d seed=%lu",
+                     sample.targetRelativeCI, sample.maxPairs, sample.symmetricPairs, sample.seed);
+
+        // The load curve shares the metadata, without the intensity since every level is a row of it
+        char curveMetadata[256];
+        snprintf(curveMetadata, sizeof(curveMetadata), "%s", metadata);
+        if (loadKind >= 0 && metadataLength < (int)sizeof(metadata))
+            snprintf(metadata + metadataLength, sizeof(metadata) - metadataLength, " intensity=%d", loadLevel);
+        if (OpenResultTables(placementFilePath, numProcs, names, binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, metadata) != 0)
+            return AbortRun(NULL);
+        if (loadKind >= 0 && levelIdx == 0) {
+            char curvePath[256];
+            snprintf(curvePath, sizeof(curvePath), "%s%s%s_loadcurve", outFilePath, placement->name, homeName);
+            loadCurve = open_CNC(curvePath, 2 + PAIR_CLASS_COUNT, loadCurveNames, binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, curveMetadata);
+            if (loadCurve == NULL)
+                return AbortRun("Could not open %s.cnc for writing\n", curvePath);
+        }
+        int nextRow = 0;
+
+        // Pairs that never get measured (the diagonal and skipped SMT siblings) stay at the zero OpenResultTables left
+        for (int i = 0; i < numProcs; i++) {
+            for (int j = 0; j < numProcs; j++) {
+                int pairClass = getPairClass(&topology, procIds[i], procIds[j]);
+                resultTables[TABLE_CLASS].values[j + i * numProcs] = pairClass;
+                if (skipSmt && pairClass == PAIR_CLASS_SMT)
+                    parallelTestState[j + i * numProcs] = 2;
+            }
+        }
+
+        // Sampling runs a pilot stage and then a sized stage before inferring everything it didn't measure
+        for (int stage = 0; stage < (sampling ? 2 : 1); stage++) {
+            if (sampling) {
+                freePairSchedule(&schedule);
+                int stagePairCount = SelectSamplePairs(&sample, stage, latenciesPtr, procIndex, numProcs, stagePairs);
+                if (packPairSchedule(&schedule, stagePairs, stagePairCount, parallelismFactor, &topology, isolation) != 0)
+                    return AbortRun("Could not build the pair schedule\n");
+                asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Sampling stage %d: %d pairs in %d rounds\n", stage, schedule.pairCount, schedule.batchCount);
+            }
+
+            for (int batch = 0; batch < schedule.batchCount; batch++) {
+                int selectedParallelTestCount = schedule.batchStart[batch + 1] - schedule.batchStart[batch];
+                SchedulePair *batchPairs = schedule.pairs + schedule.batchStart[batch];
+                memset(pairRunData, 0, sizeof(LatencyPairRunData) * parallelismFactor);
+                for (int parallelIdx = 0; parallelIdx < selectedParallelTestCount; parallelIdx++) {
+                    pairRunData[parallelIdx].proc1 = batchPairs[parallelIdx].first;
+                    pairRunData[parallelIdx].proc2 = batchPairs[parallelIdx].second;
+                    pairRunData[parallelIdx].iter = iter;
+                    pairRunData[parallelIdx].timer = &timer;
+                    pairRunData[parallelIdx].sampleInterval = sampleInterval;
+                    pairRunData[parallelIdx].countEvents = countEvents;
+                    pairRunData[parallelIdx].guard = guard;
+                    pairRunData[parallelIdx].transferSize = transferSize;
+                    pairRunData[parallelIdx].transferRfo = transferRfo;
+                    if (transferRegion != NULL)
+                        pairRunData[parallelIdx].buffer = transferRegion + 2 * transferSize * parallelIdx;
+                    char *region = bouncyRegion;
+                    if (home == HOME_PROC1)
+                        region = nodeRegions[topology.cpus[batchPairs[parallelIdx].first].node];
+                    else if (home == HOME_PROC2)
+                        region = nodeRegions[topology.cpus[batchPairs[parallelIdx].second].node];
+                    else if (home >= 0)
+                        region = nodeRegions[home];
+                    pairRunData[parallelIdx].target = (uint64_t *)(region + placement->stride * parallelIdx + placement->offset);
+                    asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Selected %d -> %d\n", batchPairs[parallelIdx].first, batchPairs[parallelIdx].second);
+                }
+                asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Selected %d pairs for parallel testing\n", selectedParallelTestCount);
+
+                // Generators stay up for the whole round, retries included
+                int generatorCount = 0;
+                uint64_t loadBegin = 0;
+                if (loadKind >= 0 && loadLevel > 0) {
+                    generatorCount = StartLoadGenerators(pool, generators, pairRunData, selectedParallelTestCount,
+                                                         procIds, numProcs, &topology, &loadStop);
+                    loadBegin = timerBegin(&timer);
+                }
+
+                // The guard retries noisy pairs on their own, CheckPairNoise moves them to the front
+                int runCount = selectedParallelTestCount;
+                for (int attempt = 0; runCount != 0; attempt++) {
+                    uint64_t batchBegin = 0;
+                    if (guard) {
+                        getInterruptCounts(interruptsBefore, topology.cpuCount);
+                        batchBegin = timerBegin(&timer);
                     }
-                    if (parallelTestState[j + i * numProcs] == 0) {
-                        // neither thread can already have a pending run
-                        int validPair = 1;
-                        for (int c = 0; c < numProcs; c++) {
-                            if (parallelTestState[j + c * numProcs] == 1 || 
-                                parallelTestState[c + i * numProcs] == 1 ||
-                                parallelTestState[i + c * numProcs] == 1 ||
-                                parallelTestState[c + j * numProcs] == 1) {
-                                validPair = 0;
-                                break;
+
+                    if (calibrate) {
+                        calibration.maxIterations = iter;
+                        if (CalibratePairs(pool, pairRunData, runCount, kernel->threadFunc, &topology, &calibration) != 0) {
+                            AbortRun("Could not queue calibration runs on the thread pool\n");
+                            exit(0);
+                        }
+                    }
+                    else {
+                        // Queue both sides of every pair on the pinned workers, then collect them in order
+                        for (int parallelIdx = 0; parallelIdx < runCount; parallelIdx++) {
+                            if (StartTest(pool, pairRunData + parallelIdx, kernel->threadFunc) != 0) {
+                                AbortRun("Could not queue %d -> %d on the thread pool\n", pairRunData[parallelIdx].proc1, pairRunData[parallelIdx].proc2);
+                                exit(0);
                             }
                         }
-
-                        if (!validPair) continue;
-
-                        // for SMT enabled CPUs, check sibling threads. will do later
-                        parallelTestState[j + i * numProcs] = 1;
-                        pairRunData[selectedParallelTestCount].proc1 = i;
-                        pairRunData[selectedParallelTestCount].proc2 = j;
-                        pairRunData[selectedParallelTestCount].iter = iter;
-                        pairRunData[selectedParallelTestCount].result = 0.0f;
-                        pairRunData[selectedParallelTestCount].target = bouncyArr + (512 * selectedParallelTestCount + 8 * offsetIdx);
-                        fprintf(stderr, "Selected %d -> %d\n", i, j);
-                        selectedParallelTestCount++;
+                        for (int parallelIdx = 0; parallelIdx < runCount; parallelIdx++)
+                            FinishTest(pairRunData + parallelIdx);
                     }
+
+                    if (!guard)
+                        break;
+                    TimerResult batchElapsed;
+                    timerElapsed(&timer, batchBegin, timerEnd(&timer), &batchElapsed);
+                    getInterruptCounts(interruptsAfter, topology.cpuCount);
+                    runCount = CheckPairNoise(pairRunData, runCount, interruptsBefore, interruptsAfter,
+                                              batchElapsed.nanoseconds, iter, attempt < guardRetries);
+                    if (attempt == guardRetries)
+                        break;
+                    if (runCount != 0)
+                        asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "Retrying %d noisy pairs\n", runCount);
                 }
-            }
-            
-            if (selectedParallelTestCount == 0) break;
 
-            // Launch threads to test with
-            fprintf(stderr, "Selected %d pairs for parallel testing\n", selectedParallelTestCount);
-            pthread_t *testThreads = (pthread_t *)malloc(selectedParallelTestCount * sizeof(pthread_t));
-            memset(testThreads, 0, selectedParallelTestCount * sizeof(pthread_t));
-            for (int parallelIdx = 0; parallelIdx < selectedParallelTestCount; parallelIdx++) {
-                if (pairRunData[parallelIdx].proc1 == 0 && pairRunData[parallelIdx].proc2 == 0) break;
-                pthread_create(testThreads + parallelIdx, NULL, RunTest, (void *)(pairRunData + parallelIdx));
-            }
+                if (generatorCount != 0) {
+                    TimerResult loadElapsed;
+                    timerElapsed(&timer, loadBegin, timerEnd(&timer), &loadElapsed);
+                    double loadBandwidth = StopLoadGenerators(generators, generatorCount, &loadStop, loadElapsed.nanoseconds);
+                    asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d load generators: %f GB/s\n", generatorCount, loadBandwidth);
+                    for (int parallelIdx = 0; parallelIdx < selectedParallelTestCount; parallelIdx++)
+                        pairRunData[parallelIdx].results[TABLE_LOAD_BANDWIDTH] = loadBandwidth;
+                }
+
+                for (int parallelIdx = 0; parallelIdx < selectedParallelTestCount; parallelIdx++) {
+                    LatencyPairRunData *pair = &pairRunData[parallelIdx];
+                    if (calibrate)
+                        asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d to %d: %f ns +/- %f ns over %u batches of %lu\n", pair->proc1, pair->proc2,
+                                   pair->results[TABLE_LATENCY], pair->results[TABLE_CI], pair->batchCount, pair->iter);
+                    else
+                        asyncPrint(resultWriter, 0, ASYNC_RECORD_STDERR, "%d to %d: %f ns\n", pair->proc1, pair->proc2, pair->results[TABLE_LATENCY]);
+                    int i = procIndex[pair->proc1];
+                    int j = procIndex[pair->proc2];
+                    for (int t = 0; t < TABLE_COUNT; t++)
+                        if (t != TABLE_CLASS && t != TABLE_MEASURED) // Filled in up front from the topology and below
+                            resultTables[t].values[j + i * numProcs] = pair->results[t];
+                    resultTables[TABLE_MEASURED].values[j + i * numProcs] = 1;
+                    parallelTestState[j + i * numProcs] = 2;
+                    destroyHistogram(pair->histogram);
+                }
 
-            // Wait for threads to end
-            for (int parallelIdx = 0; parallelIdx < selectedParallelTestCount; parallelIdx++) {
-                pthread_join(testThreads[parallelIdx], NULL);
-                int i = pairRunData[parallelIdx].proc1;
-                int j = pairRunData[parallelIdx].proc2;
-                latenciesPtr[j + i * numProcs] = pairRunData[parallelIdx].result;
-                parallelTestState[j + i * numProcs] = 2;
+                // Stream out every row that is now complete so an interrupted run keeps its partial data
+                int rowsAppended = 0;
+                for (; nextRow < numProcs; nextRow++) {
+                    int complete = 1;
+                    for (int j = 0; j < numProcs && complete; j++)
+                        if (j != nextRow && parallelTestState[j + nextRow * numProcs] != 2)
+                            complete = 0;
+                    if (!complete)
+                        break;
+                    AppendResultRow(nextRow, numProcs);
+                    rowsAppended++;
+                }
+                if (rowsAppended != 0)
+                    FinishResultTables(0);
             }
 
-            free(testThreads);
         }
-    }
+        asyncSync(resultWriter);
+        if (loadKind >= 0 && loadKind != LOAD_SNOOP && loadLevel > 0)
+            ReleaseLoadBuffers(pool, generators, procIds, numProcs);
+        if (sampling)
+            InferUnmeasuredPairs(&sample, procIds, procIndex, numProcs, &topology, parallelTestState);
 
-    // Allocate a place for all the column names to be placed, then fill it with names
-    char (*names)[256] = malloc(numProcs * (256 * sizeof(char)));
-    for (int i = 0; i < numProcs; i++)
-        snprintf(&names[i][0], 256, "Proc%u\0", i);
-
-    if (write_CNC(
-        outFilePath,
-        latencies[0],
-        numProcs * numProcs,
-        numProcs,
-        names
-    ) != 0)
-        return -1;
+        // Rows whose only pairs were diagonal never show up in a round, pick them up before closing
+        for (; nextRow < numProcs; nextRow++)
+            AppendResultRow(nextRow, numProcs);
+        if (FinishResultTables(1) != 0)
+            return AbortRun(NULL);
 
-    // Print out data to the terminal
-    for (int offsetIdx = 0; offsetIdx < offsets; offsetIdx++) {
-        double *latenciesPtr = latencies[offsetIdx];
-        printf("Cache line offset: %d\n", offsetIdx);
+        // One point of the latency vs background bandwidth curve, averaged over every pair of each class
+        if (loadCurve != NULL) {
+            double classSum[PAIR_CLASS_COUNT] = { 0 }, loadSum = 0;
+            int classCount[PAIR_CLASS_COUNT] = { 0 }, loadCount = 0;
+            for (int cell = 0; cell < numProcs * numProcs; cell++) {
+                if (cell / numProcs == cell % numProcs || latenciesPtr[cell] == 0)
+                    continue;
+                int pairClass = getPairClass(&topology, procIds[cell / numProcs], procIds[cell % numProcs]);
+                classSum[pairClass] += latenciesPtr[cell];
+                classCount[pairClass]++;
+                loadSum += resultTables[TABLE_LOAD_BANDWIDTH].values[cell];
+                loadCount++;
+            }
+            loadCurveRow[0] = loadLevel;
+            loadCurveRow[1] = loadCount != 0 ? loadSum / loadCount : 0;
+            for (int c = 0; c < PAIR_CLASS_COUNT; c++)
+                loadCurveRow[2 + c] = classCount[c] != 0 ? classSum[c] / classCount[c] : 0;
+            if (append_CNC(loadCurve, loadCurveRow) != 0)
+                fprintf(stderr, "Could not write the load curve\n");
+            if (levelIdx == loadLevelCount - 1) {
+                if (close_CNC(loadCurve) != 0)
+                    return AbortRun(NULL);
+                loadCurve = NULL;
+            }
+            else
+                flush_CNC(loadCurve);
+        }
+
+        // Print out data to the terminal
+        printf("Placement: %s offset %zu bytes, pairs %zu bytes apart, home %s\n",
+               placement->name[0] ? placement->name + 1 : "default", placement->offset, placement->stride,
+               homeName[0] ? homeName + 5 : "first touch");
+        if (loadKind >= 0)
+            printf("Background load: %s at %d%%, %f GB/s\n", loadKindNames[loadKind], loadLevel, loadCurveRow[1]);
         
+        // Ping-pong kernels time round trips and print half of one, a transfer is already one way so it prints as is
+        double consoleDivisor = kernel->threadFunc == TransferTestThread ? 1 : 2;
+        if (kernel->threadFunc == TransferTestThread)
+            printf("ns per %lu byte buffer\n", transferSize);
+
         // Iterate over all possible processor combinations
         for (int i = 0;i < numProcs; i++) {
             for (int j = 0;j < numProcs; j++) {
@@ -301,18 +2358,47 @@ int main(int argc, char *argv[]) {
                 // If j and i are the same processors the just output an x.
                 if (j == i) printf("x");
                 // Print out the latency between processors j and i
-                // to maintain consistency, divide by 2 (see justification in windows version)
-                else printf("%f", latenciesPtr[j + i * numProcs] / 2);
+                else printf("%f", latenciesPtr[j + i * numProcs] / consoleDivisor);
             }
             printf("\n");
         }
-
-        free(latenciesPtr);
     }
 
+    // Counter groups belong to the workers that opened them, so each worker closes its own
+    if (countEvents) {
+        PoolJob *closeJobs = (PoolJob *)calloc(numProcs, sizeof(PoolJob));
+        int submitted = 0;
+        for (int i = 0; closeJobs != NULL && i < numProcs; i++) {
+            initJob(&closeJobs[submitted], CloseWorkerCounters, NULL);
+            submitted += submitJob(pool, procIds[i], &closeJobs[submitted]) == 0;
+        }
+        for (int i = 0; i < submitted; i++)
+            waitJob(&closeJobs[i]);
+        free(closeJobs);
+    }
+    free(names);
+    for (int t = 0; t < TABLE_COUNT; t++)
+        free(resultTables[t].values);
     free(parallelTestState);
-    free(pairRunData);
-    free(latencies);
-    free(bouncyArr);
+    free(interruptsBefore);
+    free(interruptsAfter);
+    free(procIds);
+    free(procIndex);
+    for (int node = 0; node < topology.nodeCount; node++)
+        freeOnNode(nodeRegions[node], regionSize);
+    free(nodeRegions);
+    free(homes);
+    freeTopology(&topology);
+    freePairSchedule(&schedule);
+    free(stagePairs);
+    for (int c = 0; c < PAIR_CLASS_COUNT && sampling; c++)
+        free(sample.pairs[c]);
+    destroyThreadPool(pool);
+    StopResultWriter();
+    freeAligned(pairRunData);
+    freePages(bouncyRegion, regionSize, regionPages);
+    freeAligned(transferRegion);
+    freeAligned(generators);
+    freeAligned(snoopLines);
     return 0;
 }
@@ -0,0 +1,576 @@
+/*
+ * Program Name: MemoryBandwidthTest
+ * File Name: main.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Measures memory bandwidth with STREAM style kernels across thread counts and NUMA nodes.
+ */
+
+#include <platformCode.h>
+#include <storage.h>
+#include <timing.h>
+#include <threadPool.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#define ARRAY_SIZE (256ULL << 20)  // Bytes per array over all threads, well past any last level cache
+#define REPEATS 10                 // Timed passes per kernel, the first one is a warm up
+#define CHUNK_ELEMENTS 32          // Every thread's slice is a multiple of four AVX-512 vectors
+
+// Instruction sets the kernels are built for, from least to most capable
+#define ISA_SCALAR 0
+#define ISA_SSE2 1
+#define ISA_AVX2 2
+#define ISA_AVX512 3
+#define ISA_COUNT 4
+
+static const char *isaNames[ISA_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+
+/* Every kernel takes the same arguments, read returns its sum so the loads can't be optimized out. */
+typedef double (*BandwidthKernelFunc)(double *a, double *b, double *c, size_t n, double scalar);
+
+/*
+ * Portable kernels, also the fallback on CPUs without SSE2.  The compiler is free to vectorize them, but
+ * non-temporal stores are only available through the intrinsics.
+ */
+static double CopyScalar(double *a, double *b, double *c, size_t n, double s) {
+    for (size_t i = 0; i < n; i++) c[i] = a[i];
+    return 0;
+}
+static double ScaleScalar(double *a, double *b, double *c, size_t n, double s) {
+    for (size_t i = 0; i < n; i++) b[i] = s * c[i];
+    return 0;
+}
+static double AddScalar(double *a, double *b, double *c, size_t n, double s) {
+    for (size_t i = 0; i < n; i++) c[i] = a[i] + b[i];
+    return 0;
+}
+static double TriadScalar(double *a, double *b, double *c, size_t n, double s) {
+    for (size_t i = 0; i < n; i++) a[i] = b[i] + s * c[i];
+    return 0;
+}
+static double ReadScalar(double *a, double *b, double *c, size_t n, double s) {
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for (size_t i = 0; i < n; i += 4) {
+        sum0 += a[i];
+        sum1 += a[i + 1];
+        sum2 += a[i + 2];
+        sum3 += a[i + 3];
+    }
+    return sum0 + sum1 + sum2 + sum3;
+}
+static double WriteScalar(double *a, double *b, double *c, size_t n, double s) {
+    for (size_t i = 0; i < n; i++) a[i] = s;
+    return 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+/*
+ * Stamps out the kernels for one instruction set.  Each function gets its own target attribute, so the file
+ * builds without -mavx2 or -mavx512f and only the dispatcher decides what runs.  Read keeps four accumulators
+ * so it's bound by the loads and not by the latency of the adds.
+ */
+#define DEFINE_KERNELS(isa, targetName, vector, width, load, store, stream, set1, add, mul, setzero)               \
+    __attribute__((target(targetName))) static double Copy##isa(double *a, double *b, double *c, size_t n, double s) { \
+        for (size_t i = 0; i < n; i += width) store(c + i, load(a + i));                                          \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double Scale##isa(double *a, double *b, double *c, size_t n, double s) { \
+        vector scalar = set1(s);                                                                                  \
+        for (size_t i = 0; i < n; i += width) store(b + i, mul(scalar, load(c + i)));                             \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double Add##isa(double *a, double *b, double *c, size_t n, double s) { \
+        for (size_t i = 0; i < n; i += width) store(c + i, add(load(a + i), load(b + i)));                        \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double Triad##isa(double *a, double *b, double *c, size_t n, double s) { \
+        vector scalar = set1(s);                                                                                  \
+        for (size_t i = 0; i < n; i += width) store(a + i, add(load(b + i), mul(scalar, load(c + i))));          \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double Read##isa(double *a, double *b, double *c, size_t n, double s) { \
+        vector sum0 = setzero(), sum1 = setzero(), sum2 = setzero(), sum3 = setzero();                            \
+        for (size_t i = 0; i < n; i += 4 * width) {                                                               \
+            sum0 = add(sum0, load(a + i));                                                                        \
+            sum1 = add(sum1, load(a + i + width));                                                                \
+            sum2 = add(sum2, load(a + i + 2 * width));                                                            \
+            sum3 = add(sum3, load(a + i + 3 * width));                                                            \
+        }                                                                                                         \
+        double lanes[width] __attribute__((aligned(64)));                                                         \
+        store(lanes, add(add(sum0, sum1), add(sum2, sum3)));                                                      \
+        double sum = 0;                                                                                           \
+        for (int lane = 0; lane < width; lane++) sum += lanes[lane];                                              \
+        return sum;                                                                                               \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double Write##isa(double *a, double *b, double *c, size_t n, double s) { \
+        vector scalar = set1(s);                                                                                  \
+        for (size_t i = 0; i < n; i += width) store(a + i, scalar);                                               \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double NtCopy##isa(double *a, double *b, double *c, size_t n, double s) { \
+        for (size_t i = 0; i < n; i += width) stream(c + i, load(a + i));                                         \
+        _mm_sfence();                                                                                             \
+        return 0;                                                                                                 \
+    }                                                                                                             \
+    __attribute__((target(targetName))) static double NtWrite##isa(double *a, double *b, double *c, size_t n, double s) { \
+        vector scalar = set1(s);                                                                                  \
+        for (size_t i = 0; i < n; i += width) stream(a + i, scalar);                                              \
+        _mm_sfence();                                                                                             \
+        return 0;                                                                                                 \
+    }
+
+DEFINE_KERNELS(Sse2, "sse2", __m128d, 2, _mm_load_pd, _mm_store_pd, _mm_stream_pd, _mm_set1_pd, _mm_add_pd,
+               _mm_mul_pd, _mm_setzero_pd)
+DEFINE_KERNELS(Avx2, "avx2", __m256d, 4, _mm256_load_pd, _mm256_store_pd, _mm256_stream_pd, _mm256_set1_pd,
+               _mm256_add_pd, _mm256_mul_pd, _mm256_setzero_pd)
+DEFINE_KERNELS(Avx512, "avx512f", __m512d, 8, _mm512_load_pd, _mm512_store_pd, _mm512_stream_pd, _mm512_set1_pd,
+               _mm512_add_pd, _mm512_mul_pd, _mm512_setzero_pd)
+
+#define X86_KERNELS(name) name##Sse2, name##Avx2, name##Avx512
+#else
+#define X86_KERNELS(name) NULL, NULL, NULL
+#endif
+
+typedef struct BandwidthKernel {
+    const char *name;
+    int bytesPerElement;  // STREAM convention, bytes read plus bytes written, write allocate traffic not counted
+    BandwidthKernelFunc func[ISA_COUNT];  // NULL where an instruction set can't run the kernel as intended
+} BandwidthKernel;
+
+static const BandwidthKernel bandwidthKernels[] = {
+    { "copy", 16, { CopyScalar, X86_KERNELS(Copy) } },
+    { "scale", 16, { ScaleScalar, X86_KERNELS(Scale) } },
+    { "add", 24, { AddScalar, X86_KERNELS(Add) } },
+    { "triad", 24, { TriadScalar, X86_KERNELS(Triad) } },
+    { "read", 8, { ReadScalar, X86_KERNELS(Read) } },
+    { "write", 8, { WriteScalar, X86_KERNELS(Write) } },
+    // Plain C has no streaming store, so these are left out rather than measured as an ordinary copy and write
+    { "ntcopy", 16, { NULL, X86_KERNELS(NtCopy) } },
+    { "ntwrite", 8, { NULL, X86_KERNELS(NtWrite) } },
+};
+#define KERNEL_COUNT (sizeof(bandwidthKernels) / sizeof(bandwidthKernels[0]))
+
+/*
+ * Finds the most capable instruction set this CPU and OS support.  __builtin_cpu_supports reads CPUID, and
+ * for AVX2 and AVX-512 also checks XGETBV so the OS saves the wider registers.
+ * @return: One of the ISA values.
+ */
+static int DetectIsa(void) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return ISA_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return ISA_SSE2;
+#endif
+    return ISA_SCALAR;
+}
+
+/* One thread's share of a run.  Timestamps are kept per kernel and pass, [kernel * repeats + pass]. */
+typedef struct __attribute__((aligned(64))) BandwidthThreadData {
+    double *a, *b, *c;
+    size_t n;
+    int isa;
+    int repeats;
+    size_t allocationSize;    // Bytes the worker allocates for its own arrays, 0 when they are handed in
+    int pageMode;
+    SpinBarrier *barrier;
+    const TimerInfo *timer;
+    uint64_t *begin;
+    uint64_t *end;
+    double sink;
+    PoolJob job;
+} BandwidthThreadData;
+
+/*
+ * Allocates and first touches a worker's own arrays, so they land on its node.
+ * @Param param: Pointer to the BandwidthThreadData to fill in.
+ * @return: NULL on success, non NULL if the arrays could not be allocated.
+ */
+void *AllocateThreadArrays(void *param) {
+    BandwidthThreadData *data = (BandwidthThreadData *)param;
+    double *arrays = (double *)allocatePages(data->allocationSize, data->pageMode);
+    if (arrays == NULL)
+        return param;
+    data->a = arrays;
+    data->b = arrays + data->n;
+    data->c = arrays + 2 * data->n;
+    for (size_t i = 0; i < data->n; i++) {
+        data->a[i] = 1.0;
+        data->b[i] = 2.0;
+        data->c[i] = 0.0;
+    }
+    return NULL;
+}
+
+/*
+ * Runs every kernel on one thread's slice, lined up with the other threads on the barrier before every pass.
+ * Kernels the instruction set has no version of are skipped, by every thread alike.
+ * @Param param: Pointer to the BandwidthThreadData to run.
+ * @return: Will always return NULL.
+ */
+void *BandwidthThread(void *param) {
+    BandwidthThreadData *data = (BandwidthThreadData *)param;
+    for (size_t k = 0; k < KERNEL_COUNT; k++) {
+        BandwidthKernelFunc func = bandwidthKernels[k].func[data->isa];
+        if (func == NULL)
+            continue;
+        for (int pass = 0; pass < data->repeats; pass++) {
+            spinBarrierWait(data->barrier);
+            data->begin[k * data->repeats + pass] = timerBegin(data->timer);
+            data->sink += func(data->a, data->b, data->c, data->n, 3.0);
+            data->end[k * data->repeats + pass] = timerEnd(data->timer);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Runs every kernel on a set of CPUs at once and works out the bandwidth of each.  A pass lasts from the
+ * first thread starting to the last one finishing, and the best pass after the warm up counts.
+ * @Param pool: Thread pool with a worker on every CPU in cpus.
+ * @Param cpus: CPUs to run on.
+ * @Param threadCount: Number of entries in cpus.
+ * @Param region: Arrays for every thread, three arrays of n doubles per thread back to back.  NULL to have every
+ *                worker allocate its own with pageMode.
+ * @Param n: Doubles per array and thread.
+ * @Param isa: Instruction set to run.
+ * @Param repeats: Passes per kernel.
+ * @Param pageMode: Page mode for arrays the workers allocate.
+ * @Param timer: A calibrated timer.
+ * @Param bandwidth: Receives GB/s for every kernel, NaN for kernels the instruction set can't run.
+ * @return: Zero on success.
+ */
+int RunBandwidth(ThreadPool *pool, const int *cpus, int threadCount, double *region, size_t n, int isa, int repeats,
+                 int pageMode, const TimerInfo *timer, double *bandwidth) {
+    BandwidthThreadData *threads = (BandwidthThreadData *)allocateAligned(64, sizeof(BandwidthThreadData) * threadCount);
+    uint64_t *stamps = (uint64_t *)malloc(sizeof(uint64_t) * 2 * KERNEL_COUNT * repeats * threadCount);
+    SpinBarrier barrier;
+    int status = 0, submitted = 0;
+    if (threads == NULL || stamps == NULL) {
+        freeAligned(threads);
+        free(stamps);
+        return -1;
+    }
+    initSpinBarrier(&barrier, threadCount);
+
+    for (int t = 0; t < threadCount; t++) {
+        BandwidthThreadData *data = &threads[t];
+        memset(data, 0, sizeof(BandwidthThreadData));
+        data->n = n;
+        data->isa = isa;
+        data->repeats = repeats;
+        data->pageMode = pageMode;
+        data->barrier = &barrier;
+        data->timer = timer;
+        data->begin = stamps + 2 * KERNEL_COUNT * repeats * t;
+        data->end = data->begin + KERNEL_COUNT * repeats;
+        if (region != NULL) {
+            data->a = region + 3 * n * t;
+            data->b = data->a + n;
+            data->c = data->b + n;
+        }
+        else {
+            data->allocationSize = 3 * n * sizeof(double);
+            initJob(&data->job, AllocateThreadArrays, data);
+            if (status == 0 && submitJob(pool, cpus[t], &data->job) == 0)
+                submitted++;
+            else
+                status = -1;
+        }
+    }
+    // Every queued allocation is waited for, even after a failure, so none is still running when the arrays are freed
+    for (int t = 0; t < submitted; t++)
+        if (waitJob(&threads[t].job) != NULL)
+            status = -1;
+
+    // Nothing is queued yet if anything failed, so no worker can be left waiting on the barrier
+    for (int t = 0; t < threadCount && status == 0; t++) {
+        initJob(&threads[t].job, BandwidthThread, &threads[t]);
+        if (submitJob(pool, cpus[t], &threads[t].job) != 0) {
+            fprintf(stderr, "Could not queue CPU %d on the thread pool\n", cpus[t]);
+            exit(0);
+        }
+    }
+    for (int t = 0; t < threadCount && status == 0; t++)
+        waitJob(&threads[t].job);
+
+    for (size_t k = 0; k < KERNEL_COUNT && status == 0; k++) {
+        if (bandwidthKernels[k].func[isa] == NULL) {
+            bandwidth[k] = NAN;
+            continue;
+        }
+        double best = 0;
+        for (int pass = repeats > 1 ? 1 : 0; pass < repeats; pass++) {
+            uint64_t first = UINT64_MAX, last = 0;
+            for (int t = 0; t < threadCount; t++) {
+                if (threads[t].begin[k * repeats + pass] < first)
+                    first = threads[t].begin[k * repeats + pass];
+                if (threads[t].end[k * repeats + pass] > last)
+                    last = threads[t].end[k * repeats + pass];
+            }
+            TimerResult elapsed;
+            timerElapsed(timer, first, last, &elapsed);
+            double gbPerSecond = (double)bandwidthKernels[k].bytesPerElement * n * threadCount / elapsed.nanoseconds;
+            if (gbPerSecond > best)
+                best = gbPerSecond;
+        }
+        bandwidth[k] = best;
+    }
+
+    for (int t = 0; t < threadCount && region == NULL; t++)
+        freePages(threads[t].a, threads[t].allocationSize, pageMode);
+    freeAligned(threads);
+    free(stamps);
+    return status;
+}
+
+/*
+ * Measures memory bandwidth with STREAM style kernels (copy, scale, add, triad, read, write, and copy and write with
+ * non-temporal stores), first across thread counts and optionally across every pair of NUMA nodes.
+ * @Param size: Bytes per array over all threads, with a K, M or G suffix, 256M by default.  Every kernel uses up
+ *              to three such arrays, split evenly between the threads.
+ * @Param repeats: Timed passes per kernel, the best one after the first counts.  10 by default.
+ * @Param isa: Most capable instruction set to use, scalar, sse2, avx2 or avx512.  By default the best one CPUID
+ *             reports.
+ * @Param threads: Comma separated thread counts to run, by default powers of two up to every online CPU, and
+ *                 every online CPU.  Threads go one per core first, in CPU ID order, then onto SMT siblings.
+ * @Param pages: small, thp or huge pages for the arrays, see allocatePages, also for the -numa runs.  small by
+ *              default.
+ * @Param numa: Also run every kernel with the cores of each node against memory bound to each node, and write
+ *              one node by node table per kernel to `<outfile>_numa_<kernel>.cnc`, rows are the CPU node and
+ *              columns the memory node.
+ * @Param outfile: File path for output data, automatically has `.cnc` appended.  Every row is a thread count,
+ *                 the first column holds the count and the rest GB/s per kernel.
+ * @Param binary: Write the output in the binary (version 2) .cnc format instead of text.
+ * @return: Status code, zero is successful.
+ */
+int main(int argc, char *argv[]) {
+    uint64_t arraySize = ARRAY_SIZE;
+    int repeats = REPEATS, pageMode = PAGES_SMALL, numa = 0, binaryOutput = 0;
+    int isa = DetectIsa();
+    char *outFilePath = "MemoryBandwidth", *threadList = NULL;
+    TimerInfo timer;
+
+    fprintf(stderr, "Instruction set: %s\n", isaNames[isa]);
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        if (*(argv[argIdx]) == '-') {
+            char* arg = argv[argIdx] + 1;
+            if (strncmp(arg, "size", 4) == 0) {
+                argIdx++;
+                char *end;
+                double value = strtod(argv[argIdx], &end);
+                arraySize = (uint64_t)(value * (*end == 'G' ? 1ULL << 30 : *end == 'M' ? 1ULL << 20 : *end == 'K' ? 1ULL << 10 : 1));
+            }
+            else if (strncmp(arg, "repeats", 7) == 0) {
+                argIdx++;
+                repeats = atoi(argv[argIdx]);
+            }
+            else if (strncmp(arg, "isa", 3) == 0) {
+                argIdx++;
+                int requested = -1;
+                for (int i = 0; i < ISA_COUNT; i++)
+                    if (strcmp(argv[argIdx], isaNames[i]) == 0)
+                        requested = i;
+                if (requested < 0) {
+                    fprintf(stderr, "Unknown instruction set %s\n", argv[argIdx]);
+                    return -1;
+                }
+                if (requested > isa)
+                    fprintf(stderr, "This CPU can't run %s, staying on %s\n", isaNames[requested], isaNames[isa]);
+                else
+                    isa = requested;
+            }
+            else if (strncmp(arg, "threads", 7) == 0) {
+                argIdx++;
+                threadList = argv[argIdx];
+            }
+            else if (strncmp(arg, "pages", 5) == 0) {
+                argIdx++;
+                if (strcmp(argv[argIdx], "small") == 0)
+                    pageMode = PAGES_SMALL;
+                else if (strcmp(argv[argIdx], "thp") == 0)
+                    pageMode = PAGES_TRANSPARENT;
+                else if (strcmp(argv[argIdx], "huge") == 0)
+                    pageMode = PAGES_HUGE;
+                else {
+                    fprintf(stderr, "Unknown page mode %s\n", argv[argIdx]);
+                    return -1;
+                }
+            }
+            else if (strncmp(arg, "numa", 4) == 0) {
+                numa = 1;
+            }
+            else if (strncmp(arg, "outfile", 7) == 0) {
+                argIdx++;
+                outFilePath = argv[argIdx];
+                fprintf(stderr, "Outputting data to %s\n", outFilePath);
+            }
+            else if (strncmp(arg, "binary", 6) == 0) {
+                fprintf(stderr, "Writing binary .cnc output\n");
+                binaryOutput = 1;
+            }
+        }
+    }
+    if (repeats < 1)
+        repeats = 1;
+    if (isa == ISA_SCALAR)
+        fprintf(stderr, "ntcopy and ntwrite need streaming stores, so they are skipped and written as nan\n");
+
+    CpuTopology topology;
+    if (getTopology(&topology) != 0) {
+        fprintf(stderr, "Could not read CPU topology\n");
+        return -1;
+    }
+    calibrateTimer(&timer);
+
+    // The first half of the curve never shares a core
+    int *cpuOrder = (int *)malloc(sizeof(int) * topology.cpuCount);
+    int cpuCount = cpuOrder != NULL ? orderCoresFirst(&topology, NULL, 0, cpuOrder) : 0;
+
+    int *threadCounts = (int *)malloc(sizeof(int) * (cpuCount + 64));
+    int threadCountCount = 0;
+    if (threadList != NULL) {
+        char list[256];
+        snprintf(list, sizeof(list), "%s", threadList);
+        for (char *token = strtok(list, ","); token != NULL && threadCountCount < cpuCount + 64; token = strtok(NULL, ",")) {
+            int count = atoi(token);
+            if (count < 1 || count > cpuCount) {
+                fprintf(stderr, "Can't run %s threads on %d CPUs\n", token, cpuCount);
+                return -1;
+            }
+            threadCounts[threadCountCount++] = count;
+        }
+    }
+    else {
+        for (int count = 1; count < cpuCount; count *= 2)
+            threadCounts[threadCountCount++] = count;
+        threadCounts[threadCountCount++] = cpuCount;
+    }
+
+    ThreadPool *pool = createThreadPool(NULL, 0);
+    if (pool == NULL || cpuOrder == NULL || threadCounts == NULL) {
+        fprintf(stderr, "Could not start the thread pool\n");
+        return -1;
+    }
+
+    char (*names)[256] = malloc((KERNEL_COUNT + 1) * (256 * sizeof(char)));
+    snprintf(names[0], 256, "Threads");
+    for (size_t k = 0; k < KERNEL_COUNT; k++)
+        snprintf(names[k + 1], 256, "%s", bandwidthKernels[k].name);
+    static const char *pageNames[] = { "small", "thp", "huge" };
+    char metadata[256];
+    snprintf(metadata, sizeof(metadata), "isa=%s size=%lu repeats=%d pages=%s", isaNames[isa], arraySize, repeats, pageNames[pageMode]);
+    CnCWriter *writer = open_CNC(outFilePath, KERNEL_COUNT + 1, names, binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, metadata);
+    if (writer == NULL) {
+        fprintf(stderr, "Could not open %s.cnc for writing\n", outFilePath);
+        return -1;
+    }
+
+    double row[KERNEL_COUNT + 1];
+    int status = 0;
+    printf("Threads");
+    for (size_t k = 0; k < KERNEL_COUNT; k++)
+        printf(",%s", bandwidthKernels[k].name);
+    printf("\n");
+    for (int countIdx = 0; countIdx < threadCountCount && status == 0; countIdx++) {
+        int threadCount = threadCounts[countIdx];
+        size_t n = arraySize / sizeof(double) / threadCount / CHUNK_ELEMENTS * CHUNK_ELEMENTS;
+        if (n == 0) {
+            fprintf(stderr, "Arrays are too small to split between %d threads\n", threadCount);
+            break;
+        }
+        row[0] = threadCount;
+        if (RunBandwidth(pool, cpuOrder, threadCount, NULL, n, isa, repeats, pageMode, &timer, row + 1) != 0) {
+            fprintf(stderr, "Could not allocate arrays for %d threads\n", threadCount);
+            status = -1;
+            break;
+        }
+        printf("%d", threadCount);
+        for (size_t k = 0; k < KERNEL_COUNT; k++)
+            printf(",%f", row[k + 1]);
+        printf("\n");
+        if (append_CNC(writer, row) != 0 || flush_CNC(writer) != 0)
+            fprintf(stderr, "Could not write the %d thread row\n", threadCount);
+    }
+    if (close_CNC(writer) != 0)
+        status = -1;
+
+    // Node by node tables, the cores of one node against memory bound to another
+    if (numa && status == 0) {
+        int nodes = topology.nodeCount;
+        double *tables = (double *)calloc((size_t)KERNEL_COUNT * nodes * nodes, sizeof(double));
+        int *nodeCpus = (int *)malloc(sizeof(int) * cpuCount);
+        for (int memoryNode = 0; memoryNode < nodes && tables != NULL && status == 0; memoryNode++) {
+            for (int cpuNode = 0; cpuNode < nodes; cpuNode++) {
+                int threadCount = 0;
+                for (int i = 0; i < cpuCount; i++)
+                    if (topology.cpus[cpuOrder[i]].node == cpuNode && topology.cpus[cpuOrder[i]].coreDomain == cpuOrder[i])
+                        nodeCpus[threadCount++] = cpuOrder[i];
+                if (threadCount == 0)
+                    continue;
+
+                size_t n = arraySize / sizeof(double) / threadCount / CHUNK_ELEMENTS * CHUNK_ELEMENTS;
+                size_t regionSize = 3 * n * threadCount * sizeof(double);
+                double *region = (double *)allocatePagesOnNode(regionSize, pageMode, memoryNode);
+                if (region == NULL) {
+                    fprintf(stderr, "Could not bind %zu bytes of %s pages to node %d\n", regionSize, pageNames[pageMode], memoryNode);
+                    status = -1;
+                    break;
+                }
+                double bandwidth[KERNEL_COUNT] = { 0 };
+                if (RunBandwidth(pool, nodeCpus, threadCount, region, n, isa, repeats, pageMode, &timer, bandwidth) != 0) {
+                    fprintf(stderr, "Could not run node %d cores against node %d memory\n", cpuNode, memoryNode);
+                    freePages(region, regionSize, pageMode);
+                    status = -1;
+                    break;
+                }
+                for (size_t k = 0; k < KERNEL_COUNT; k++)
+                    tables[(k * nodes + cpuNode) * nodes + memoryNode] = bandwidth[k];
+                fprintf(stderr, "Node %d cores, node %d memory: triad %f GB/s\n", cpuNode, memoryNode, bandwidth[3]);
+                freePages(region, regionSize, pageMode);
+            }
+        }
+
+        char (*nodeNames)[256] = malloc(nodes * (256 * sizeof(char)));
+        for (int node = 0; node < nodes; node++)
+            snprintf(nodeNames[node], 256, "Node%d", node);
+        for (size_t k = 0; k < KERNEL_COUNT && status == 0; k++) {
+            char tablePath[256];
+            snprintf(tablePath, sizeof(tablePath), "%s_numa_%s", outFilePath, bandwidthKernels[k].name);
+            CnCWriter *numaWriter = open_CNC(tablePath, nodes, nodeNames, binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, metadata);
+            if (numaWriter == NULL) {
+                fprintf(stderr, "Could not open %s.cnc for writing\n", tablePath);
+                status = -1;
+                break;
+            }
+            for (int cpuNode = 0; cpuNode < nodes; cpuNode++)
+                append_CNC(numaWriter, tables + (k * nodes + cpuNode) * nodes);
+            if (close_CNC(numaWriter) != 0)
+                status = -1;
+        }
+        free(nodeNames);
+        free(nodeCpus);
+        free(tables);
+    }
+
+    destroyThreadPool(pool);
+    free(names);
+    free(threadCounts);
+    free(cpuOrder);
+    freeTopology(&topology);
+    return status;
+}
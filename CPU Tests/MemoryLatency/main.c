@@ -0,0 +1,372 @@
+/*
+ * Program Name: MemoryLatencyTest
+ * File Name: main.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Maps the cache and memory latency hierarchy by chasing randomized pointers through growing working sets.
+ */
+
+#include <platformCode.h>
+#include <storage.h>
+#include <timing.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define ACCESSES 16777216          // Loads timed per working set and CPU
+#define MIN_SIZE 4096
+#define MAX_SIZE (2ULL << 30)
+#define STEPS_PER_DOUBLING 2       // Working sets between one power of two and the next, counting the power of two
+
+#define LAYOUT_RANDOM 0            // One random cycle through every line of the working set
+#define LAYOUT_TLB 1               // Pages in random order, each one's lines in random order before moving on
+
+#define SMALL_PAGE_SIZE 4096
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+/*
+ * Links every line of a working set into one cycle of pointers, the pointer sits at the start of its line.
+ * The random layout is Sattolo's algorithm run straight on the pointers, which always gives a single cycle and
+ * needs no index array even for working sets of several GiB.  The TLB friendly layout walks the pages in a
+ * random cycle and finishes every line of a page, in random order, before it moves on, so each page costs one
+ * TLB miss at most while the caches still see random lines.
+ * @Param buffer: Start of the working set.
+ * @Param size: Working set size in bytes, a multiple of stride.
+ * @Param stride: Distance between the lines in the chain.
+ * @Param pageSize: Page size the TLB friendly layout groups lines by.
+ * @Param layout: LAYOUT_RANDOM or LAYOUT_TLB.
+ * @Param state: Random state.
+ * @return: The first pointer of the chain, or NULL on allocation failure.
+ */
+void **BuildChain(char *buffer, size_t size, size_t stride, size_t pageSize, int layout, uint64_t *state) {
+    size_t lines = size / stride;
+
+    if (layout == LAYOUT_RANDOM || size <= pageSize) {
+        for (size_t line = 0; line < lines; line++)
+            *(void **)(buffer + line * stride) = buffer + line * stride;
+        for (size_t line = lines - 1; line > 0; line--) {
+            size_t other = nextRandom(state) % line;
+            void **a = (void **)(buffer + line * stride);
+            void **b = (void **)(buffer + other * stride);
+            void *swap = *a;
+            *a = *b;
+            *b = swap;
+        }
+        return (void **)buffer;
+    }
+
+    size_t pages = size / pageSize;
+    size_t linesPerPage = pageSize / stride;
+    size_t *pageOrder = (size_t *)malloc(sizeof(size_t) * pages);
+    size_t *lineOrder = (size_t *)malloc(sizeof(size_t) * linesPerPage);
+    if (pageOrder == NULL || lineOrder == NULL) {
+        free(pageOrder);
+        free(lineOrder);
+        return NULL;
+    }
+    for (size_t page = 0; page < pages; page++)
+        pageOrder[page] = page;
+    for (size_t page = pages - 1; page > 0; page--) {
+        size_t other = nextRandom(state) % (page + 1);
+        size_t swap = pageOrder[page];
+        pageOrder[page] = pageOrder[other];
+        pageOrder[other] = swap;
+    }
+    for (size_t line = 0; line < linesPerPage; line++)
+        lineOrder[line] = line;
+
+    // Each page gets its own shuffle, and its last line leads to the first line of the next page
+    char *previous = NULL, *first = NULL;
+    for (size_t page = 0; page < pages; page++) {
+        for (size_t line = linesPerPage - 1; line > 0; line--) {
+            size_t other = nextRandom(state) % (line + 1);
+            size_t swap = lineOrder[line];
+            lineOrder[line] = lineOrder[other];
+            lineOrder[other] = swap;
+        }
+        char *pageStart = buffer + pageOrder[page] * pageSize;
+        for (size_t line = 0; line < linesPerPage; line++) {
+            char *current = pageStart + lineOrder[line] * stride;
+            if (previous != NULL)
+                *(void **)previous = current;
+            else
+                first = current;
+            previous = current;
+        }
+    }
+    *(void **)previous = first;
+
+    // Lines past the last whole page are left out of the chain
+    free(pageOrder);
+    free(lineOrder);
+    return (void **)first;
+}
+
+/*
+ * Follows the chain, every load depends on the one before so the loads can't overlap.
+ * @Param start: Where to start.
+ * @Param count: Number of loads, rounded down to a multiple of 8.
+ * @return: Where the chase ended, so the loads can't be optimized out.
+ */
+void ** __attribute__((noinline)) Chase(void **start, uint64_t count) {
+    void **p = start;
+    for (uint64_t i = 0; i < count / 8; i++) {
+        p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+        p = (void **)*p; p = (void **)*p; p = (void **)*p; p = (void **)*p;
+    }
+    return p;
+}
+
+/*
+ * Parses a size with an optional K, M or G suffix.
+ * @return: The size in bytes, 0 if it doesn't parse.
+ */
+static uint64_t ParseSize(const char *text) {
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value <= 0)
+        return 0;
+    if (*end == 'K' || *end == 'k')
+        value *= 1024;
+    else if (*end == 'M' || *end == 'm')
+        value *= 1024 * 1024;
+    else if (*end == 'G' || *end == 'g')
+        value *= 1024.0 * 1024 * 1024;
+    return (uint64_t)value;
+}
+
+/*
+ * Measures load to use latency over a range of working set sizes on one or more CPUs, and then outputs the results.
+ * @Param accesses: Loads timed for every working set and CPU, 16M by default, at least 8.  Every chase also gets one untimed
+ *                  warm up pass over the working set (at most as long as the timed part).
+ * @Param min: Smallest working set, 4K by default.  Sizes take a K, M or G suffix.
+ * @Param max: Largest working set, 2G by default.  All of it is allocated up front.
+ * @Param steps: Working sets per doubling, 2 by default, so 4K, 5.7K, 8K, 11.3K and so on.
+ * @Param pages: small (4 KiB pages, transparent huge pages disabled), thp (transparent huge pages) or huge
+ *               (explicit huge pages from the reserved pool).  small by default.
+ * @Param layout: random (one random cycle over every line) or tlb (pages in random order, each finished before the
+ *                next, so the TLB only misses once per page).  Working sets are rounded down to whole pages.  random
+ *                by default.
+ * @Param stride: Bytes between lines in the chain, 64 by default.
+ * @Param cpus: Comma separated CPU IDs to run on, or all for every online CPU.  The test thread is pinned with
+ *              setAffinity for each of them in turn.  Memory is first touched from the first one, so the others
+ *              may see it on a remote node.  CPU 0 by default.
+ * @Param seed: Seed for the shuffles.
+ * @Param outfile: File path for output data, automatically has `.cnc` appended.  Every row is a working set,
+ *                 the first column holds its size in KiB and the rest the latency in ns on every CPU.
+ * @Param binary: Write the output in the binary (version 2) .cnc format instead of text.
+ * @return: Status code, zero is successful.
+ */
+int main(int argc, char *argv[]) {
+    uint64_t accesses = ACCESSES, minSize = MIN_SIZE, maxSize = MAX_SIZE, seed = 1;
+    int steps = STEPS_PER_DOUBLING, pageMode = PAGES_SMALL, layout = LAYOUT_RANDOM, binaryOutput = 0;
+    size_t stride = 64;
+    char *outFilePath = "MemoryLatency", *cpuList = "0";
+    TimerInfo timer;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++) {
+        if (*(argv[argIdx]) == '-') {
+            char* arg = argv[argIdx] + 1;
+            if (strncmp(arg, "accesses", 8) == 0) {
+                argIdx++;
+                accesses = strtoull(argv[argIdx], NULL, 10);
+                fprintf(stderr, "%lu accesses requested\n", accesses);
+            }
+            else if (strncmp(arg, "min", 3) == 0) {
+                argIdx++;
+                minSize = ParseSize(argv[argIdx]);
+            }
+            else if (strncmp(arg, "max", 3) == 0) {
+                argIdx++;
+                maxSize = ParseSize(argv[argIdx]);
+            }
+            else if (strncmp(arg, "steps", 5) == 0) {
+                argIdx++;
+                steps = atoi(argv[argIdx]);
+            }
+            else if (strncmp(arg, "pages", 5) == 0) {
+                argIdx++;
+                if (strcmp(argv[argIdx], "small") == 0)
+                    pageMode = PAGES_SMALL;
+                else if (strcmp(argv[argIdx], "thp") == 0)
+                    pageMode = PAGES_TRANSPARENT;
+                else if (strcmp(argv[argIdx], "huge") == 0)
+                    pageMode = PAGES_HUGE;
+                else {
+                    fprintf(stderr, "Unknown page mode %s\n", argv[argIdx]);
+                    return -1;
+                }
+            }
+            else if (strncmp(arg, "layout", 6) == 0) {
+                argIdx++;
+                if (strcmp(argv[argIdx], "random") == 0)
+                    layout = LAYOUT_RANDOM;
+                else if (strcmp(argv[argIdx], "tlb") == 0)
+                    layout = LAYOUT_TLB;
+                else {
+                    fprintf(stderr, "Unknown layout %s\n", argv[argIdx]);
+                    return -1;
+                }
+            }
+            else if (strncmp(arg, "stride", 6) == 0) {
+                argIdx++;
+                stride = strtoull(argv[argIdx], NULL, 10);
+            }
+            else if (strncmp(arg, "cpus", 4) == 0) {
+                argIdx++;
+                cpuList = argv[argIdx];
+            }
+            else if (strncmp(arg, "seed", 4) == 0) {
+                argIdx++;
+                seed = strtoull(argv[argIdx], NULL, 0);
+            }
+            else if (strncmp(arg, "outfile", 7) == 0) {
+                argIdx++;
+                outFilePath = argv[argIdx];
+                fprintf(stderr, "Outputting data to %s\n", outFilePath);
+            }
+            else if (strncmp(arg, "binary", 6) == 0) {
+                fprintf(stderr, "Writing binary .cnc output\n");
+                binaryOutput = 1;
+            }
+        }
+    }
+
+    if (stride < sizeof(void *) || minSize < stride || maxSize < minSize || steps < 1 || accesses < 8) {
+        fprintf(stderr, "Need stride >= %zu, min >= stride, max >= min, steps >= 1 and accesses >= 8\n", sizeof(void *));
+        return -1;
+    }
+
+    // CPUs to run on, in the order they were asked for
+    CpuTopology topology;
+    if (getTopology(&topology) != 0) {
+        fprintf(stderr, "Could not read CPU topology\n");
+        return -1;
+    }
+    int *cpus = (int *)malloc(sizeof(int) * topology.cpuCount);
+    int cpuCount = 0;
+    if (strcmp(cpuList, "all") == 0) {
+        for (int cpu = 0; cpu < topology.cpuCount; cpu++)
+            if (topology.cpus[cpu].online)
+                cpus[cpuCount++] = cpu;
+    }
+    else {
+        char list[256];
+        snprintf(list, sizeof(list), "%s", cpuList);
+        for (char *token = strtok(list, ","); token != NULL && cpuCount < topology.cpuCount; token = strtok(NULL, ",")) {
+            int cpu = atoi(token);
+            if (cpu < 0 || cpu >= topology.cpuCount || !topology.cpus[cpu].online) {
+                fprintf(stderr, "CPU %s is not online\n", token);
+                return -1;
+            }
+            cpus[cpuCount++] = cpu;
+        }
+    }
+    if (cpuCount == 0) {
+        fprintf(stderr, "No CPUs to run on\n");
+        return -1;
+    }
+
+    calibrateTimer(&timer);
+    fprintf(stderr, "Timer: %s at %.3f ticks/ns\n", timer.backend == TIMER_BACKEND_TSC ? "invariant TSC" : "clock_gettime",
+            timer.ticksPerNs);
+
+    // Pin first so the memory is first touched, and so placed, from the first CPU
+    if (setAffinity(pthread_self(), cpus[0]) != 0)
+        fprintf(stderr, "Could not pin to CPU %d\n", cpus[0]);
+    static const char *pageNames[] = { "small", "thp", "huge" };
+    char *buffer = (char *)allocatePages(maxSize, pageMode);
+    if (buffer == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes with %s pages\n", maxSize, pageNames[pageMode]);
+        return -1;
+    }
+    size_t pageSize = pageMode == PAGES_SMALL ? SMALL_PAGE_SIZE : HUGE_PAGE_SIZE;
+    if (layout == LAYOUT_TLB && stride > pageSize) {
+        fprintf(stderr, "The tlb layout needs a stride of at most a page, %zu bytes\n", pageSize);
+        return -1;
+    }
+
+    // Sizes go up a fixed ratio per step, rounded to whole lines and never repeated.  The tlb layout only chases
+    // whole pages, so its sizes are rounded to pages and sizes below one page are left out.
+    double ratio = pow(2.0, 1.0 / steps);
+    uint64_t granule = layout == LAYOUT_TLB ? pageSize : stride;
+    int sizeCount = 0;
+    uint64_t *sizes = (uint64_t *)malloc(sizeof(uint64_t) * (size_t)(steps * log2((double)maxSize / minSize) + 2));
+    for (double size = minSize; size <= maxSize * 1.000001; size *= ratio) {
+        uint64_t rounded = (uint64_t)size / granule * granule;
+        if (rounded != 0 && (sizeCount == 0 || rounded != sizes[sizeCount - 1]))
+            sizes[sizeCount++] = rounded;
+    }
+    if (sizeCount == 0) {
+        fprintf(stderr, "No working set between min and max holds a whole %zu byte page\n", pageSize);
+        return -1;
+    }
+
+    char (*names)[256] = malloc((cpuCount + 1) * (256 * sizeof(char)));
+    snprintf(names[0], 256, "SizeKiB");
+    for (int i = 0; i < cpuCount; i++)
+        snprintf(names[i + 1], 256, "Proc%d", cpus[i]);
+    char metadata[256];
+    snprintf(metadata, sizeof(metadata), "accesses=%lu pages=%s layout=%s stride=%zu seed=%lu", accesses,
+             pageNames[pageMode], layout == LAYOUT_TLB ? "tlb" : "random", stride, seed);
+    CnCWriter *writer = open_CNC(outFilePath, cpuCount + 1, names, binaryOutput ? CNC_FORMAT_BINARY : CNC_FORMAT_TEXT, metadata);
+    if (writer == NULL) {
+        fprintf(stderr, "Could not open %s.cnc for writing\n", outFilePath);
+        return -1;
+    }
+
+    double *row = (double *)malloc(sizeof(double) * (cpuCount + 1));
+    uint64_t state = seed != 0 ? seed : 1;
+    void **volatile sink;
+    printf("SizeKiB");
+    for (int i = 0; i < cpuCount; i++)
+        printf(",Proc%d", cpus[i]);
+    printf("\n");
+
+    for (int sizeIdx = 0; sizeIdx < sizeCount; sizeIdx++) {
+        uint64_t size = sizes[sizeIdx];
+        void **start = BuildChain(buffer, size, stride, pageSize, layout, &state);
+        if (start == NULL) {
+            fprintf(stderr, "Could not build the chain for %lu bytes\n", size);
+            return -1;
+        }
+
+        row[0] = size / 1024.0;
+        uint64_t lines = size / stride;
+        for (int i = 0; i < cpuCount; i++) {
+            if (i != 0 && setAffinity(pthread_self(), cpus[i]) != 0)
+                fprintf(stderr, "Could not pin to CPU %d\n", cpus[i]);
+
+            // One pass brings the working set into whatever level it fits in
+            sink = Chase(start, lines < accesses ? lines : accesses);
+            TimerResult elapsed;
+            uint64_t begin = timerBegin(&timer);
+            sink = Chase(start, accesses);
+            timerElapsed(&timer, begin, timerEnd(&timer), &elapsed);
+            row[i + 1] = elapsed.nanoseconds / (double)(accesses / 8 * 8);
+        }
+        if (cpuCount > 1)
+            setAffinity(pthread_self(), cpus[0]);
+
+        printf("%.2f", row[0]);
+        for (int i = 0; i < cpuCount; i++)
+            printf(",%f", row[i + 1]);
+        printf("\n");
+        if (append_CNC(writer, row) != 0 || flush_CNC(writer) != 0)
+            fprintf(stderr, "Could not write the %lu byte row\n", size);
+    }
+    (void)sink;
+
+    int status = close_CNC(writer) == 0 ? 0 : -1;
+    free(row);
+    free(names);
+    free(sizes);
+    free(cpus);
+    freePages(buffer, maxSize, pageMode);
+    freeTopology(&topology);
+    return status;
+}
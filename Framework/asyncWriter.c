@@ -0,0 +1,321 @@
+#include <platformCode.h>
+#include <asyncWriter.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: asyncWriter.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.3
+ * Purpose: Moves result files and console output off the measuring threads, onto one writer thread pinned to a
+ *          housekeeping CPU
+ */
+
+#define ASYNC_TEXT_LIMIT 1024
+
+static void sleepMicroseconds(long microseconds)
+{
+    struct timespec pause = { .tv_sec = 0, .tv_nsec = microseconds * 1000 };
+    nanosleep(&pause, NULL);
+}
+
+/*
+ * Claims room for a number of records on a ring.  Only looks at the writer's tail when the cached copy says the
+ * ring is full, so a producer normally only touches its own cache line.
+ * @Param block: Sleep until the writer thread makes room instead of dropping the records.
+ * @return: The position of the first record, or UINT64_MAX if there isn't room.
+ */
+static uint64_t reserveRecords(AsyncRing *ring, uint32_t count, int block)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head + count - ring->cachedTail > (uint64_t) ring->mask + 1) {
+        ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        // Waiting can't help records that don't fit in the whole ring
+        while (block && count <= ring->mask + 1 && head + count - ring->cachedTail > (uint64_t) ring->mask + 1) {
+            sleepMicroseconds(ASYNC_IDLE_US);
+            ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        }
+        if (head + count - ring->cachedTail > (uint64_t) ring->mask + 1) {
+            // Only the producer writes it, so a plain load and store is enough and keeps the add lock free
+            atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + count,
+                                  memory_order_relaxed);
+            return UINT64_MAX;
+        }
+    }
+    return head;
+}
+
+static void publishRecords(AsyncRing *ring, uint64_t head, uint32_t count)
+{
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+}
+
+/*
+ * Handles one record on the writer thread.
+ */
+static void handleRecord(AsyncWriter *writer, const AsyncRecord *record)
+{
+    AsyncStream *stream = record->stream < ASYNC_MAX_STREAMS ? &writer->streams[record->stream] : NULL;
+
+    switch (record->kind) {
+    case ASYNC_RECORD_ROW:
+        if (stream == NULL || stream->file == NULL)
+            return;
+        for (uint32_t i = 0; i < record->count; i++) {
+            stream->row[stream->filled++] = record->values[i];
+            if (stream->filled == stream->file->columnCount) {
+                if (append_CNC(stream->file, stream->row) != 0)
+                    fprintf(stderr, "Could not write a row to stream %u\n", record->stream);
+                stream->filled = 0;
+            }
+        }
+        break;
+    case ASYNC_RECORD_FLUSH:
+        if (stream != NULL && stream->file != NULL && flush_CNC(stream->file) != 0)
+            fprintf(stderr, "Could not flush stream %u\n", record->stream);
+        break;
+    case ASYNC_RECORD_STDOUT:
+    case ASYNC_RECORD_STDERR:
+        fwrite(record->text, 1, record->count, record->kind == ASYNC_RECORD_STDOUT ? stdout : stderr);
+        break;
+    }
+}
+
+/*
+ * Drains every ring in turn, and sleeps whenever they are all empty.  The tail only moves past a record once it
+ * has been handled, so asyncSync knows the files are up to date when the rings look empty.
+ */
+static void *asyncWriterThread(void *param)
+{
+    AsyncWriter *writer = (AsyncWriter *) param;
+
+    for (;;) {
+        int idle = 1;
+        for (int r = 0; r < writer->ringCount; r++) {
+            AsyncRing *ring = &writer->rings[r];
+            uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+            for (; tail != head; tail++) {
+                handleRecord(writer, &ring->records[tail & ring->mask]);
+                atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+                idle = 0;
+            }
+        }
+        if (!idle)
+            continue;
+
+        // Shutdown only counts once a full pass found nothing, so everything pushed before it gets written
+        if (atomic_load_explicit(&writer->shutdown, memory_order_acquire)) {
+            int empty = 1;
+            for (int r = 0; r < writer->ringCount && empty; r++)
+                empty = atomic_load(&writer->rings[r].head) == atomic_load(&writer->rings[r].tail);
+            if (empty)
+                break;
+            continue;
+        }
+        fflush(stdout);
+        sleepMicroseconds(ASYNC_IDLE_US);
+    }
+
+    fflush(stdout);
+    return NULL;
+}
+
+AsyncWriter *createAsyncWriter(int cpu, int ringCount, uint32_t ringRecords)
+{
+    if (ringCount < 1)
+        return NULL;
+    uint32_t size = 1;
+    while (size < (ringRecords != 0 ? ringRecords : ASYNC_RING_RECORDS) && size < (1U << 31))
+        size <<= 1;
+
+    AsyncWriter *writer = calloc(1, sizeof(AsyncWriter));
+    if (writer == NULL)
+        return NULL;
+    writer->cpu = cpu;
+    writer->ringCount = ringCount;
+    writer->rings = allocateAligned(64, sizeof(AsyncRing) * ringCount);
+    if (writer->rings == NULL) {
+        free(writer);
+        return NULL;
+    }
+    memset(writer->rings, 0, sizeof(AsyncRing) * ringCount);
+
+    int status = 0;
+    for (int r = 0; r < ringCount; r++) {
+        writer->rings[r].mask = size - 1;
+        writer->rings[r].records = allocateAligned(64, sizeof(AsyncRecord) * size);
+        if (writer->rings[r].records == NULL)
+            status = -1;
+    }
+
+    // Pinned from the calling thread, so a CPU that can't be used is reported before anything gets queued
+    if (status == 0 && pthread_create(&writer->thread, NULL, asyncWriterThread, writer) != 0)
+        status = -1;
+    else if (status == 0 && cpu >= 0 && setAffinity(writer->thread, cpu) != 0) {
+        fprintf(stderr, "Could not pin the writer thread to CPU %d\n", cpu);
+        atomic_store(&writer->shutdown, 1);
+        pthread_join(writer->thread, NULL);
+        status = -1;
+    }
+
+    if (status != 0) {
+        for (int r = 0; r < ringCount; r++)
+            freeAligned(writer->rings[r].records);
+        freeAligned(writer->rings);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void destroyAsyncWriter(AsyncWriter *writer)
+{
+    atomic_store_explicit(&writer->shutdown, 1, memory_order_release);
+    pthread_join(writer->thread, NULL);
+
+    for (int s = 0; s < ASYNC_MAX_STREAMS; s++) {
+        if (writer->streams[s].file != NULL)
+            flush_CNC(writer->streams[s].file);
+        free(writer->streams[s].row);
+    }
+    for (int r = 0; r < writer->ringCount; r++)
+        freeAligned(writer->rings[r].records);
+    freeAligned(writer->rings);
+    free(writer);
+}
+
+int setAsyncStream(AsyncWriter *writer, int stream, CnCWriter *file)
+{
+    if (stream < 0 || stream >= ASYNC_MAX_STREAMS)
+        return -1;
+
+    AsyncStream *target = &writer->streams[stream];
+    free(target->row);
+    target->row = NULL;
+    target->filled = 0;
+    target->file = NULL;
+    if (file == NULL)
+        return 0;
+    target->row = malloc(sizeof(double) * file->columnCount);
+    if (target->row == NULL)
+        return -1;
+    target->file = file;
+    return 0;
+}
+
+static int appendRow(AsyncWriter *writer, int ring, int stream, const double *row, int block)
+{
+    if (ring < 0 || ring >= writer->ringCount || stream < 0 || stream >= ASYNC_MAX_STREAMS)
+        return -1;
+    AsyncRing *target = &writer->rings[ring];
+    CnCWriter *file = writer->streams[stream].file;
+    if (file == NULL)
+        return -1;
+
+    // The whole row is reserved at once, so a full ring never leaves half a row behind
+    uint32_t recordCount = (file->columnCount + ASYNC_RECORD_VALUES - 1) / ASYNC_RECORD_VALUES;
+    uint64_t head = reserveRecords(target, recordCount, block);
+    if (head == UINT64_MAX)
+        return -1;
+    for (uint32_t r = 0; r < recordCount; r++) {
+        AsyncRecord *record = &target->records[(head + r) & target->mask];
+        uint32_t first = r * ASYNC_RECORD_VALUES;
+        record->kind = ASYNC_RECORD_ROW;
+        record->stream = (uint16_t) stream;
+        record->count = file->columnCount - first < ASYNC_RECORD_VALUES ? file->columnCount - first : ASYNC_RECORD_VALUES;
+        memcpy(record->values, row + first, sizeof(double) * record->count);
+    }
+    publishRecords(target, head, recordCount);
+    return 0;
+}
+
+int asyncAppendRow(AsyncWriter *writer, int ring, int stream, const double *row)
+{
+    return appendRow(writer, ring, stream, row, 0);
+}
+
+int asyncAppendRowBlocking(AsyncWriter *writer, int ring, int stream, const double *row)
+{
+    return appendRow(writer, ring, stream, row, 1);
+}
+
+static int queueFlush(AsyncWriter *writer, int ring, int stream, int block)
+{
+    if (ring < 0 || ring >= writer->ringCount || stream < 0 || stream >= ASYNC_MAX_STREAMS)
+        return -1;
+    AsyncRing *target = &writer->rings[ring];
+    uint64_t head = reserveRecords(target, 1, block);
+    if (head == UINT64_MAX)
+        return -1;
+    AsyncRecord *record = &target->records[head & target->mask];
+    record->kind = ASYNC_RECORD_FLUSH;
+    record->stream = (uint16_t) stream;
+    record->count = 0;
+    publishRecords(target, head, 1);
+    return 0;
+}
+
+int asyncFlush(AsyncWriter *writer, int ring, int stream)
+{
+    return queueFlush(writer, ring, stream, 0);
+}
+
+int asyncFlushBlocking(AsyncWriter *writer, int ring, int stream)
+{
+    return queueFlush(writer, ring, stream, 1);
+}
+
+int asyncPrint(AsyncWriter *writer, int ring, int kind, const char *format, ...)
+{
+    char text[ASYNC_TEXT_LIMIT];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < 0)
+        return -1;
+    if (length >= (int) sizeof(text))
+        length = sizeof(text) - 1;
+
+    if (ring < 0 || ring >= writer->ringCount)
+        return -1;
+    AsyncRing *target = &writer->rings[ring];
+    uint32_t recordCount = length != 0 ? (length + sizeof(((AsyncRecord *) 0)->text) - 1) / sizeof(((AsyncRecord *) 0)->text) : 1;
+    uint64_t head = reserveRecords(target, recordCount, 0);
+    if (head == UINT64_MAX)
+        return -1;
+    for (uint32_t r = 0; r < recordCount; r++) {
+        AsyncRecord *record = &target->records[(head + r) & target->mask];
+        uint32_t first = r * sizeof(record->text);
+        record->kind = (uint16_t) kind;
+        record->stream = 0;
+        record->count = length - first < sizeof(record->text) ? length - first : sizeof(record->text);
+        memcpy(record->text, text + first, record->count);
+    }
+    publishRecords(target, head, recordCount);
+    return 0;
+}
+
+void asyncSync(AsyncWriter *writer)
+{
+    for (int r = 0; r < writer->ringCount; r++) {
+        AsyncRing *ring = &writer->rings[r];
+        uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        while (atomic_load_explicit(&ring->tail, memory_order_acquire) < head)
+            sleepMicroseconds(ASYNC_IDLE_US);
+    }
+}
+
+uint64_t getAsyncDropped(AsyncWriter *writer)
+{
+    uint64_t dropped = 0;
+    for (int r = 0; r < writer->ringCount; r++)
+        dropped += atomic_load_explicit(&writer->rings[r].dropped, memory_order_relaxed);
+    return dropped;
+}
@@ -0,0 +1,147 @@
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: asyncWriter.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.3
+ * Purpose: Moves result files and console output off the measuring threads, onto one writer thread pinned to a
+ *          housekeeping CPU
+ */
+
+#include <platformCode.h>
+#include <storage.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define ASYNC_RECORD_VALUES 31     // Values per record, rows that are longer take several records
+#define ASYNC_RING_RECORDS 4096    // Default records per ring, must be a power of two
+#define ASYNC_MAX_STREAMS 64       // .cnc files one writer can feed at once
+#define ASYNC_IDLE_US 100          // How long the writer thread sleeps when every ring is empty
+
+#define ASYNC_RECORD_ROW 0         // Values for a stream, gathered into rows by the writer thread
+#define ASYNC_RECORD_FLUSH 1       // Flush a stream
+#define ASYNC_RECORD_STDOUT 2      // Text for stdout
+#define ASYNC_RECORD_STDERR 3      // Text for stderr
+
+/* Every record is the same size, a whole number of cache lines. */
+typedef struct AsyncRecord {
+    uint16_t kind;
+    uint16_t stream;
+    uint32_t count;  // Values, or bytes of text, in this record
+    union {
+        double values[ASYNC_RECORD_VALUES];
+        char text[ASYNC_RECORD_VALUES * sizeof(double)];
+    };
+} AsyncRecord;
+
+/* Single producer, single consumer ring.  Each end keeps its position on its own cache line. */
+typedef struct __attribute__((aligned(64))) AsyncRing {
+    _Atomic uint64_t head;           // Records pushed, only written by the producer
+    uint64_t cachedTail;             // Producer's last look at tail, saves touching the consumer's line
+    _Atomic uint64_t dropped;        // Records the producer had to discard because the ring was full, read by any thread
+    _Atomic uint64_t tail __attribute__((aligned(64))); // Records consumed, only written by the writer thread
+    uint32_t mask;
+    AsyncRecord *records;
+} AsyncRing;
+
+/* A stream gathers values into whole rows before appending them to its .cnc file. */
+typedef struct AsyncStream {
+    CnCWriter *file;
+    double *row;
+    uint32_t filled;
+} AsyncStream;
+
+typedef struct AsyncWriter {
+    pthread_t thread;
+    int cpu;               // Housekeeping CPU the writer thread is pinned to, -1 if it isn't pinned
+    int ringCount;
+    AsyncRing *rings;
+    AsyncStream streams[ASYNC_MAX_STREAMS];
+    _Atomic int shutdown;
+} AsyncWriter;
+
+/*
+ * Starts the writer thread.
+ * @Param cpu: Housekeeping CPU to pin the writer thread to, -1 to leave it unpinned.  Keep it off the CPUs being
+ *             measured.
+ * @Param ringCount: Number of producers, every thread that pushes records needs a ring of its own.
+ * @Param ringRecords: Records per ring, rounded up to a power of two, 0 for ASYNC_RING_RECORDS.
+ * @Return: The writer, or NULL if it could not be started or pinned.
+ */
+AsyncWriter *createAsyncWriter(int cpu, int ringCount, uint32_t ringRecords);
+
+/*
+ * Drains every ring, stops the writer thread and releases the writer.  Streams are flushed but not closed.
+ * @Param writer: The writer to destroy.
+ */
+void destroyAsyncWriter(AsyncWriter *writer);
+
+/*
+ * Attaches a .cnc file to a stream ID, or detaches it.  Only call it while nothing is queued for the stream,
+ * for example right after asyncSync.
+ * @Param writer: The writer.
+ * @Param stream: Stream ID, below ASYNC_MAX_STREAMS.
+ * @Param file: The file rows for the stream go to, NULL to detach it.
+ * @Return: 0 if successful, -1 if the stream ID is out of range or the row buffer could not be allocated.
+ */
+int setAsyncStream(AsyncWriter *writer, int stream, CnCWriter *file);
+
+/*
+ * Queues a row for a stream.  Never blocks and never makes a system call.  A row that doesn't fit in the ring is
+ * dropped whole and counted, only one ring at a time may feed a stream.
+ * @Param writer: The writer.
+ * @Param ring: The calling thread's ring.
+ * @Param stream: The stream the row is for.
+ * @Param row: The stream file's columnCount values.
+ * @Return: 0 if queued, -1 if the ring was full or the ring or stream ID is out of range.
+ */
+int asyncAppendRow(AsyncWriter *writer, int ring, int stream, const double *row);
+
+/*
+ * Queues a row like asyncAppendRow, but sleeps until the writer thread makes room when the ring is full, so only
+ * call it between measurements.  Only a row longer than the whole ring is dropped.
+ * @Return: 0 if queued, -1 if the row can never fit or the ring or stream ID is out of range.
+ */
+int asyncAppendRowBlocking(AsyncWriter *writer, int ring, int stream, const double *row);
+
+/*
+ * Queues a flush of a stream's file, after every row queued before it on the same ring.
+ * @Return: 0 if queued, -1 if the ring was full or the ring or stream ID is out of range.
+ */
+int asyncFlush(AsyncWriter *writer, int ring, int stream);
+
+/*
+ * Queues a flush like asyncFlush, but sleeps until the writer thread makes room when the ring is full.
+ * @Return: 0 if queued, -1 if the ring or stream ID is out of range.
+ */
+int asyncFlushBlocking(AsyncWriter *writer, int ring, int stream);
+
+/*
+ * Formats text on the calling thread and queues it for the console.  Never blocks, text over 1 KiB is truncated.
+ * @Param writer: The writer.
+ * @Param ring: The calling thread's ring.
+ * @Param kind: ASYNC_RECORD_STDOUT or ASYNC_RECORD_STDERR.
+ * @Param format: printf format string.
+ * @Return: 0 if queued, -1 if the ring was full or the ring ID is out of range.
+ */
+int asyncPrint(AsyncWriter *writer, int ring, int kind, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+/*
+ * Waits until the writer thread has handled everything queued so far, on every ring.  Sleeps while it waits, so
+ * only call it between measurements.
+ * @Param writer: The writer.
+ */
+void asyncSync(AsyncWriter *writer);
+
+/*
+ * Sums the records discarded on every ring because it was full.  Records a blocking call waited for room for are
+ * not counted.  Safe to call from any thread while producers are still pushing, the sum then only covers what was
+ * counted so far.
+ * @Param writer: The writer.
+ * @Return: The number of dropped records.
+ */
+uint64_t getAsyncDropped(AsyncWriter *writer);
+
+#endif // ASYNCWRITER_H
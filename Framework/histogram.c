@@ -0,0 +1,90 @@
+#include <platformCode.h>
+#include <string.h>
+#include <stdint.h>
+#include <histogram.h>
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: histogram.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Provides fixed size log-linear (HDR style) histograms for recording latency samples
+ */
+
+LatencyHistogram *createHistogram()
+{
+    LatencyHistogram *histogram = allocateAligned(64, sizeof(LatencyHistogram));
+    if (histogram != NULL)
+        resetHistogram(histogram);
+    return histogram;
+}
+
+void destroyHistogram(LatencyHistogram *histogram)
+{
+    freeAligned(histogram);
+}
+
+void resetHistogram(LatencyHistogram *histogram)
+{
+    memset(histogram, 0, sizeof(LatencyHistogram));
+    histogram->minValue = UINT64_MAX;
+}
+
+/*
+ * Returns the smallest and largest value that land in a bucket.
+ */
+static void bucketRange(uint32_t bucket, uint64_t *lowest, uint64_t *highest)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        *lowest = *highest = bucket;
+        return;
+    }
+    uint32_t shift = bucket / HISTOGRAM_HALF_BUCKETS - 1;
+    uint64_t subBucket = bucket - (uint64_t) shift * HISTOGRAM_HALF_BUCKETS;
+    *lowest = subBucket << shift;
+    *highest = *lowest + ((1ULL << shift) - 1);
+}
+
+void mergeHistogram(LatencyHistogram *destination, const LatencyHistogram *source)
+{
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+        destination->counts[i] += source->counts[i];
+    destination->totalCount += source->totalCount;
+    if (source->maxValue > destination->maxValue)
+        destination->maxValue = source->maxValue;
+    if (source->minValue < destination->minValue)
+        destination->minValue = source->minValue;
+}
+
+uint64_t histogramPercentile(const LatencyHistogram *histogram, double percentile)
+{
+    if (histogram->totalCount == 0)
+        return 0;
+    if (percentile >= 100)
+        return histogram->maxValue;
+    if (percentile <= 0)
+        return histogram->minValue;
+
+    // Rank of the sample we're after, counting from 1
+    uint64_t rank = (uint64_t) (percentile / 100.0 * histogram->totalCount + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint64_t lowest, highest;
+            bucketRange(i, &lowest, &highest);
+            uint64_t value = lowest + (highest - lowest) / 2;
+            // Never report past the values actually seen
+            if (value > histogram->maxValue)
+                value = histogram->maxValue;
+            if (value < histogram->minValue)
+                value = histogram->minValue;
+            return value;
+        }
+    }
+    return histogram->maxValue;
+}
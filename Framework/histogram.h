@@ -0,0 +1,95 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: histogram.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Provides fixed size log-linear (HDR style) histograms for recording latency samples
+ */
+
+#include <stdint.h>
+
+/* Values below HISTOGRAM_SUB_BUCKETS are counted exactly.  Above that every power of two is split into
+ * HISTOGRAM_SUB_BUCKETS / 2 linear buckets, so any recorded value is known to within about 3%.
+ * The bucket array covers the full uint64_t range, recording can never fail or allocate.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 6
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_HALF_BUCKETS (HISTOGRAM_SUB_BUCKETS / 2)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_HALF_BUCKETS)
+
+/* Histograms are meant to be owned by a single thread while recording, so nothing in here is atomic.
+ * Give every thread its own and merge them once the threads are done.
+ */
+typedef struct __attribute__((aligned(64))) LatencyHistogram {
+    uint64_t totalCount;
+    uint64_t minValue;
+    uint64_t maxValue;
+    uint64_t counts[HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+/*
+ * Allocates a cache line aligned histogram and touches every bucket so recording never page faults.
+ * @Return: The new histogram, or NULL on failure.
+ */
+LatencyHistogram *createHistogram();
+
+/*
+ * Releases a histogram from createHistogram.
+ * @Param histogram: The histogram to release, NULL is ignored.
+ */
+void destroyHistogram(LatencyHistogram *histogram);
+
+/*
+ * Clears all counts.
+ * @Param histogram: The histogram to clear.
+ */
+void resetHistogram(LatencyHistogram *histogram);
+
+/*
+ * Maps a value to its bucket.
+ * @Param value: The value to look up.
+ * @Return: The bucket index, always below HISTOGRAM_BUCKETS.
+ */
+static inline uint32_t histogramBucket(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS)
+        return (uint32_t) value;
+    uint32_t shift = (63 - __builtin_clzll(value)) - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    return shift * HISTOGRAM_HALF_BUCKETS + (uint32_t) (value >> shift);
+}
+
+/*
+ * Counts one value.  Inline and branch light so it can sit inside measurement loops.
+ * @Param histogram: The histogram owned by the calling thread.
+ * @Param value: The value to count.
+ */
+static inline void recordHistogram(LatencyHistogram *histogram, uint64_t value)
+{
+    histogram->counts[histogramBucket(value)]++;
+    histogram->totalCount++;
+    if (value > histogram->maxValue)
+        histogram->maxValue = value;
+    if (value < histogram->minValue)
+        histogram->minValue = value;
+}
+
+/*
+ * Adds every count from one histogram into another.
+ * @Param destination: The histogram receiving the counts.
+ * @Param source: The histogram to add, left untouched.
+ */
+void mergeHistogram(LatencyHistogram *destination, const LatencyHistogram *source);
+
+/*
+ * Finds the value at a percentile, reported as the midpoint of the bucket it falls in.  The 100th
+ * percentile is the exact maximum.
+ * @Param histogram: The histogram to query.
+ * @Param percentile: Percentile between 0 and 100.
+ * @Return: The value at the percentile, or 0 if the histogram is empty.
+ */
+uint64_t histogramPercentile(const LatencyHistogram *histogram, double percentile);
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,218 @@
+#include <platformCode.h>
+#include <pairScheduler.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: pairScheduler.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.3
+ * Purpose: Builds round-robin schedules that run every ordered CPU pair once, many pairs at a time
+ */
+
+/* A batch that can still take pairs.  busy marks CPU IDs in use and, offset by idLimit, occupied domains. */
+typedef struct OpenBatch {
+    int batch;
+    int count;
+    unsigned char *busy;
+} OpenBatch;
+
+/*
+ * Finds the domain a CPU occupies under an isolation level, domains are named by their lowest CPU ID.
+ */
+static int isolationDomain(const CpuTopology *topology, int cpu, int isolation)
+{
+    if (topology == NULL || cpu >= topology->cpuCount)
+        return cpu;
+    if (isolation == SCHEDULE_ISOLATE_LLC)
+        return topology->cpus[cpu].llcDomain;
+    if (isolation == SCHEDULE_ISOLATE_CORE)
+        return topology->cpus[cpu].coreDomain;
+    return cpu;
+}
+
+int buildPairSchedule(PairSchedule *schedule, const int *cpus, int cpuCount, int width,
+                      const CpuTopology *topology, int isolation, int skipSmt)
+{
+    memset(schedule, 0, sizeof(PairSchedule));
+
+    // Circle method needs an even number of seats, an odd count gets an empty seat that sits out each round
+    int seats = cpuCount + (cpuCount & 1);
+    int maxPairs = cpuCount * (cpuCount - 1);
+    if (maxPairs < 1)
+        maxPairs = 1;
+    SchedulePair *ordered = (SchedulePair *) malloc(maxPairs * sizeof(SchedulePair));
+    if (ordered == NULL)
+        return -1;
+
+    int pairCount = 0;
+
+    // Narrow schedules take the rows a few at a time, each block's sources against every CPU in rotation, so rows
+    // finish all through the run and can be streamed out.  Blocks of at least two batches' worth of rows keep the
+    // packing as tight as the tournament's.
+    int blockCount = cpuCount / (2 * (width < 1 ? 1 : width));
+    for (int block = 0; blockCount > 1 && block < blockCount; block++) {
+        int blockBegin = cpuCount * block / blockCount;
+        int blockEnd = cpuCount * (block + 1) / blockCount;
+        for (int shift = 1; shift < cpuCount; shift++) {
+            for (int a = blockBegin; a < blockEnd; a++) {
+                int b = (a + shift) % cpuCount;
+                if (skipSmt && topology != NULL && getPairClass(topology, cpus[a], cpus[b]) == PAIR_CLASS_SMT)
+                    continue;
+                ordered[pairCount].first = cpus[a];
+                ordered[pairCount].second = cpus[b];
+                pairCount++;
+            }
+        }
+    }
+
+    // Wide schedules keep every CPU busy in every round, so no row can finish early anyway
+    for (int direction = 0; blockCount <= 1 && direction < 2; direction++) {
+        for (int round = 0; round < seats - 1; round++) {
+            for (int k = 0; k < seats / 2; k++) {
+                // Seat seats - 1 stays put while everyone else rotates one seat per round
+                int a = (k == 0) ? seats - 1 : (round + k) % (seats - 1);
+                int b = (round - k + seats - 1) % (seats - 1);
+                if (a >= cpuCount || b >= cpuCount)
+                    continue;
+                // Alternate who goes first so no CPU always leads, the second direction flips every pair
+                if ((k & 1) ^ direction) {
+                    int swap = a;
+                    a = b;
+                    b = swap;
+                }
+                if (skipSmt && topology != NULL && getPairClass(topology, cpus[a], cpus[b]) == PAIR_CLASS_SMT)
+                    continue;
+                ordered[pairCount].first = cpus[a];
+                ordered[pairCount].second = cpus[b];
+                pairCount++;
+            }
+        }
+    }
+
+    int result = packPairSchedule(schedule, ordered, pairCount, width, topology, isolation);
+    free(ordered);
+    return result;
+}
+
+int packPairSchedule(PairSchedule *schedule, const SchedulePair *ordered, int pairCount, int width,
+                     const CpuTopology *topology, int isolation)
+{
+    memset(schedule, 0, sizeof(PairSchedule));
+    if (width < 1)
+        width = 1;
+    if (topology == NULL)
+        isolation = SCHEDULE_ISOLATE_NONE;
+
+    int idLimit = 1;
+    for (int p = 0; p < pairCount; p++) {
+        if (ordered[p].first + 1 > idLimit)
+            idLimit = ordered[p].first + 1;
+        if (ordered[p].second + 1 > idLimit)
+            idLimit = ordered[p].second + 1;
+    }
+    if (topology != NULL && topology->cpuCount > idLimit)
+        idLimit = topology->cpuCount;
+
+    int maxPairs = pairCount < 1 ? 1 : pairCount;
+    int *pairBatch = (int *) malloc(maxPairs * sizeof(int));
+    unsigned char *busyStorage = (unsigned char *) calloc(SCHEDULE_OPEN_BATCHES, 2 * idLimit);
+    if (pairBatch == NULL || busyStorage == NULL) {
+        free(pairBatch);
+        free(busyStorage);
+        return -1;
+    }
+
+    // First fit into the open batches.  Pairs are disjoint within a round, so without isolation every
+    // round fills its batches exactly and the search only ever looks at the newest batch.
+    // Every entry owns one busy map for good, closing a batch just rotates its map to the unused end
+    OpenBatch open[SCHEDULE_OPEN_BATCHES];
+    for (int o = 0; o < SCHEDULE_OPEN_BATCHES; o++)
+        open[o].busy = busyStorage + o * 2 * idLimit;
+    int openCount = 0;
+    int batchCount = 0;
+    for (int p = 0; p < pairCount; p++) {
+        int first = ordered[p].first;
+        int second = ordered[p].second;
+        int firstDomain = isolationDomain(topology, first, isolation);
+        int secondDomain = isolationDomain(topology, second, isolation);
+
+        int slot = -1;
+        for (int o = 0; o < openCount && slot < 0; o++) {
+            unsigned char *busy = open[o].busy;
+            if (busy[first] || busy[second])
+                continue;
+            if (isolation != SCHEDULE_ISOLATE_NONE && (busy[idLimit + firstDomain] || busy[idLimit + secondDomain]))
+                continue;
+            slot = o;
+        }
+
+        if (slot < 0) {
+            // Out of room, the oldest open batch runs as it is
+            if (openCount == SCHEDULE_OPEN_BATCHES) {
+                unsigned char *recycled = open[0].busy;
+                memmove(open, open + 1, (SCHEDULE_OPEN_BATCHES - 1) * sizeof(OpenBatch));
+                openCount--;
+                open[openCount].busy = recycled;
+            }
+            memset(open[openCount].busy, 0, 2 * idLimit);
+            open[openCount].batch = batchCount++;
+            open[openCount].count = 0;
+            slot = openCount++;
+        }
+
+        OpenBatch *target = &open[slot];
+        pairBatch[p] = target->batch;
+        target->busy[first] = target->busy[second] = 1;
+        target->busy[idLimit + firstDomain] = target->busy[idLimit + secondDomain] = 1;
+        if (++target->count == width) {
+            unsigned char *recycled = target->busy;
+            memmove(target, target + 1, (openCount - slot - 1) * sizeof(OpenBatch));
+            openCount--;
+            open[openCount].busy = recycled;
+        }
+    }
+
+    // Counting sort by batch keeps each batch's pairs in the order they came in
+    schedule->pairs = (SchedulePair *) malloc(maxPairs * sizeof(SchedulePair));
+    schedule->batchStart = (int *) calloc(batchCount + 1, sizeof(int));
+    if (schedule->pairs == NULL || schedule->batchStart == NULL) {
+        free(pairBatch);
+        free(busyStorage);
+        freePairSchedule(schedule);
+        return -1;
+    }
+    for (int p = 0; p < pairCount; p++)
+        schedule->batchStart[pairBatch[p] + 1]++;
+    for (int b = 0; b < batchCount; b++)
+        schedule->batchStart[b + 1] += schedule->batchStart[b];
+    int *cursor = (int *) malloc((batchCount + 1) * sizeof(int));
+    if (cursor == NULL) {
+        free(pairBatch);
+        free(busyStorage);
+        freePairSchedule(schedule);
+        return -1;
+    }
+    memcpy(cursor, schedule->batchStart, (batchCount + 1) * sizeof(int));
+    for (int p = 0; p < pairCount; p++)
+        schedule->pairs[cursor[pairBatch[p]]++] = ordered[p];
+
+    schedule->pairCount = pairCount;
+    schedule->batchCount = batchCount;
+    free(cursor);
+    free(pairBatch);
+    free(busyStorage);
+    return 0;
+}
+
+void freePairSchedule(PairSchedule *schedule)
+{
+    free(schedule->pairs);
+    free(schedule->batchStart);
+    schedule->pairs = NULL;
+    schedule->batchStart = NULL;
+    schedule->pairCount = 0;
+    schedule->batchCount = 0;
+}
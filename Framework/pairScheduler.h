@@ -0,0 +1,75 @@
+#ifndef PAIRSCHEDULER_H
+#define PAIRSCHEDULER_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: pairScheduler.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.3
+ * Purpose: Builds round-robin schedules that run every ordered CPU pair once, many pairs at a time
+ */
+
+#include <platformCode.h>
+
+#define SCHEDULE_ISOLATE_NONE 0 // Concurrent pairs only have to use different CPUs
+#define SCHEDULE_ISOLATE_CORE 1 // Concurrent pairs can't share a physical core
+#define SCHEDULE_ISOLATE_LLC 2  // Concurrent pairs can't share a last level cache
+
+#define SCHEDULE_OPEN_BATCHES 32 // Partially filled batches kept around for later pairs to fill in
+
+/* One directed measurement, first is the side that makes the first handoff. */
+typedef struct SchedulePair {
+    int first;
+    int second;
+} SchedulePair;
+
+/* Pairs grouped into batches that can run at the same time.  Batch b is pairs[batchStart[b]] up to,
+ * but not including, pairs[batchStart[b + 1]].
+ */
+typedef struct PairSchedule {
+    int pairCount;
+    int batchCount;
+    SchedulePair *pairs;
+    int *batchStart;
+} PairSchedule;
+
+/*
+ * Builds a schedule covering every ordered pair of distinct CPUs.  When at least two blocks of 2 * width
+ * rows fit, the rows (first CPUs) are taken one block at a time, so rows complete steadily through the run.
+ * Wider schedules come from a round-robin tournament (circle method), so each of its cpuCount - 1 rounds
+ * (one more for an odd count) is a perfect matching, and every round is played in both directions.  Pairs
+ * are then packed into batches no wider than width, merging leftovers when an isolation constraint splits
+ * a round up.
+ * @Param schedule: Filled in on success, release it with freePairSchedule.
+ * @Param cpus: CPU IDs to schedule.
+ * @Param cpuCount: Number of entries in cpus.
+ * @Param width: Most pairs allowed in one batch, anything below 1 is treated as 1.
+ * @Param topology: Used for isolation and skipSmt, may be NULL when neither is needed.
+ * @Param isolation: One of the SCHEDULE_ISOLATE values.
+ * @Param skipSmt: Leave out pairs of SMT siblings.
+ * @Return: 0 on success, -1 on allocation failure.
+ */
+int buildPairSchedule(PairSchedule *schedule, const int *cpus, int cpuCount, int width,
+                      const CpuTopology *topology, int isolation, int skipSmt);
+
+/*
+ * Packs an explicit list of pairs into batches the same way buildPairSchedule does, for callers that
+ * only want some of the pairs.  Pairs keep their relative order inside each batch.
+ * @Param schedule: Filled in on success, release it with freePairSchedule.
+ * @Param pairs: The pairs to run, in the order they should be considered.
+ * @Param pairCount: Number of entries in pairs.
+ * @Param width: Most pairs allowed in one batch, anything below 1 is treated as 1.
+ * @Param topology: Used for isolation, may be NULL when it isn't needed.
+ * @Param isolation: One of the SCHEDULE_ISOLATE values.
+ * @Return: 0 on success, -1 on allocation failure.
+ */
+int packPairSchedule(PairSchedule *schedule, const SchedulePair *pairs, int pairCount, int width,
+                     const CpuTopology *topology, int isolation);
+
+/*
+ * Releases a schedule from buildPairSchedule.
+ * @Param schedule: The schedule to release.
+ */
+void freePairSchedule(PairSchedule *schedule);
+
+#endif // PAIRSCHEDULER_H
@@ -0,0 +1,199 @@
+#include <perfCounters.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: perfCounters.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Reads per-thread hardware performance counters around a measured region through perf_event_open
+ */
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* Layout of a read() on a group leader opened with PERF_COUNTER_READ_FORMAT */
+#define PERF_COUNTER_READ_FORMAT (PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING)
+typedef struct PerfGroupReading {
+    uint64_t count;
+    uint64_t timeEnabled;
+    uint64_t timeRunning;
+    struct {
+        uint64_t value;
+        uint64_t id;
+    } entries[PERF_COUNTER_COUNT];
+} PerfGroupReading;
+
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} perfEvents[PERF_COUNTER_COUNT] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_REF_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+};
+
+static int readGroup(const PerfCounterGroup *group, PerfGroupReading *reading)
+{
+    ssize_t expected = (ssize_t)(3 + 2 * group->available) * sizeof(uint64_t);
+    return read(group->leaderFd, reading, sizeof(PerfGroupReading)) == expected ? 0 : -1;
+}
+
+/*
+ * Checks that the group can still be put on the hardware.  A group that needs more counters than the CPU has
+ * is never scheduled at all, so after a short spin its running time is still zero.
+ */
+static int groupIsScheduled(const PerfCounterGroup *group)
+{
+    PerfGroupReading before, after;
+    if (readGroup(group, &before) != 0)
+        return 0;
+    for (volatile int spin = 0; spin < 100000; spin++);
+    if (readGroup(group, &after) != 0)
+        return 0;
+    return after.timeRunning != before.timeRunning;
+}
+
+int openPerfCounters(PerfCounterGroup *group)
+{
+    memset(group, 0, sizeof(PerfCounterGroup));
+    group->leaderFd = -1;
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+        group->fds[counter] = -1;
+
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perfEvents[counter].type;
+        attr.config = perfEvents[counter].config;
+        attr.read_format = PERF_COUNTER_READ_FORMAT;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group->leaderFd, 0);
+        if (fd < 0)
+            continue;
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &group->ids[counter]) != 0) {
+            close(fd);
+            continue;
+        }
+
+        int leader = group->leaderFd < 0;
+        if (leader)
+            group->leaderFd = fd;
+        group->fds[counter] = fd;
+        group->available++;
+
+        // Drop any event that pushes the group past what the hardware can count at once
+        if (!groupIsScheduled(group)) {
+            close(fd);
+            group->fds[counter] = -1;
+            group->available--;
+            if (leader)
+                group->leaderFd = -1;
+        }
+    }
+    return group->available;
+}
+
+void closePerfCounters(PerfCounterGroup *group)
+{
+    // Members go first, the leader holds the group together
+    for (int counter = PERF_COUNTER_COUNT - 1; counter >= 0; counter--) {
+        if (group->fds[counter] >= 0 && group->fds[counter] != group->leaderFd)
+            close(group->fds[counter]);
+        group->fds[counter] = -1;
+    }
+    if (group->leaderFd >= 0)
+        close(group->leaderFd);
+    group->leaderFd = -1;
+    group->available = 0;
+}
+
+int startPerfCounters(PerfCounterGroup *group)
+{
+    PerfGroupReading reading;
+    if (group->available == 0)
+        return 0;
+    if (readGroup(group, &reading) != 0)
+        return -1;
+
+    group->startEnabled = reading.timeEnabled;
+    group->startRunning = reading.timeRunning;
+    for (uint64_t entry = 0; entry < reading.count; entry++)
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+            if (group->fds[counter] >= 0 && group->ids[counter] == reading.entries[entry].id)
+                group->start[counter] = reading.entries[entry].value;
+    return 0;
+}
+
+int stopPerfCounters(PerfCounterGroup *group)
+{
+    PerfGroupReading reading;
+    if (group->available == 0)
+        return 0;
+    if (readGroup(group, &reading) != 0)
+        return -1;
+
+    uint64_t enabled = reading.timeEnabled - group->startEnabled;
+    uint64_t running = reading.timeRunning - group->startRunning;
+    double scale = (running != 0 && running < enabled) ? (double)enabled / running : 1.0;
+    for (uint64_t entry = 0; entry < reading.count; entry++)
+        for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+            if (group->fds[counter] >= 0 && group->ids[counter] == reading.entries[entry].id)
+                group->values[counter] = (uint64_t)((reading.entries[entry].value - group->start[counter]) * scale);
+    return 0;
+}
+
+#else
+
+int openPerfCounters(PerfCounterGroup *group)
+{
+    memset(group, 0, sizeof(PerfCounterGroup));
+    group->leaderFd = -1;
+    for (int counter = 0; counter < PERF_COUNTER_COUNT; counter++)
+        group->fds[counter] = -1;
+    return 0;
+}
+
+void closePerfCounters(PerfCounterGroup *group)
+{
+    group->available = 0;
+}
+
+int startPerfCounters(PerfCounterGroup *group)
+{
+    return 0;
+}
+
+int stopPerfCounters(PerfCounterGroup *group)
+{
+    return 0;
+}
+
+#endif
+
+int isPerfCounterAvailable(const PerfCounterGroup *group, int counter)
+{
+    return counter >= 0 && counter < PERF_COUNTER_COUNT && group->fds[counter] >= 0;
+}
+
+const char *getPerfCounterName(int counter)
+{
+    static const char *names[PERF_COUNTER_COUNT] = {
+        "cycles", "refcycles", "instructions", "cachereferences", "cachemisses", "l1dmisses", "llcmisses"
+    };
+    return (counter >= 0 && counter < PERF_COUNTER_COUNT) ? names[counter] : "unknown";
+}
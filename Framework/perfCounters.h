@@ -0,0 +1,80 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: perfCounters.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Reads per-thread hardware performance counters around a measured region through perf_event_open
+ */
+
+#include <stdint.h>
+
+#define PERF_COUNTER_CYCLES 0
+#define PERF_COUNTER_REF_CYCLES 1        // Cycles at the constant reference rate, cycles / ref cycles tracks the clock
+#define PERF_COUNTER_INSTRUCTIONS 2
+#define PERF_COUNTER_CACHE_REFERENCES 3
+#define PERF_COUNTER_CACHE_MISSES 4
+#define PERF_COUNTER_L1D_MISSES 5        // L1 data cache read misses
+#define PERF_COUNTER_LLC_MISSES 6        // Last level cache read misses
+#define PERF_COUNTER_COUNT 7
+
+/* One group of counters that only counts the thread that opened it.  The whole group is read in one go, so a
+ * start and a stop cost one read() each.  Events the kernel or the CPU won't allow are left out, and a group
+ * with no events at all turns start and stop into no-ops.
+ */
+typedef struct PerfCounterGroup {
+    int leaderFd;                        // -1 when no event could be opened
+    int fds[PERF_COUNTER_COUNT];         // -1 for every unavailable event
+    uint64_t ids[PERF_COUNTER_COUNT];    // Kernel IDs, used to match up the entries of a group read
+    uint64_t start[PERF_COUNTER_COUNT];
+    uint64_t startEnabled;
+    uint64_t startRunning;
+    uint64_t values[PERF_COUNTER_COUNT]; // Counts between the last start and stop, 0 for unavailable events
+    int available;                       // Number of events opened
+} PerfCounterGroup;
+
+/*
+ * Opens the counters for the calling thread and leaves them counting.  Only user space is counted, so it
+ * works at the default perf_event_paranoid setting.
+ * @Param group: The group to fill in.
+ * @Return: The number of events that could be opened, 0 if the platform doesn't allow any.
+ */
+int openPerfCounters(PerfCounterGroup *group);
+
+/*
+ * Closes every counter of a group.
+ * @Param group: The group to close.
+ */
+void closePerfCounters(PerfCounterGroup *group);
+
+/*
+ * Snapshots the counters at the start of a region.  Has to run on the thread that opened the group.
+ * @Param group: An open group.
+ * @Return: 0 if successful, -1 if the counters could not be read.
+ */
+int startPerfCounters(PerfCounterGroup *group);
+
+/*
+ * Snapshots the counters at the end of a region and stores the counts since startPerfCounters in values.
+ * If the kernel had to multiplex the group, counts are scaled up to the full region.
+ * @Param group: An open group.
+ * @Return: 0 if successful, -1 if the counters could not be read.
+ */
+int stopPerfCounters(PerfCounterGroup *group);
+
+/*
+ * Checks whether an event was opened.
+ * @Param group: An open group.
+ * @Param counter: One of the PERF_COUNTER values.
+ * @Return: Non zero if the event is counting.
+ */
+int isPerfCounterAvailable(const PerfCounterGroup *group, int counter);
+
+/*
+ * Gets a short printable name for a PERF_COUNTER value, also usable as a file suffix.
+ */
+const char *getPerfCounterName(int counter);
+
+#endif // PERFCOUNTERS_H
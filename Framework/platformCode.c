@@ -3,64 +3,319 @@
  * Program Name: CnC Common Headers
  * File Name: platformCode.c
  * Date Created: October 27, 2024
- * Date Updated: November 9, 2024
- * Version: 0.4.1
+ * Date Updated: October 18, 2026
+ * Version: 0.10
  * Purpose: This file contains all functions that interact with platform-specific functionality
  */
 
 //SEE HEADER FILE FOR FUNCTION DOCUMENTATION
 
 #ifdef __MINGW32__
-
-int *AFFINITY = NULL;
+#include <stdlib.h>
+#include <string.h>
+#include <psapi.h>
 
 int getThreadCount()
 {
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo(&sysinfo);
-    if (AFFINITY == NULL) {
-        int thread_count = sysinfo.dwNumberOfProcessors;
-        AFFINITY = (int *) malloc(thread_count * sizeof(int));
-        memset(AFFINITY, -1, thread_count * sizeof(int));
+    // dwNumberOfProcessors only counts the calling thread's processor group
+    return GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+int getPossibleCpuCount()
+{
+    return GetMaximumProcessorCount(ALL_PROCESSOR_GROUPS);
+}
+
+/*
+ * Finds the processor group a CPU ID falls in.  CPU IDs are numbered group by group, so a group's IDs
+ * start after every CPU the groups before it can hold.
+ * @Param cpu: The CPU ID to look up.
+ * @Param base: Receives the first CPU ID of the group.
+ * @return: The group, or -1 if the ID is past the last group.
+ */
+static int getCpuGroup(int cpu, int *base)
+{
+    WORD groups = GetMaximumProcessorGroupCount();
+    int first = 0;
+    for (WORD group = 0; group < groups; group++) {
+        int size = GetMaximumProcessorCount(group);
+        if (cpu < first + size) {
+            *base = first;
+            return group;
+        }
+        first += size;
     }
-    return sysinfo.dwNumberOfProcessors;
+    return -1;
 }
 
 /*
- * @Params thread: pthread_t to get affinity of
- * @return: Failure if -1, success otherwise
-*/
-int getAffinity(pthread_t thread)
+ * Gets the first CPU ID of a processor group, see getCpuGroup.
+ */
+static int getGroupBase(WORD group)
+{
+    int base = 0;
+    for (WORD previous = 0; previous < group; previous++)
+        base += GetMaximumProcessorCount(previous);
+    return base;
+}
+
+int getAffinityMask(pthread_t thread, CpuMask *mask)
 {
-    if (AFFINITY == NULL) {
-        int thread_count = getThreadCount();
-        AFFINITY = (int *) malloc(thread_count * sizeof(int));
-        memset(AFFINITY, -1, thread_count * sizeof(int));
+    GROUP_AFFINITY affinity;
+    if (!GetThreadGroupAffinity(pthread_gethandle(thread), &affinity))
         return -1;
+
+    int base = getGroupBase(affinity.Group);
+    clearCpuMask(mask);
+    for (int bit = 0; bit < 64; bit++)
+        if (affinity.Mask & ((KAFFINITY) 1 << bit))
+            addCpuToMask(mask, base + bit);
+    return 0;
+}
+
+int setAffinityMask(pthread_t thread, const CpuMask *mask)
+{
+    GROUP_AFFINITY affinity;
+    memset(&affinity, 0, sizeof(affinity));
+
+    // A thread can only run inside one processor group, a mask spanning groups can't be honored
+    int group = -1;
+    for (int cpu = 0; cpu < mask->cpuCount; cpu++) {
+        if (!isCpuInMask(mask, cpu))
+            continue;
+        int base;
+        int cpuGroup = getCpuGroup(cpu, &base);
+        if (cpuGroup < 0 || (group >= 0 && cpuGroup != group))
+            return -1;
+        group = cpuGroup;
+        affinity.Mask |= (KAFFINITY) 1 << (cpu - base);
     }
-    return AFFINITY[thread];
+    if (group < 0)
+        return -1;
+
+    affinity.Group = (WORD) group;
+    return !SetThreadGroupAffinity(pthread_gethandle(thread), &affinity, NULL);
 }
 
-int setAffinity(pthread_t thread, int proc)
+void *allocateAligned(size_t alignment, size_t size)
 {
-    if (AFFINITY == NULL) {
-        int thread_count = getThreadCount();
-        AFFINITY = (int *) malloc(thread_count * sizeof(int));
-        memset(AFFINITY, -1, thread_count * sizeof(int));
+    return _aligned_malloc(size, alignment);
+}
+
+void freeAligned(void *ptr)
+{
+    _aligned_free(ptr);
+}
+
+void *allocateOnNode(size_t size, int node)
+{
+    void *ptr = VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+    if (ptr != NULL)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void freeOnNode(void *ptr, size_t size)
+{
+    (void) size;
+    if (ptr != NULL)
+        VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+/*
+ * Large pages need SeLockMemoryPrivilege, and their size has to be a multiple of GetLargePageMinimum.
+ */
+static size_t pageRoundedSize(size_t size, int pageMode)
+{
+    size_t large = GetLargePageMinimum();
+    if (pageMode != PAGES_HUGE || large == 0)
+        return size;
+    return (size + large - 1) / large * large;
+}
+
+void *allocatePages(size_t size, int pageMode)
+{
+    // Windows has no transparent huge pages, so that mode gets the same small pages as PAGES_SMALL
+    DWORD type = MEM_RESERVE | MEM_COMMIT;
+    if (pageMode == PAGES_HUGE) {
+        if (GetLargePageMinimum() == 0)
+            return NULL;
+        type |= MEM_LARGE_PAGES;
     }
-    
-    // This isn't guaranteed to work on systems with more than 64 processors
-    // To fix this we need to look into process groups
-    DWORD_PTR mask = 1 << proc;
-    int status = SetProcessAffinityMask(pthread_gethandle(thread), mask);
+    void *ptr = VirtualAlloc(NULL, pageRoundedSize(size, pageMode), type, PAGE_READWRITE);
+    if (ptr != NULL)
+        memset(ptr, 0, size);
+    return ptr;
+}
 
-    // Set affinity in our array
-    if (status != 0) 
-        AFFINITY[thread] = proc;
-    
-    return !status;
+void *allocatePagesOnNode(size_t size, int pageMode, int node)
+{
+    DWORD type = MEM_RESERVE | MEM_COMMIT;
+    if (pageMode == PAGES_HUGE) {
+        if (GetLargePageMinimum() == 0)
+            return NULL;
+        type |= MEM_LARGE_PAGES;
+    }
+    void *ptr = VirtualAllocExNuma(GetCurrentProcess(), NULL, pageRoundedSize(size, pageMode), type, PAGE_READWRITE, node);
+    if (ptr != NULL)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void freePages(void *ptr, size_t size, int pageMode)
+{
+    (void) size;
+    (void) pageMode;
+    if (ptr != NULL)
+        VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+int getMemoryNode(const void *ptr)
+{
+    PSAPI_WORKING_SET_EX_INFORMATION info;
+    info.VirtualAddress = (PVOID) ptr;
+    if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid)
+        return -1;
+    return info.VirtualAttributes.Node;
+}
+/*
+ * Lists the CPU IDs in a group affinity, in ascending order.
+ * @Param cpus: Receives the IDs, room for one per KAFFINITY bit.
+ * @return: The number of IDs, the ones past the topology's cpuCount are left out.
+ */
+static int getGroupCpus(const CpuTopology *topology, const GROUP_AFFINITY *affinity, int *cpus)
+{
+    int base = getGroupBase(affinity->Group), count = 0;
+    for (int bit = 0; bit < (int) (8 * sizeof(KAFFINITY)); bit++)
+        if ((affinity->Mask & ((KAFFINITY) 1 << bit)) && base + bit < topology->cpuCount)
+            cpus[count++] = base + bit;
+    return count;
+}
+
+// RelationProcessorDie, only reported by Windows 11 and newer and missing from older SDK headers
+#define RELATION_PROCESSOR_DIE 7
+
+int getTopology(CpuTopology *topology)
+{
+    int cpus[8 * sizeof(KAFFINITY)];
+    memset(topology, 0, sizeof(CpuTopology));
+    topology->cpuCount = getPossibleCpuCount();
+
+    DWORD length = 0;
+    if (GetLogicalProcessorInformationEx(RelationAll, NULL, &length) || GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+        return -1;
+    char *buffer = (char *) malloc(length);
+    topology->cpus = (CpuInfo *) calloc(topology->cpuCount, sizeof(CpuInfo));
+    if (buffer == NULL || topology->cpus == NULL ||
+        !GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX) buffer, &length)) {
+        free(buffer);
+        freeTopology(topology);
+        return -1;
+    }
+
+    for (int cpu = 0; cpu < topology->cpuCount; cpu++) {
+        CpuInfo *info = &topology->cpus[cpu];
+        info->coreDomain = cpu;
+        info->smtCount = 1;
+        info->llcDomain = cpu;
+        for (int level = 0; level < TOPOLOGY_CACHE_LEVELS; level++)
+            info->cacheDomain[level] = -1;
+    }
+
+    // Cores go first, they decide which CPUs are online.  Domains take the lowest CPU ID in the record's mask.
+    int coreCount = 0, dieCount = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (DWORD offset = 0; offset < length;) {
+            PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX entry = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX) (buffer + offset);
+            offset += entry->Size;
+            if ((entry->Relationship == RelationProcessorCore) != (pass == 0))
+                continue;
+
+            if (entry->Relationship == RelationProcessorCore) {
+                int count = getGroupCpus(topology, &entry->Processor.GroupMask[0], cpus);
+                for (int i = 0; i < count; i++) {
+                    CpuInfo *info = &topology->cpus[cpus[i]];
+                    info->online = 1;
+                    info->core = coreCount;
+                    info->coreDomain = cpus[0];
+                    info->smtCount = count;
+                    topology->onlineCount++;
+                }
+                coreCount++;
+            }
+            else if (entry->Relationship == RelationProcessorPackage || entry->Relationship == RELATION_PROCESSOR_DIE) {
+                int package = entry->Relationship == RelationProcessorPackage;
+                for (WORD group = 0; group < entry->Processor.GroupCount; group++) {
+                    int count = getGroupCpus(topology, &entry->Processor.GroupMask[group], cpus);
+                    for (int i = 0; i < count; i++) {
+                        if (package)
+                            topology->cpus[cpus[i]].package = topology->packageCount;
+                        else
+                            topology->cpus[cpus[i]].die = dieCount;
+                    }
+                }
+                if (package)
+                    topology->packageCount++;
+                else
+                    dieCount++;
+            }
+            else if (entry->Relationship == RelationCache) {
+                const CACHE_RELATIONSHIP *cache = &entry->Cache;
+                if (cache->Type == CacheInstruction || cache->Type == CacheTrace || cache->Level < 1 ||
+                    cache->Level > TOPOLOGY_CACHE_LEVELS)
+                    continue;
+                int count = getGroupCpus(topology, &cache->GroupMask, cpus);
+                for (int i = 0; i < count; i++)
+                    topology->cpus[cpus[i]].cacheDomain[cache->Level - 1] = cpus[0];
+                if (cache->Level > topology->llcLevel)
+                    topology->llcLevel = cache->Level;
+
+                // Geometry is assumed uniform, the first record for a level describes it
+                CacheInfo *info = &topology->caches[cache->Level - 1];
+                if (info->size == 0) {
+                    info->size = cache->CacheSize;
+                    info->lineSize = cache->LineSize;
+                    info->ways = cache->Associativity != CACHE_FULLY_ASSOCIATIVE ? cache->Associativity : 0;
+                    info->sets = info->ways != 0 && info->lineSize != 0 ? info->size / (info->lineSize * info->ways) : 0;
+                }
+            }
+            else if (entry->Relationship == RelationNumaNode) {
+                int count = getGroupCpus(topology, &entry->NumaNode.GroupMask, cpus);
+                for (int i = 0; i < count; i++)
+                    topology->cpus[cpus[i]].node = (int) entry->NumaNode.NodeNumber;
+                if ((int) entry->NumaNode.NodeNumber + 1 > topology->nodeCount)
+                    topology->nodeCount = entry->NumaNode.NodeNumber + 1;
+            }
+        }
+    }
+    free(buffer);
+
+    for (int cpu = 0; cpu < topology->cpuCount; cpu++) {
+        CpuInfo *info = &topology->cpus[cpu];
+        if (info->online && topology->llcLevel > 0 && info->cacheDomain[topology->llcLevel - 1] >= 0)
+            info->llcDomain = info->cacheDomain[topology->llcLevel - 1];
+    }
+    if (topology->packageCount == 0)
+        topology->packageCount = 1;
+    if (topology->nodeCount == 0)
+        topology->nodeCount = 1;
+    return 0;
 }
 #elif __unix__
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Memory policy constants from numaif.h, spelled out so libnuma doesn't become a build dependency
+#define POLICY_MPOL_BIND 2
+#define POLICY_MPOL_MF_STRICT (1 << 0)
+#define POLICY_MPOL_MF_MOVE (1 << 1)
+#define POLICY_MPOL_F_NODE (1 << 0)
+#define POLICY_MPOL_F_ADDR (1 << 1)
 
 #ifndef strcat_s
 #include <string.h>
@@ -81,31 +336,586 @@ int getThreadCount()
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
-int getAffinity(pthread_t thread)
+void *allocateAligned(size_t alignment, size_t size)
+{
+    void *ptr;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+}
+
+void freeAligned(void *ptr)
+{
+    free(ptr);
+}
+
+/*
+ * Binds a mapping that hasn't been touched yet to one node, so its pages are allocated there when they fault in.
+ */
+static int bindToNode(void *ptr, size_t size, int node)
 {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    int status = pthread_getaffinity_np(thread, sizeof(cpu_set_t),&cpuset);
-    if (status != 0)
+    // The kernel reads maxnode - 1 bits, so pass one more than the mask holds
+    int bitsPerWord = 8 * sizeof(unsigned long);
+    int words = node / bitsPerWord + 1;
+    unsigned long *nodeMask = (unsigned long *) calloc(words, sizeof(unsigned long));
+    if (nodeMask == NULL)
         return -1;
+    nodeMask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+    long status = syscall(SYS_mbind, ptr, size, POLICY_MPOL_BIND, nodeMask, (unsigned long) (words * bitsPerWord + 1),
+                          POLICY_MPOL_MF_STRICT | POLICY_MPOL_MF_MOVE);
+    free(nodeMask);
+    return status == 0 ? 0 : -1;
+}
 
-    // Is there a better way to do this? I don't know...
-    int cpus = getThreadCount();
-    for (int i = 0; i < cpus; i++) {
-        if (CPU_ISSET(i, &cpuset))
-            return i;
+void *allocateOnNode(size_t size, int node)
+{
+    if (node < 0 || size == 0)
+        return NULL;
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return NULL;
+    if (bindToNode(ptr, size, node) != 0) {
+        munmap(ptr, size);
+        return NULL;
     }
 
-    return -1;
+    // Fault every page in now, under the policy, instead of inside a measurement
+    memset(ptr, 0, size);
+    return ptr;
 }
 
-int setAffinity(pthread_t thread, int proc)
+void freeOnNode(void *ptr, size_t size)
+{
+    if (ptr != NULL)
+        munmap(ptr, size);
+}
+
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024) // The default x86 and arm64 huge page, and the THP size
+
+static size_t pageRoundedSize(size_t size, int pageMode)
+{
+    if (pageMode == PAGES_SMALL)
+        return size;
+    return (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+/*
+ * Maps pageRoundedSize(size, pageMode) bytes for a page mode without touching them.
+ */
+static char *mapPages(size_t size, int pageMode)
+{
+    size_t rounded = pageRoundedSize(size, pageMode);
+    char *ptr;
+
+    if (pageMode == PAGES_HUGE) {
+        ptr = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+            return NULL;
+    }
+    else {
+        // Over map by a huge page and trim, so a THP range starts on a huge page boundary
+        size_t slack = pageMode == PAGES_TRANSPARENT ? HUGE_PAGE_SIZE : 0;
+        char *mapping = mmap(NULL, rounded + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+            return NULL;
+        ptr = mapping;
+        if (slack != 0) {
+            ptr = (char *) (((uintptr_t) mapping + HUGE_PAGE_SIZE - 1) & ~(uintptr_t) (HUGE_PAGE_SIZE - 1));
+            if (ptr != mapping)
+                munmap(mapping, ptr - mapping);
+            if (mapping + slack != ptr)
+                munmap(ptr + rounded, mapping + slack - ptr);
+        }
+        if (madvise(ptr, rounded, pageMode == PAGES_TRANSPARENT ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) != 0 &&
+            pageMode == PAGES_TRANSPARENT) {
+            munmap(ptr, rounded);
+            return NULL;
+        }
+    }
+    return ptr;
+}
+
+void *allocatePages(size_t size, int pageMode)
+{
+    if (size == 0)
+        return NULL;
+    char *ptr = mapPages(size, pageMode);
+    if (ptr != NULL)
+        memset(ptr, 0, size);
+    return ptr;
+}
+
+void *allocatePagesOnNode(size_t size, int pageMode, int node)
+{
+    if (node < 0 || size == 0)
+        return NULL;
+    char *ptr = mapPages(size, pageMode);
+    if (ptr == NULL)
+        return NULL;
+    if (bindToNode(ptr, pageRoundedSize(size, pageMode), node) != 0) {
+        munmap(ptr, pageRoundedSize(size, pageMode));
+        return NULL;
+    }
+
+    // Fault every page in now, under the policy, instead of inside a measurement
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void freePages(void *ptr, size_t size, int pageMode)
+{
+    if (ptr != NULL)
+        munmap(ptr, pageRoundedSize(size, pageMode));
+}
+
+int getMemoryNode(const void *ptr)
+{
+    int node = -1;
+    if (syscall(SYS_get_mempolicy, &node, NULL, 0, ptr, POLICY_MPOL_F_NODE | POLICY_MPOL_F_ADDR) != 0)
+        return -1;
+    return node;
+}
+
+/*
+ * Reads a single integer from a sysfs file.
+ * @return: The value, or fallback if the file is missing or empty.
+ */
+static int readSysfsInt(const char *path, int fallback)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return fallback;
+    int value;
+    if (fscanf(file, "%d", &value) != 1)
+        value = fallback;
+    fclose(file);
+    return value;
+}
+
+/*
+ * Reads the first line of a sysfs file.
+ * @return: 0 on success, -1 if the file could not be read.
+ */
+static int readSysfsLine(const char *path, char *buffer, int bufferSize)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+    char *line = fgets(buffer, bufferSize, file);
+    fclose(file);
+    if (line == NULL)
+        return -1;
+    buffer[strcspn(buffer, "\n")] = 0;
+    return 0;
+}
+
+/*
+ * Parses a kernel CPU list such as "0-3,8,10-11" into a flag per CPU.
+ * @Param list: The list to parse.
+ * @Param flags: Set to 1 for every listed CPU below flagCount, may be NULL to only count.
+ * @Param flagCount: Size of flags.
+ * @Param highest: Receives the highest CPU in the list, -1 when empty.  May be NULL.
+ * @Param count: Receives the number of CPUs in the list.  May be NULL.
+ * @return: The lowest CPU in the list, -1 when empty.
+ */
+static int parseCpuList(const char *list, uint8_t *flags, int flagCount, int *highest, int *count)
 {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(proc, &cpuset);
+    int lowest = -1, top = -1, total = 0;
+    const char *cursor = list;
+
+    while (*cursor != 0) {
+        char *end;
+        long first = strtol(cursor, &end, 10);
+        if (end == cursor)
+            break;
+        long last = first;
+        cursor = end;
+        if (*cursor == '-') {
+            last = strtol(cursor + 1, &end, 10);
+            cursor = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            if (flags != NULL && cpu < flagCount)
+                flags[cpu] = 1;
+        }
+        total += (int) (last - first + 1);
+        if (lowest == -1 || first < lowest)
+            lowest = (int) first;
+        if (last > top)
+            top = (int) last;
+        if (*cursor == ',')
+            cursor++;
+    }
+
+    if (highest != NULL)
+        *highest = top;
+    if (count != NULL)
+        *count = total;
+    return lowest;
+}
 
-    return pthread_setaffinity_np(thread, sizeof(cpu_set_t),&cpuset);
+/*
+ * Reads a sysfs CPU list file and returns its lowest CPU, used to turn sharing lists into domain IDs.
+ */
+static int readCpuListFirst(const char *path, int *count)
+{
+    char list[4096];
+    if (readSysfsLine(path, list, sizeof(list)) != 0)
+        return -1;
+    return parseCpuList(list, NULL, 0, NULL, count);
+}
+
+int getPossibleCpuCount()
+{
+    char line[4096];
+    int highest = -1;
+    if (readSysfsLine("/sys/devices/system/cpu/possible", line, sizeof(line)) == 0)
+        parseCpuList(line, NULL, 0, &highest, NULL);
+    if (highest >= 0)
+        return highest + 1;
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    return (configured > 0) ? (int) configured : getThreadCount();
+}
+
+int getAffinityMask(pthread_t thread, CpuMask *mask)
+{
+    // The kernel rejects sets smaller than its own CPU limit, which can be past the possible count, so grow until it fits
+    int setCpus = (mask->cpuCount > 64) ? mask->cpuCount : 64;
+    for (; setCpus <= (1 << 20); setCpus *= 2) {
+        cpu_set_t *cpuset = CPU_ALLOC(setCpus);
+        if (cpuset == NULL)
+            return ENOMEM;
+        size_t setSize = CPU_ALLOC_SIZE(setCpus);
+        CPU_ZERO_S(setSize, cpuset);
+
+        int status = pthread_getaffinity_np(thread, setSize, cpuset);
+        if (status == 0) {
+            clearCpuMask(mask);
+            for (int cpu = 0; cpu < mask->cpuCount; cpu++)
+                if (CPU_ISSET_S(cpu, setSize, cpuset))
+                    addCpuToMask(mask, cpu);
+        }
+        CPU_FREE(cpuset);
+        if (status != EINVAL)
+            return status;
+    }
+    return EINVAL;
+}
+
+int setAffinityMask(pthread_t thread, const CpuMask *mask)
+{
+    if (countCpuMask(mask) == 0)
+        return EINVAL;
+
+    cpu_set_t *cpuset = CPU_ALLOC(mask->cpuCount);
+    if (cpuset == NULL)
+        return ENOMEM;
+    size_t setSize = CPU_ALLOC_SIZE(mask->cpuCount);
+    CPU_ZERO_S(setSize, cpuset);
+    for (int cpu = 0; cpu < mask->cpuCount; cpu++)
+        if (isCpuInMask(mask, cpu))
+            CPU_SET_S(cpu, setSize, cpuset);
+
+    int status = pthread_setaffinity_np(thread, setSize, cpuset);
+    CPU_FREE(cpuset);
+    return status;
+}
+
+int getTopology(CpuTopology *topology)
+{
+    char path[256], line[4096];
+    memset(topology, 0, sizeof(CpuTopology));
+
+    // Size everything by the possible CPUs so sparse and offline IDs still have a slot
+    topology->cpuCount = getPossibleCpuCount();
+
+    topology->cpus = (CpuInfo *) calloc(topology->cpuCount, sizeof(CpuInfo));
+    uint8_t *online = (uint8_t *) calloc(topology->cpuCount, 1);
+    if (topology->cpus == NULL || online == NULL) {
+        free(online);
+        freeTopology(topology);
+        return -1;
+    }
+
+    if (readSysfsLine("/sys/devices/system/cpu/online", line, sizeof(line)) == 0)
+        parseCpuList(line, online, topology->cpuCount, NULL, NULL);
+    else
+        memset(online, 1, topology->cpuCount);
+
+    int highestPackage = -1;
+    for (int cpu = 0; cpu < topology->cpuCount; cpu++) {
+        CpuInfo *info = &topology->cpus[cpu];
+        info->online = online[cpu];
+        info->coreDomain = cpu;
+        info->smtCount = 1;
+        info->llcDomain = cpu;
+        for (int level = 0; level < TOPOLOGY_CACHE_LEVELS; level++)
+            info->cacheDomain[level] = -1;
+        if (!info->online)
+            continue;
+        topology->onlineCount++;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        info->package = readSysfsInt(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/die_id", cpu);
+        info->die = readSysfsInt(path, 0);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        info->core = readSysfsInt(path, cpu);
+        if (info->package > highestPackage)
+            highestPackage = info->package;
+
+        // core_cpus_list replaced thread_siblings_list in newer kernels, both describe the SMT siblings
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_cpus_list", cpu);
+        int first = readCpuListFirst(path, &info->smtCount);
+        if (first < 0) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+            first = readCpuListFirst(path, &info->smtCount);
+        }
+        if (first >= 0)
+            info->coreDomain = first;
+        else
+            info->smtCount = 1;
+
+        // Walk every cache index, skipping instruction caches
+        for (int index = 0; ; index++) {
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+            int level = readSysfsInt(path, -1);
+            if (level < 0)
+                break;
+            if (level < 1 || level > TOPOLOGY_CACHE_LEVELS)
+                continue;
+
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/type", cpu, index);
+            if (readSysfsLine(path, line, sizeof(line)) != 0 || strcmp(line, "Instruction") == 0)
+                continue;
+
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+            first = readCpuListFirst(path, NULL);
+            info->cacheDomain[level - 1] = (first >= 0) ? first : cpu;
+            if (level > topology->llcLevel)
+                topology->llcLevel = level;
+
+            // Geometry is assumed uniform, the first CPU to report a level describes it
+            CacheInfo *cache = &topology->caches[level - 1];
+            if (cache->size == 0) {
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/coherency_line_size", cpu, index);
+                cache->lineSize = readSysfsInt(path, 64);
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/number_of_sets", cpu, index);
+                cache->sets = readSysfsInt(path, 0);
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/ways_of_associativity", cpu, index);
+                cache->ways = readSysfsInt(path, 0);
+                snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/size", cpu, index);
+                if (readSysfsLine(path, line, sizeof(line)) == 0) {
+                    char *unit;
+                    unsigned long size = strtoul(line, &unit, 10);
+                    if (*unit == 'K') size <<= 10;
+                    else if (*unit == 'M') size <<= 20;
+                    cache->size = (uint32_t) size;
+                }
+            }
+        }
+    }
+    topology->packageCount = highestPackage + 1;
+
+    for (int cpu = 0; cpu < topology->cpuCount; cpu++) {
+        CpuInfo *info = &topology->cpus[cpu];
+        if (info->online && topology->llcLevel > 0 && info->cacheDomain[topology->llcLevel - 1] >= 0)
+            info->llcDomain = info->cacheDomain[topology->llcLevel - 1];
+    }
+
+    // Every nodeN directory lists the CPUs that belong to it, systems without NUMA don't have any
+    DIR *nodes = opendir("/sys/devices/system/node");
+    if (nodes != NULL) {
+        uint8_t *members = (uint8_t *) malloc(topology->cpuCount);
+        struct dirent *entry;
+        while (members != NULL && (entry = readdir(nodes)) != NULL) {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1)
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (readSysfsLine(path, line, sizeof(line)) != 0)
+                continue;
+            memset(members, 0, topology->cpuCount);
+            parseCpuList(line, members, topology->cpuCount, NULL, NULL);
+            for (int cpu = 0; cpu < topology->cpuCount; cpu++)
+                if (members[cpu])
+                    topology->cpus[cpu].node = node;
+            if (node + 1 > topology->nodeCount)
+                topology->nodeCount = node + 1;
+        }
+        free(members);
+        closedir(nodes);
+    }
+    if (topology->nodeCount == 0)
+        topology->nodeCount = 1;
+
+    free(online);
+    return 0;
 }
 #endif
 
+int createCpuMask(CpuMask *mask)
+{
+    mask->cpuCount = getPossibleCpuCount();
+    if (mask->cpuCount < 1)
+        mask->cpuCount = 1;
+    mask->bits = (uint64_t *) calloc((mask->cpuCount + 63) / 64, sizeof(uint64_t));
+    return (mask->bits != NULL) ? 0 : -1;
+}
+
+void freeCpuMask(CpuMask *mask)
+{
+    free(mask->bits);
+    mask->bits = NULL;
+    mask->cpuCount = 0;
+}
+
+void clearCpuMask(CpuMask *mask)
+{
+    memset(mask->bits, 0, ((mask->cpuCount + 63) / 64) * sizeof(uint64_t));
+}
+
+void addCpuToMask(CpuMask *mask, int cpu)
+{
+    if (cpu >= 0 && cpu < mask->cpuCount)
+        mask->bits[cpu / 64] |= (uint64_t) 1 << (cpu % 64);
+}
+
+int isCpuInMask(const CpuMask *mask, int cpu)
+{
+    if (cpu < 0 || cpu >= mask->cpuCount)
+        return 0;
+    return (mask->bits[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+int countCpuMask(const CpuMask *mask)
+{
+    int count = 0;
+    for (int word = 0; word < (mask->cpuCount + 63) / 64; word++)
+        count += __builtin_popcountll(mask->bits[word]);
+    return count;
+}
+
+int getAffinity(pthread_t thread)
+{
+    CpuMask mask;
+    if (createCpuMask(&mask) != 0)
+        return -1;
+
+    int lowest = -1;
+    if (getAffinityMask(thread, &mask) == 0) {
+        for (int cpu = 0; cpu < mask.cpuCount && lowest < 0; cpu++)
+            if (isCpuInMask(&mask, cpu))
+                lowest = cpu;
+    }
+    freeCpuMask(&mask);
+    return lowest;
+}
+
+int setAffinity(pthread_t thread, int proc)
+{
+    CpuMask mask;
+    if (createCpuMask(&mask) != 0)
+        return -1;
+
+    // An ID the mask can't hold would otherwise leave it empty and the failure would point at the wrong thing
+    int status = -1;
+    if (proc >= 0 && proc < mask.cpuCount) {
+        addCpuToMask(&mask, proc);
+        status = setAffinityMask(thread, &mask);
+    }
+    freeCpuMask(&mask);
+    return status;
+}
+
+int getDomainMask(const CpuTopology *topology, int cpu, int domain, CpuMask *mask)
+{
+    if (cpu < 0 || cpu >= topology->cpuCount || domain < AFFINITY_DOMAIN_CPU || domain > AFFINITY_DOMAIN_PACKAGE)
+        return -1;
+
+    const CpuInfo *target = &topology->cpus[cpu];
+    clearCpuMask(mask);
+    for (int other = 0; other < topology->cpuCount; other++) {
+        const CpuInfo *info = &topology->cpus[other];
+        if (!info->online)
+            continue;
+        int member = 0;
+        switch (domain) {
+            case AFFINITY_DOMAIN_CPU: member = (other == cpu); break;
+            case AFFINITY_DOMAIN_CORE: member = (info->coreDomain == target->coreDomain); break;
+            case AFFINITY_DOMAIN_LLC: member = (info->llcDomain == target->llcDomain); break;
+            case AFFINITY_DOMAIN_NODE: member = (info->node == target->node); break;
+            case AFFINITY_DOMAIN_PACKAGE: member = (info->package == target->package); break;
+        }
+        if (member)
+            addCpuToMask(mask, other);
+    }
+    return 0;
+}
+
+int pinToDomain(pthread_t thread, const CpuTopology *topology, int cpu, int domain)
+{
+    CpuMask mask;
+    if (createCpuMask(&mask) != 0)
+        return -1;
+
+    int status = getDomainMask(topology, cpu, domain, &mask);
+    if (status == 0)
+        status = setAffinityMask(thread, &mask);
+    freeCpuMask(&mask);
+    return status;
+}
+
+int orderCoresFirst(const CpuTopology *topology, const int *cpus, int count, int *order)
+{
+    int ordered = 0;
+    if (cpus == NULL)
+        count = topology->cpuCount;
+    // A core's lowest CPU stands for the core, the rest are its SMT siblings
+    for (int sibling = 0; sibling < 2; sibling++) {
+        for (int i = 0; i < count; i++) {
+            int cpu = cpus != NULL ? cpus[i] : i;
+            if (cpu < 0 || cpu >= topology->cpuCount || !topology->cpus[cpu].online)
+                continue;
+            if ((topology->cpus[cpu].coreDomain == cpu) == (sibling == 0))
+                order[ordered++] = cpu;
+        }
+    }
+    return ordered;
+}
+
+void freeTopology(CpuTopology *topology)
+{
+    free(topology->cpus);
+    topology->cpus = NULL;
+    topology->cpuCount = 0;
+}
+
+int getPairClass(const CpuTopology *topology, int cpu1, int cpu2)
+{
+    if (cpu1 == cpu2)
+        return PAIR_CLASS_SELF;
+
+    const CpuInfo *first = &topology->cpus[cpu1];
+    const CpuInfo *second = &topology->cpus[cpu2];
+    if (first->package != second->package)
+        return PAIR_CLASS_CROSS_PACKAGE;
+    if (first->die != second->die)
+        return PAIR_CLASS_CROSS_DIE;
+    if (first->coreDomain == second->coreDomain)
+        return PAIR_CLASS_SMT;
+    if (first->llcDomain == second->llcDomain)
+        return PAIR_CLASS_SHARED_LLC;
+    return PAIR_CLASS_SAME_DIE;
+}
+
+const char *getPairClassName(int pairClass)
+{
+    static const char *names[PAIR_CLASS_COUNT] = {
+        "self", "smt", "shared-llc", "same-die", "cross-die", "cross-package"
+    };
+    if (pairClass < 0 || pairClass >= PAIR_CLASS_COUNT)
+        return "unknown";
+    return names[pairClass];
+}
+
@@ -4,8 +4,8 @@
  * Program Name: CnC Common Headers
  * File Name: platformCode.h
  * Date Created: January 21, 2024
- * Date Updated: November 12, 2024
- * Version: 0.5
+ * Date Updated: October 18, 2026
+ * Version: 0.13
  * Purpose: This file contains all functions that interact with platform-specific functionality
  */
 #ifdef __MINGW32__
@@ -26,21 +26,253 @@ int strcat_s(char *dest, int destsz, const char *src);
 
 #endif
 
+#include <stdint.h>
+
+#define TOPOLOGY_CACHE_LEVELS 4 // Data or unified caches from L1 to L4, instruction caches are ignored
+
+// Relationship between two logical CPUs, from closest to furthest apart
+#define PAIR_CLASS_SELF 0
+#define PAIR_CLASS_SMT 1            // SMT siblings on the same core
+#define PAIR_CLASS_SHARED_LLC 2     // Different cores behind the same last level cache
+#define PAIR_CLASS_SAME_DIE 3       // Same die, but different last level caches
+#define PAIR_CLASS_CROSS_DIE 4      // Same package, different dies
+#define PAIR_CLASS_CROSS_PACKAGE 5
+#define PAIR_CLASS_COUNT 6
+
+// Resources a thread can be pinned to with getDomainMask and pinToDomain
+#define AFFINITY_DOMAIN_CPU 0
+#define AFFINITY_DOMAIN_CORE 1      // Every SMT sibling of the CPU
+#define AFFINITY_DOMAIN_LLC 2       // Every CPU behind the same last level cache
+#define AFFINITY_DOMAIN_NODE 3      // Every CPU on the same NUMA node
+#define AFFINITY_DOMAIN_PACKAGE 4
+
+/* A set of CPU IDs sized at runtime to cover every possible CPU, so hosts past 64 (MinGW) or 1024 (glibc
+ * cpu_set_t) CPUs and sparse CPU IDs work the same as small ones.  Create with createCpuMask.
+ */
+typedef struct CpuMask {
+    int cpuCount;    // One past the highest CPU ID the mask can hold
+    uint64_t *bits;
+} CpuMask;
+
+typedef struct CacheInfo {
+    uint32_t size;          // Bytes, 0 when the level doesn't exist
+    uint32_t lineSize;
+    uint32_t sets;
+    uint32_t ways;
+} CacheInfo;
+
+/* Everything known about where a logical CPU sits.  Domain fields hold the lowest CPU ID sharing that
+ * resource, so two CPUs share it exactly when the fields are equal.
+ */
+typedef struct CpuInfo {
+    int online;
+    int package;
+    int die;
+    int core;                               // Only unique within a package and die
+    int coreDomain;                         // Lowest SMT sibling
+    int smtCount;                           // Number of hardware threads on this core
+    int cacheDomain[TOPOLOGY_CACHE_LEVELS]; // Index 0 is L1, -1 where the level doesn't exist
+    int llcDomain;
+    int node;                               // NUMA node, 0 when NUMA isn't exposed
+} CpuInfo;
+
+typedef struct CpuTopology {
+    int cpuCount;      // One past the highest possible CPU ID, cpus is indexed by CPU ID
+    int onlineCount;
+    int packageCount;
+    int nodeCount;
+    int llcLevel;      // Level (1 based) of the last level cache
+    CacheInfo caches[TOPOLOGY_CACHE_LEVELS];
+    CpuInfo *cpus;
+} CpuTopology;
+
 /* Gets the current available number of logical threads.
- * Should be called first as it populates the affinity mask table.
  */
 int getThreadCount();
 
+/* Gets one past the highest CPU ID the system could ever bring online.  Unlike getThreadCount this covers
+ * offline CPUs and gaps in the numbering, so it is the right size for anything indexed by CPU ID.
+ */
+int getPossibleCpuCount();
+
 /* Gets the core affinity for the provided pthread.
  *@Param thread: the pthread to get affinity for.
+ *@return: the lowest CPU ID the thread may run on, or -1 on failure.  Use getAffinityMask for the full set.
  */
 int getAffinity(pthread_t thread);
 
 /* Sets the core affinity for the provided pthread
  *@Param thread: the pthread to get affinity for.
  *@Param proc: the logical processor number to set the affinity to.
+ *@return: 0 on success, non zero if the CPU doesn't exist or the thread could not be moved.
  */
 int setAffinity(pthread_t thread, int proc);
 
+/* Allocates an empty mask large enough for every possible CPU ID.
+ *@Param mask: the mask to initialize, release it with freeCpuMask.
+ *@return: 0 on success, -1 on allocation failure.
+ */
+int createCpuMask(CpuMask *mask);
+
+/* Releases a mask from createCpuMask.
+ */
+void freeCpuMask(CpuMask *mask);
+
+/* Removes every CPU from a mask.
+ */
+void clearCpuMask(CpuMask *mask);
+
+/* Adds a CPU to a mask, IDs outside the mask are ignored.
+ */
+void addCpuToMask(CpuMask *mask, int cpu);
+
+/* Checks if a CPU is in a mask.
+ *@return: 1 if it is, 0 if not or if the ID is outside the mask.
+ */
+int isCpuInMask(const CpuMask *mask, int cpu);
+
+/* Counts the CPUs in a mask.
+ */
+int countCpuMask(const CpuMask *mask);
+
+/* Gets every CPU the provided pthread may run on.
+ *@Param thread: the pthread to get affinity for.
+ *@Param mask: a mask from createCpuMask, overwritten with the thread's affinity.
+ *@return: 0 on success, non zero on failure.
+ */
+int getAffinityMask(pthread_t thread, CpuMask *mask);
+
+/* Restricts the provided pthread to a set of CPUs.  On Windows a thread lives in one processor group,
+ * so the mask has to stay inside a single group there.
+ *@Param thread: the pthread to set affinity for.
+ *@Param mask: the CPUs the thread may run on, must not be empty.
+ *@return: 0 on success, non zero on failure.
+ */
+int setAffinityMask(pthread_t thread, const CpuMask *mask);
+
+/* Discovers the package, die, core, SMT, cache and NUMA layout of every logical CPU.
+ * On Linux this is parsed from /sys/devices/system/cpu and /sys/devices/system/node, on Windows it comes from
+ * GetLogicalProcessorInformationEx.
+ *@Param topology: the struct to fill, release it with freeTopology.
+ *@return: 0 on success, -1 if the layout could not be read.
+ */
+int getTopology(CpuTopology *topology);
+
+/* Releases the memory held by a CpuTopology.
+ *@Param topology: the topology to release.
+ */
+void freeTopology(CpuTopology *topology);
+
+/* Classifies how closely two logical CPUs are related.
+ *@Param topology: a topology from getTopology.
+ *@Param cpu1, cpu2: the CPU IDs to compare.
+ *@return: one of the PAIR_CLASS values.
+ */
+int getPairClass(const CpuTopology *topology, int cpu1, int cpu2);
+
+/* Gets a short printable name for a PAIR_CLASS value.
+ */
+const char *getPairClassName(int pairClass);
+
+/* Fills a mask with every online CPU sharing a resource with the given CPU.
+ *@Param topology: a topology from getTopology.
+ *@Param cpu: the CPU whose domain to collect.
+ *@Param domain: one of the AFFINITY_DOMAIN values.
+ *@Param mask: a mask from createCpuMask, overwritten with the domain.
+ *@return: 0 on success, -1 for an unknown CPU or domain.
+ */
+int getDomainMask(const CpuTopology *topology, int cpu, int domain, CpuMask *mask);
+
+/* Pins the provided pthread to the whole core, LLC, node or package around a CPU.
+ *@Param thread: the pthread to set affinity for.
+ *@Param topology: a topology from getTopology.
+ *@Param cpu: the CPU whose domain to pin to.
+ *@Param domain: one of the AFFINITY_DOMAIN values.
+ *@return: 0 on success, non zero on failure.
+ */
+int pinToDomain(pthread_t thread, const CpuTopology *topology, int cpu, int domain);
+
+/* Orders CPUs one per core first and the SMT siblings after, so thread counts up to the core count never put two
+ * threads on one core.  Offline CPUs are left out, otherwise the order of cpus is kept.
+ *@Param topology: a topology from getTopology.
+ *@Param cpus: the CPU IDs to order, NULL for every CPU in the topology in ID order.
+ *@Param count: the number of entries in cpus, ignored when cpus is NULL.
+ *@Param order: receives the ordered CPU IDs, room for count entries, or topology->cpuCount when cpus is NULL.
+ *@return: the number of CPU IDs written to order.
+ */
+int orderCoresFirst(const CpuTopology *topology, const int *cpus, int count, int *order);
+
+/* Allocates memory with the requested alignment.  aligned_alloc and _aligned_malloc disagree on argument order
+ * and on how the memory is released, so framework code should go through this pair instead.
+ *@Param alignment: the alignment in bytes, a power of two.
+ *@Param size: the number of bytes to allocate.
+ */
+void *allocateAligned(size_t alignment, size_t size);
+
+/* Releases memory from allocateAligned.
+ *@Param ptr: the allocation to release, NULL is ignored.
+ */
+void freeAligned(void *ptr);
+
+/* Allocates page aligned memory whose pages live on one NUMA node, bound with mbind on Linux and
+ * VirtualAllocExNuma on Windows.  Every page is touched before returning, so nothing faults in later.
+ *@Param size: the number of bytes to allocate.
+ *@Param node: the NUMA node to place the memory on.
+ *@return: the allocation, or NULL if it could not be made or bound to the node.
+ */
+void *allocateOnNode(size_t size, int node);
+
+/* Releases memory from allocateOnNode.
+ *@Param ptr: the allocation to release, NULL is ignored.
+ *@Param size: the size passed to allocateOnNode.
+ */
+void freeOnNode(void *ptr, size_t size);
+
+/* Page sizes allocatePages can back memory with */
+#define PAGES_SMALL 0        // Base pages only, transparent huge pages are turned off for the range
+#define PAGES_TRANSPARENT 1  // Transparent huge pages where the kernel can find them, base pages elsewhere
+#define PAGES_HUGE 2         // Explicit huge pages from the reserved pool (large pages on Windows), fails without them
+
+/* Allocates memory backed by a chosen page size, aligned to that page size.  Every page is touched before
+ * returning, so nothing faults in later.
+ *@Param size: the number of bytes to allocate.
+ *@Param pageMode: one of the PAGES values.
+ *@return: the allocation, or NULL if it could not be made with the requested pages.
+ */
+void *allocatePages(size_t size, int pageMode);
+
+/* Allocates memory backed by a chosen page size, like allocatePages, with every page bound to one NUMA node like
+ * allocateOnNode.  Release it with freePages.
+ *@Param size: the number of bytes to allocate.
+ *@Param pageMode: one of the PAGES values.
+ *@Param node: the NUMA node to place the memory on.
+ *@return: the allocation, or NULL if it could not be made with the requested pages or bound to the node.
+ */
+void *allocatePagesOnNode(size_t size, int pageMode, int node);
+
+/* Releases memory from allocatePages or allocatePagesOnNode.
+ *@Param ptr: the allocation to release, NULL is ignored.
+ *@Param size: the size passed to allocatePages or allocatePagesOnNode.
+ *@Param pageMode: the page mode passed with it.
+ */
+void freePages(void *ptr, size_t size, int pageMode);
+
+/* Looks up which NUMA node currently holds the page behind an address.
+ *@Param ptr: an address in a page that has been touched.
+ *@return: the node, or -1 if it can't be determined.
+ */
+int getMemoryNode(const void *ptr);
+
+/* xorshift64*, plenty for shuffles and samples, and reproducible from the seed.
+ *@Param state: the generator state, seed it with anything but 0.
+ *@return: the next pseudo random value.
+ */
+static inline uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
 
 #endif // PLATFORMCODE_H
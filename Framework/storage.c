@@ -4,82 +4,988 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <locale.h>
 #include <storage.h>
 
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 /*
  * Program Name: CnC Common Headers
  * File Name: storage.c
  * Date Created: November 11, 2024
- * Date Updated: November 11, 2024
- * Version: 0.1
+ * Date Updated: October 18, 2026
+ * Version: 0.9
  * Purpose: Provides functions for storage aspects of the framework.
  */
 
-const uint8_t VERSIONCODE = 1;
+const uint8_t VERSIONCODE = CNC_FORMAT_TEXT;
+const uint8_t BINARY_VERSIONCODE = CNC_FORMAT_BINARY;
 
-CnCData read_CNC(char fileName[])
+_Static_assert(sizeof(CnCBinaryHeader) == CNC_BINARY_HEADER_SIZE, "CnCBinaryHeader must match the on-disk header size");
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_IS_BIG_ENDIAN 1
+#else
+#define HOST_IS_BIG_ENDIAN 0
+#endif
+
+/*
+ * Converts between host and little-endian byte order, the binary format is always little-endian.
+ */
+static uint32_t toLittle32(uint32_t value)
 {
-    //Copied for parity with write_CNC
-    //Append .cnc to the testName input.  File type is ALWAYS .cnc
-    char AppendedName[255];
-    strcpy(AppendedName, fileName);
-    strcat_s(AppendedName, 255, ".cnc");
+    return HOST_IS_BIG_ENDIAN ? __builtin_bswap32(value) : value;
+}
 
-    CnCData data = { .isMalformed = 1 };
-    char buffer[BUFFERLIMIT];
-    char *bufferSave;
+static uint64_t toLittle64(uint64_t value)
+{
+    return HOST_IS_BIG_ENDIAN ? __builtin_bswap64(value) : value;
+}
+
+/*
+ * Maps (or on platforms without mmap, reads) a whole file into memory.  Unix mappings are copy-on-write so
+ * callers may still modify data that points into them.
+ * @Param fileName: Full name of the file, including the .cnc extension.
+ * @Param size: Receives the size of the file in bytes.
+ * @return: The start of the file contents, or NULL on failure.
+ */
+static uint8_t *loadFile(const char *fileName, size_t *size)
+{
+    uint8_t *base;
+
+#ifdef __unix__
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t) fileStat.st_size;
 
+    base = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return NULL;
+    // Both parsers walk the file front to back
+    madvise(base, *size, MADV_SEQUENTIAL);
+#else
     FILE *file;
-    if((file = fopen(fileName, "r")) == NULL) return data;
+    if ((file = fopen(fileName, "rb")) == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    *size = (size_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // malloc alignment is enough for doubles since the payload offset is a multiple of CNC_PAYLOAD_ALIGNMENT
+    base = (*size != 0) ? malloc(*size) : NULL;
+    if (base == NULL || fread(base, 1, *size, file) != *size) {
+        free(base);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+#endif
+
+    return base;
+}
+
+static void unloadFile(uint8_t *base, size_t size)
+{
+#ifdef __unix__
+    munmap(base, size);
+#else
+    free(base);
+#endif
+}
+
+/*
+ * Bit streams for the compressed format, most significant bit first so they read the same on every host.
+ */
+typedef struct BitWriter
+{
+    uint8_t *out;
+    size_t used;        // Whole bytes written to out
+    uint64_t pending;   // Bits not yet written, right aligned
+    int pendingBits;
+} BitWriter;
+
+typedef struct BitReader
+{
+    const uint8_t *data;
+    size_t size;
+    uint64_t position;  // In bits
+} BitReader;
+
+static void emitBits(BitWriter *writer, uint64_t bits)
+{
+    for (int i = 7; i >= 0; i--)
+        writer->out[writer->used++] = (uint8_t) (bits >> (8 * i));
+}
+
+/*
+ * Appends the low count bits of value, count is 1 to 64.
+ */
+static void putBits(BitWriter *writer, uint64_t value, int count)
+{
+    if (count == 64) {
+        putBits(writer, value >> 32, 32);
+        putBits(writer, value, 32);
+        return;
+    }
+    value &= (1ULL << count) - 1;
+    if (writer->pendingBits + count < 64) {
+        writer->pending = (writer->pending << count) | value;
+        writer->pendingBits += count;
+        return;
+    }
+
+    // Fill the pending word up to 64 bits and start a new one with whatever is left over
+    int head = 64 - writer->pendingBits, tail = count - head;
+    emitBits(writer, (writer->pending << head) | (value >> tail));
+    writer->pending = tail != 0 ? value & ((1ULL << tail) - 1) : 0;
+    writer->pendingBits = tail;
+}
+
+static void finishBits(BitWriter *writer)
+{
+    // Nothing pending, and shifting by 64 would be undefined
+    if (writer->pendingBits == 0)
+        return;
+    uint64_t bits = writer->pending << (64 - writer->pendingBits);
+    for (int i = 7; i >= 8 - (writer->pendingBits + 7) / 8; i--)
+        writer->out[writer->used++] = (uint8_t) (bits >> (8 * i));
+    writer->pending = 0;
+    writer->pendingBits = 0;
+}
+
+/*
+ * Reads the next count bits, count is 1 to 64.  Reads past the end of the stream return zeros and leave
+ * position past the end, which the decoders check for.
+ */
+static uint64_t getBits(BitReader *reader, int count)
+{
+    if (count > 56) {
+        uint64_t high = getBits(reader, count - 32);
+        return (high << 32) | getBits(reader, 32);
+    }
+
+    size_t byte = (size_t) (reader->position >> 3);
+    uint64_t window = 0;
+    if (byte + 8 <= reader->size) {
+        for (int i = 0; i < 8; i++)
+            window = (window << 8) | reader->data[byte + i];
+    }
+    else {
+        for (int i = 0; i < 8; i++)
+            window = (window << 8) | (byte + i < reader->size ? reader->data[byte + i] : 0);
+    }
+    window <<= reader->position & 7;
+    reader->position += (uint64_t) count;
+    return window >> (64 - count);
+}
+
+/*
+ * Checks whether every value can go through the delta-of-delta integer codec and come back bit for bit.
+ */
+static int isIntegralColumn(const double *values, uint64_t count, uint64_t stride)
+{
+    for (uint64_t i = 0; i < count; i++) {
+        double value = values[i * stride];
+        if (!(value >= -4.0e18 && value <= 4.0e18) || (double) (int64_t) value != value || (value == 0 && __builtin_signbit(value)))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Encodes a column with the Gorilla float codec.  After the first raw value, every value is XORed with the one
+ * before it: a zero XOR is a single 0 bit, otherwise the meaningful bits are stored either inside the previous
+ * value's leading/trailing zero window ('10') or with a new window ('11', 5 bits of leading zeros, 6 bits of length).
+ */
+static void encodeXor(BitWriter *writer, const double *values, uint64_t count, uint64_t stride)
+{
+    uint64_t previous, current;
+    int previousLeading = -1, previousTrailing = 0;
+
+    memcpy(&previous, &values[0], sizeof(previous));
+    putBits(writer, previous, 64);
+    for (uint64_t i = 1; i < count; i++) {
+        memcpy(&current, &values[i * stride], sizeof(current));
+        uint64_t difference = current ^ previous;
+        previous = current;
+        if (difference == 0) {
+            putBits(writer, 0, 1);
+            continue;
+        }
+
+        int leading = __builtin_clzll(difference), trailing = __builtin_ctzll(difference);
+        if (leading > 31)
+            leading = 31;
+        if (previousLeading >= 0 && leading >= previousLeading && trailing >= previousTrailing) {
+            putBits(writer, 2, 2);
+            putBits(writer, difference >> previousTrailing, 64 - previousLeading - previousTrailing);
+        }
+        else {
+            int meaningful = 64 - leading - trailing;
+            putBits(writer, 3, 2);
+            putBits(writer, (uint64_t) leading, 5);
+            putBits(writer, (uint64_t) (meaningful - 1), 6);
+            putBits(writer, difference >> trailing, meaningful);
+            previousLeading = leading;
+            previousTrailing = trailing;
+        }
+    }
+}
+
+static int decodeXor(BitReader *reader, double *out, uint64_t count)
+{
+    uint64_t previous = getBits(reader, 64);
+    int previousLeading = -1, previousTrailing = 0;
+
+    memcpy(&out[0], &previous, sizeof(previous));
+    for (uint64_t i = 1; i < count; i++) {
+        if (getBits(reader, 1) != 0) {
+            if (getBits(reader, 1) != 0) {
+                previousLeading = (int) getBits(reader, 5);
+                int meaningful = (int) getBits(reader, 6) + 1;
+                previousTrailing = 64 - previousLeading - meaningful;
+                if (previousTrailing < 0)
+                    return -1;
+            }
+            else if (previousLeading < 0)
+                return -1;
+            previous ^= getBits(reader, 64 - previousLeading - previousTrailing) << previousTrailing;
+        }
+        memcpy(&out[i], &previous, sizeof(previous));
+    }
+    return reader->position <= (uint64_t) reader->size * 8 ? 0 : -1;
+}
+
+/*
+ * Encodes a column of whole numbers with the Gorilla timestamp codec.  After the first raw value, every value
+ * stores the change in its delta from the one before, zigzag encoded: a single 0 bit when the delta held, or a
+ * prefix of 10, 110, 1110 and 1111 for 7, 9, 12 and 64 bit changes.  Counters and tick stamps come out at 1-2 bits.
+ */
+static void encodeDelta(BitWriter *writer, const double *values, uint64_t count, uint64_t stride)
+{
+    static const int widths[4] = { 7, 9, 12, 64 };
+    static const int prefixBits[4] = { 2, 3, 4, 4 };
+    static const uint64_t prefixes[4] = { 0x2, 0x6, 0xE, 0xF };
+    int64_t previous = (int64_t) values[0];
+    uint64_t previousDelta = 0;
+
+    putBits(writer, (uint64_t) previous, 64);
+    for (uint64_t i = 1; i < count; i++) {
+        int64_t current = (int64_t) values[i * stride];
+        uint64_t delta = (uint64_t) current - (uint64_t) previous;
+        int64_t change = (int64_t) (delta - previousDelta);
+        uint64_t zigzag = ((uint64_t) change << 1) ^ (uint64_t) (change >> 63);
+        previous = current;
+        previousDelta = delta;
+
+        if (zigzag == 0) {
+            putBits(writer, 0, 1);
+            continue;
+        }
+        int bucket = zigzag < (1ULL << 7) ? 0 : zigzag < (1ULL << 9) ? 1 : zigzag < (1ULL << 12) ? 2 : 3;
+        putBits(writer, prefixes[bucket], prefixBits[bucket]);
+        putBits(writer, zigzag, widths[bucket]);
+    }
+}
+
+static int decodeDelta(BitReader *reader, double *out, uint64_t count)
+{
+    static const int widths[4] = { 7, 9, 12, 64 };
+    uint64_t previous = getBits(reader, 64), previousDelta = 0;
+
+    out[0] = (double) (int64_t) previous;
+    for (uint64_t i = 1; i < count; i++) {
+        int bucket = 0;
+        if (getBits(reader, 1) != 0) {
+            while (bucket < 3 && getBits(reader, 1) != 0)
+                bucket++;
+            uint64_t zigzag = getBits(reader, widths[bucket]);
+            previousDelta += (zigzag >> 1) ^ (0 - (zigzag & 1));
+        }
+        previous += previousDelta;
+        out[i] = (double) (int64_t) previous;
+    }
+    return reader->position <= (uint64_t) reader->size * 8 ? 0 : -1;
+}
+
+/*
+ * Encodes everything in the writer's buffer as one block and writes it out.  Values are assigned to columns by
+ * their index in the whole file, so blocks can start and end anywhere in a row.
+ */
+static int writeBlock(CnCWriter *writer)
+{
+    uint64_t valueCount = writer->bufferUsed / sizeof(double);
+    if (valueCount == 0)
+        return 0;
+
+    const double *values = (const double *) writer->buffer;
+    uint32_t columnCount = writer->columnCount;
+    uint64_t firstValue = writer->resultCount - valueCount;
+    size_t used = sizeof(CnCBlockHeader) + (size_t) columnCount * sizeof(CnCColumnStream);
+
+    for (uint32_t column = 0; column < columnCount; column++) {
+        uint64_t start = (column + columnCount - firstValue % columnCount) % columnCount;
+        uint64_t count = start < valueCount ? (valueCount - start - 1) / columnCount + 1 : 0;
+        CnCColumnStream stream = { 0 };
+        BitWriter bits = { .out = writer->blockBuffer + used };
+        if (count != 0) {
+            stream.codec = isIntegralColumn(values + start, count, columnCount) ? CNC_CODEC_DELTA : CNC_CODEC_XOR;
+            if (stream.codec == CNC_CODEC_DELTA)
+                encodeDelta(&bits, values + start, count, columnCount);
+            else
+                encodeXor(&bits, values + start, count, columnCount);
+            finishBits(&bits);
+        }
+        stream.size = toLittle32((uint32_t) bits.used);
+        memcpy(writer->blockBuffer + sizeof(CnCBlockHeader) + (size_t) column * sizeof(CnCColumnStream), &stream, sizeof(stream));
+        used += bits.used;
+    }
+
+    CnCBlockHeader header = {
+        .blockSize = toLittle64(used),
+        .firstValue = toLittle64(firstValue),
+        .valueCount = toLittle32((uint32_t) valueCount),
+        .columnCount = toLittle32(columnCount),
+    };
+    memcpy(writer->blockBuffer, &header, sizeof(header));
+    if (fwrite(writer->blockBuffer, 1, used, writer->file) != used)
+        return -1;
+    writer->bufferUsed = 0;
+    return 0;
+}
+
+/*
+ * Walks the block chain of a compressed file and decodes the values of a row range.  Blocks that don't overlap the
+ * range are skipped by their size, and only the requested column's stream is decoded within the others.
+ * @Param base: Start of the file contents from loadFile.
+ * @Param size: Size of the file contents.
+ * @Param payloadOffset: Offset of the first block.
+ * @Param columnCount: Columns in the file.
+ * @Param resultCount: Values in the file, anything in the blocks past it is ignored.
+ * @Param firstRow: First row to decode.
+ * @Param rowCount: Number of rows to decode.
+ * @Param column: Column to decode, or CNC_ALL_COLUMNS.
+ * @Param out: Receives the values, row-major, one per row for a single column.
+ * @return: 0 if successful, -1 if the blocks are malformed.
+ */
+static int decodeBlocks(const uint8_t *base, size_t size, uint64_t payloadOffset, uint32_t columnCount, uint64_t resultCount,
+                        uint64_t firstRow, uint64_t rowCount, uint32_t column, double *out)
+{
+    uint64_t rangeBegin = firstRow * columnCount, rangeEnd = (firstRow + rowCount) * columnCount;
+    uint64_t expectedFirst = 0, offset = payloadOffset;
+    size_t tableSize = sizeof(CnCBlockHeader) + (size_t) columnCount * sizeof(CnCColumnStream);
+    double *decoded = malloc(CNC_BLOCK_VALUES * sizeof(double));
+    if (decoded == NULL)
+        return -1;
+
+    int status = 0;
+    while (expectedFirst < resultCount && expectedFirst < rangeEnd && status == 0) {
+        CnCBlockHeader header;
+        if (offset + tableSize > size) {
+            status = -1;
+            break;
+        }
+        memcpy(&header, base + offset, sizeof(header));
+        uint64_t blockSize = toLittle64(header.blockSize), firstValue = toLittle64(header.firstValue);
+        uint32_t valueCount = toLittle32(header.valueCount);
+        if (toLittle32(header.columnCount) != columnCount || firstValue != expectedFirst || valueCount == 0 ||
+            valueCount > CNC_BLOCK_VALUES || blockSize < tableSize || blockSize > size - offset) {
+            status = -1;
+            break;
+        }
+
+        if (firstValue + valueCount > rangeBegin) {
+            const uint8_t *stream = base + offset + tableSize;
+            for (uint32_t c = 0; c < columnCount && status == 0; c++) {
+                CnCColumnStream entry;
+                memcpy(&entry, base + offset + sizeof(CnCBlockHeader) + (size_t) c * sizeof(CnCColumnStream), sizeof(entry));
+                uint32_t streamSize = toLittle32(entry.size);
+                if (stream + streamSize > base + offset + blockSize) {
+                    status = -1;
+                    break;
+                }
+
+                uint64_t start = (c + columnCount - firstValue % columnCount) % columnCount;
+                uint64_t count = start < valueCount ? (valueCount - start - 1) / columnCount + 1 : 0;
+                if (count != 0 && (column == CNC_ALL_COLUMNS || column == c)) {
+                    BitReader bits = { .data = stream, .size = streamSize };
+                    if (entry.codec == CNC_CODEC_DELTA)
+                        status = decodeDelta(&bits, decoded, count);
+                    else if (entry.codec == CNC_CODEC_XOR)
+                        status = decodeXor(&bits, decoded, count);
+                    else
+                        status = -1;
+
+                    for (uint64_t i = 0; i < count && status == 0; i++) {
+                        uint64_t index = firstValue + start + i * columnCount;
+                        if (index < rangeBegin || index >= rangeEnd || index >= resultCount)
+                            continue;
+                        out[column == CNC_ALL_COLUMNS ? index - rangeBegin : index / columnCount - firstRow] = decoded[i];
+                    }
+                }
+                stream += streamSize;
+            }
+        }
+
+        expectedFirst = firstValue + valueCount;
+        offset += blockSize;
+    }
+
+    free(decoded);
+    return status;
+}
+
+/*
+ * Checks the header of a binary (version 2 or 3) file.  The payload itself is only checked for version 2,
+ * compressed blocks are checked as they are decoded.
+ * @return: 0 if the header can be trusted.
+ */
+static int checkBinaryHeader(const uint8_t *base, size_t size)
+{
+    const CnCBinaryHeader *header = (const CnCBinaryHeader *) base;
+    if (size < CNC_BINARY_HEADER_SIZE)
+        return -1;
+    uint32_t version = toLittle32(header->version);
+    uint32_t columnCount = toLittle32(header->columnCount);
+    uint64_t resultCount = toLittle64(header->resultCount);
+    uint64_t columnTableOffset = toLittle64(header->columnTableOffset);
+    uint64_t payloadOffset = toLittle64(header->payloadOffset);
+
+    if (memcmp(header->magic, CNC_BINARY_MAGIC, 4) != 0 ||
+        (version != BINARY_VERSIONCODE && version != CNC_FORMAT_COMPRESSED) ||
+        columnCount == 0 || resultCount == 0 || resultCount > UINT32_MAX ||
+        payloadOffset % CNC_PAYLOAD_ALIGNMENT != 0 ||
+        // Bounded before the sum below, so an offset near UINT64_MAX can't wrap around and pass
+        columnTableOffset < CNC_BINARY_HEADER_SIZE || columnTableOffset > payloadOffset ||
+        columnCount > (payloadOffset - columnTableOffset) / 256 ||
+        columnTableOffset + (uint64_t) columnCount * 256 > payloadOffset || payloadOffset > size ||
+        (version == BINARY_VERSIONCODE && payloadOffset + resultCount * sizeof(double) > size) ||
+        header->testName[255] != 0 || header->metadata[255] != 0)
+        return -1;
+
+    for (uint32_t i = 0; i < columnCount; i++)
+        if (base[columnTableOffset + (uint64_t) i * 256 + 255] != 0)
+            return -1;
+    return 0;
+}
+
+/*
+ * Builds a CnCData from a compressed (version 3) file that is already in memory.  Everything is decoded into
+ * memory of its own, so the file is released afterwards.
+ * @Param base: Start of the file contents from loadFile.
+ * @Param size: Size of the file contents.
+ * @return: A CnCData struct with isMalformed cleared on success.
+ */
+static CnCData readCompressedCNC(uint8_t *base, size_t size)
+{
+    CnCData data = { .isMalformed = 1 };
+    const CnCBinaryHeader *header = (const CnCBinaryHeader *) base;
+    if (checkBinaryHeader(base, size) != 0 || toLittle32(header->version) != CNC_FORMAT_COMPRESSED) {
+        unloadFile(base, size);
+        return data;
+    }
+
+    data.columnCount = toLittle32(header->columnCount);
+    data.resultCount = (uint32_t) toLittle64(header->resultCount);
+    memcpy(data.testName, header->testName, 256);
+    memcpy(data.metadata, header->metadata, 256);
+    data.columnNames = malloc((size_t) data.columnCount * 256);
+    data.resultList = malloc((size_t) data.resultCount * sizeof(double));
+    if (data.columnNames != NULL && data.resultList != NULL) {
+        memcpy(data.columnNames, base + toLittle64(header->columnTableOffset), (size_t) data.columnCount * 256);
+        uint64_t rowCount = (data.resultCount + data.columnCount - 1) / data.columnCount;
+        data.isMalformed = decodeBlocks(base, size, toLittle64(header->payloadOffset), data.columnCount, data.resultCount,
+                                        0, rowCount, CNC_ALL_COLUMNS, data.resultList) != 0;
+    }
+
+    unloadFile(base, size);
+    return data;
+}
+
+/*
+ * Builds a CnCData from a binary (version 2) file that is already in memory.  The data keeps the mapping.
+ * @Param base: Start of the file contents from loadFile.
+ * @Param size: Size of the file contents.
+ * @return: A CnCData struct with isMalformed cleared on success.
+ */
+static CnCData readBinaryCNC(uint8_t *base, size_t size)
+{
+    CnCData data = { .isMalformed = 1 };
+    data.mapping = base;
+    data.mappingSize = size;
+
+    // Validate the header before trusting any offsets inside of it
+    CnCBinaryHeader *header = (CnCBinaryHeader *) base;
+    if (checkBinaryHeader(base, size) != 0 || toLittle32(header->version) != BINARY_VERSIONCODE) {
+        free_CNC(&data);
+        data.isMalformed = 1;
+        return data;
+    }
+    uint32_t columnCount = toLittle32(header->columnCount);
+    uint64_t resultCount = toLittle64(header->resultCount);
+    uint64_t columnTableOffset = toLittle64(header->columnTableOffset);
+    uint64_t payloadOffset = toLittle64(header->payloadOffset);
+
+    data.columnCount = columnCount;
+    data.resultCount = (uint32_t) resultCount;
+    memcpy(data.testName, header->testName, 256);
+    memcpy(data.metadata, header->metadata, 256);
+    data.columnNames = (char (*)[256]) (base + columnTableOffset);
+    data.resultList = (double *) (base + payloadOffset);
+
+    // The mapping is private so swapping in place never touches the file
+    if (HOST_IS_BIG_ENDIAN) {
+        uint64_t *raw = (uint64_t *) data.resultList;
+        for (uint32_t i = 0; i < data.resultCount; i++)
+            raw[i] = toLittle64(raw[i]);
+    }
+
+    data.isMalformed = 0;
+    return data;
+}
+
+static int isDelimiter(char c)
+{
+    return c == ',' || c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+
+/*
+ * Slow path for values the fast path can't convert exactly.  strtod honours the locale's radix character,
+ * so swap it in for '.' to keep the result the same under every locale.
+ * @return: 0 if successful, -1 if the value is too long to convert, cutting it short would change it.
+ */
+static int parseDoubleFallback(const char *begin, const char *end, double *out)
+{
+    char token[512];
+    size_t length = (size_t) (end - begin);
+    if (length >= sizeof(token))
+        return -1;
+    memcpy(token, begin, length);
+    token[length] = 0;
+
+    char radix = localeconv()->decimal_point[0];
+    if (radix != '.') {
+        char *dot = strchr(token, '.');
+        if (dot != NULL)
+            *dot = radix;
+    }
+    *out = strtod(token, NULL);
+    return 0;
+}
+
+/*
+ * Parses one decimal floating point value, independently of the current locale.  Values with up to 19
+ * significant digits and a small decimal exponent (everything write_CNC produces) are converted exactly
+ * without calling into libc.
+ * @Param cursor: Start of the value.
+ * @Param end: End of the readable region, the value is never read past this.
+ * @Param out: Receives the parsed value.
+ * @return: Pointer to the first character after the value, or NULL if no value could be parsed.
+ */
+static const char *parseDouble(const char *cursor, const char *end, double *out)
+{
+    static const double powersOfTen[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char *begin = cursor;
+    int negative = 0;
+
+    if (cursor < end && (*cursor == '-' || *cursor == '+'))
+        negative = (*cursor++ == '-');
+
+    // printf writes "nan", "-nan" and "inf" for non-finite values
+    if (end - cursor >= 3 && (cursor[0] | 0x20) == 'n' && (cursor[1] | 0x20) == 'a' && (cursor[2] | 0x20) == 'n') {
+        *out = negative ? -__builtin_nan("") : __builtin_nan("");
+        cursor += 3;
+        while (cursor < end && !isDelimiter(*cursor))
+            cursor++;
+        return cursor;
+    }
+    if (end - cursor >= 3 && (cursor[0] | 0x20) == 'i' && (cursor[1] | 0x20) == 'n' && (cursor[2] | 0x20) == 'f') {
+        *out = negative ? -__builtin_inf() : __builtin_inf();
+        cursor += 3;
+        while (cursor < end && !isDelimiter(*cursor))
+            cursor++;
+        return cursor;
+    }
+
+    uint64_t mantissa = 0;
+    int significantDigits = 0, digitCount = 0, exponent = 0;
+
+    for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, digitCount++) {
+        if (significantDigits < 19) {
+            mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+            significantDigits += (mantissa != 0);
+        }
+        else
+            exponent++;
+    }
+    if (cursor < end && *cursor == '.') {
+        for (cursor++; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, digitCount++) {
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (uint64_t) (*cursor - '0');
+                significantDigits += (mantissa != 0);
+                exponent--;
+            }
+        }
+    }
+    if (digitCount == 0)
+        return NULL;
 
-    if (fgets(buffer, BUFFERLIMIT, file) == NULL)
+    int truncated = significantDigits >= 19;
+    if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+        int exponentNegative = 0, explicitExponent = 0, exponentDigits = 0;
+        cursor++;
+        if (cursor < end && (*cursor == '-' || *cursor == '+'))
+            exponentNegative = (*cursor++ == '-');
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++, exponentDigits++)
+            if (explicitExponent < 100000)
+                explicitExponent = explicitExponent * 10 + (*cursor - '0');
+        if (exponentDigits == 0)
+            return NULL;
+        exponent += exponentNegative ? -explicitExponent : explicitExponent;
+    }
+
+    // Exact when both the mantissa and the power of ten are representable (Clinger's fast path)
+    double value;
+    if (!truncated && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        value = (exponent < 0) ? (double) mantissa / powersOfTen[-exponent] : (double) mantissa * powersOfTen[exponent];
+    else if (mantissa == 0)
+        value = 0.0;
+    else {
+        // The fallback sees the sign itself
+        return parseDoubleFallback(begin, cursor, out) == 0 ? cursor : NULL;
+    }
+
+    *out = negative ? -value : value;
+    return cursor;
+}
+
+/*
+ * Counts the values in a region of data rows, without converting them.
+ */
+static uint64_t countValues(const char *cursor, const char *end)
+{
+    uint64_t count = 0;
+    int inValue = 0;
+    for (; cursor < end; cursor++) {
+        int delimiter = isDelimiter(*cursor);
+        count += (!delimiter && !inValue);
+        inValue = !delimiter;
+    }
+    return count;
+}
+
+typedef struct ParseChunk
+{
+    const char *begin;
+    const char *end;
+    uint64_t valueCount;
+    double *out;
+    int failed;
+} ParseChunk;
+
+/*
+ * Converts every value in a chunk of data rows.  Empty fields (such as the trailing delimiter write_CNC
+ * leaves after a partial row) are skipped.
+ * @Param param: Pointer to the ParseChunk to operate on.
+ * @return: Will always return NULL, failures are reported through the chunk.
+ */
+static void *parseChunk(void *param)
+{
+    ParseChunk *chunk = (ParseChunk *) param;
+    const char *cursor = chunk->begin;
+    uint64_t parsed = 0;
+
+    while (cursor < chunk->end) {
+        if (isDelimiter(*cursor)) {
+            cursor++;
+            continue;
+        }
+        if (parsed == chunk->valueCount || (cursor = parseDouble(cursor, chunk->end, &chunk->out[parsed])) == NULL) {
+            chunk->failed = 1;
+            return NULL;
+        }
+        parsed++;
+        if (cursor < chunk->end && !isDelimiter(*cursor)) {
+            chunk->failed = 1;
+            return NULL;
+        }
+    }
+
+    chunk->failed = (parsed != chunk->valueCount);
+    return NULL;
+}
+
+static void *countChunk(void *param)
+{
+    ParseChunk *chunk = (ParseChunk *) param;
+    chunk->valueCount = countValues(chunk->begin, chunk->end);
+    return NULL;
+}
+
+/*
+ * Runs the same worker over every chunk, on separate threads when there is more than one chunk.
+ */
+static void runChunks(ParseChunk *chunks, int chunkCount, void *(*worker)(void *))
+{
+    pthread_t *threads = (chunkCount > 1) ? malloc(chunkCount * sizeof(pthread_t)) : NULL;
+    int *started = (chunkCount > 1) ? calloc(chunkCount, sizeof(int)) : NULL;
+
+    for (int i = 1; threads != NULL && started != NULL && i < chunkCount; i++)
+        started[i] = (pthread_create(&threads[i], NULL, worker, &chunks[i]) == 0);
+
+    // The calling thread takes the first chunk, and any chunk whose thread could not be started
+    worker(&chunks[0]);
+    for (int i = 1; i < chunkCount; i++) {
+        if (started != NULL && started[i])
+            pthread_join(threads[i], NULL);
+        else
+            worker(&chunks[i]);
+    }
+
+    free(threads);
+    free(started);
+}
+
+/*
+ * Parses a text (version 1) file that is already in memory.  There is no line length or row count limit.
+ * @Param base: Start of the file contents from loadFile.
+ * @Param size: Size of the file contents.
+ * @Param threadCount: Number of threads the data rows are split across.
+ * @return: A CnCData struct with isMalformed cleared on success.
+ */
+static CnCData readTextCNC(const char *base, size_t size, int threadCount)
+{
+    CnCData data = { .isMalformed = 1 };
+    const char *end = base + size;
+    const char *cursor = base;
+
+    //Parse first line for metadata: version, result count, column count, then the test name up to the line break
+    uint64_t header[3];
+    for (int i = 0; i < 3; i++) {
+        uint64_t value = 0;
+        const char *start = cursor;
+        for (; cursor < end && *cursor >= '0' && *cursor <= '9'; cursor++)
+            if (value < UINT32_MAX)
+                value = value * 10 + (uint64_t) (*cursor - '0');
+        if (cursor == start || cursor == end || *cursor != ',')
+            return data;
+        header[i] = value;
+        cursor++;
+    }
+    if (header[0] != VERSIONCODE || header[2] == 0 || header[2] > UINT32_MAX)
         return data;
+    data.columnCount = (uint32_t) header[2];
 
-    //Parse first line for metadata
-    if(VERSIONCODE != atoi(strtok_r(buffer, ",", &bufferSave))) return data;
-    data.resultCount = (uint32_t) atoi(strtok_r(bufferSave, ",", &bufferSave));
-    data.columnCount = (uint32_t) atoi(strtok_r(bufferSave, ",", &bufferSave));
-    if((data.resultCount == 0) || (data.columnCount == 0)) return data;
-    char *name = strtok_r(bufferSave, "\n", &bufferSave);
-    memcpy(&data.testName[0], name, strlen(name));
+    const char *lineEnd = memchr(cursor, '\n', (size_t) (end - cursor));
+    if (lineEnd == NULL)
+        return data;
+    size_t nameLength = (size_t) (lineEnd - cursor);
+    if (nameLength > 0 && cursor[nameLength - 1] == '\r')
+        nameLength--;
 
-    data.columnNames = malloc(data.columnCount * sizeof(char[256]));
-    fgets(buffer, BUFFERLIMIT, file);
-    bufferSave = buffer;
+    //Anything after a tab is the metadata string
+    const char *tab = memchr(cursor, '\t', nameLength);
+    if (tab != NULL) {
+        size_t metadataLength = nameLength - (size_t) (tab + 1 - cursor);
+        if (metadataLength > 255)
+            metadataLength = 255;
+        memcpy(data.metadata, tab + 1, metadataLength);
+        nameLength = (size_t) (tab - cursor);
+    }
+    if (nameLength > 255)
+        nameLength = 255;
+    memcpy(data.testName, cursor, nameLength);
+    cursor = lineEnd + 1;
 
     // Grab each column name
-    for (int i = 0; i < data.columnCount; i++)
-    {
-        char *token = strtok_r(bufferSave, ",", &bufferSave);
-        int len = strlen(token);
+    lineEnd = memchr(cursor, '\n', (size_t) (end - cursor));
+    if (lineEnd == NULL)
+        lineEnd = end;
+    data.columnNames = calloc(data.columnCount, sizeof(char[256]));
+    if (data.columnNames == NULL)
+        return data;
+    for (uint32_t i = 0; i < data.columnCount; i++) {
+        const char *nameEnd = cursor;
+        while (nameEnd < lineEnd && *nameEnd != ',' && *nameEnd != '\r')
+            nameEnd++;
+        if (nameEnd == cursor && nameEnd == lineEnd)
+            return data;
+
+        // Prevent oversized names, calloc already left the terminator in place
+        size_t length = (size_t) (nameEnd - cursor);
+        memcpy(data.columnNames[i], cursor, length > 255 ? 255 : length);
+        cursor = (nameEnd < lineEnd) ? nameEnd + 1 : lineEnd;
+    }
+    cursor = (lineEnd < end) ? lineEnd + 1 : end;
 
-        // Prevent oversized names, and remove newline
-        if (len > 256)
-            len = 256;
-        else if (token[len - 1] == '\n')
-            len -= 1;
-        memcpy(data.columnNames[i], token, len);
+    // Split the data rows into chunks on line boundaries, one per thread
+    uint64_t dataSize = (uint64_t) (end - cursor);
+    if (threadCount < 1)
+        threadCount = 1;
+    if ((uint64_t) threadCount > dataSize / 65536 + 1)
+        threadCount = (int) (dataSize / 65536 + 1);
 
-        // Ensure it's null terminated
-        data.columnNames[i][len] = 0;
+    ParseChunk *chunks = calloc(threadCount, sizeof(ParseChunk));
+    if (chunks == NULL)
+        return data;
+    const char *chunkStart = cursor;
+    for (int i = 0; i < threadCount; i++) {
+        const char *chunkEnd = (i + 1 == threadCount) ? end : cursor + dataSize * (i + 1) / threadCount;
+        if (chunkEnd < chunkStart)
+            chunkEnd = chunkStart;
+        const char *lineBreak = memchr(chunkEnd, '\n', (size_t) (end - chunkEnd));
+        chunkEnd = (lineBreak == NULL || i + 1 == threadCount) ? end : lineBreak + 1;
+        chunks[i].begin = chunkStart;
+        chunks[i].end = chunkEnd;
+        chunkStart = chunkEnd;
     }
 
-    data.resultList = (double *) malloc(data.resultCount * sizeof(double));
-    fgets(buffer, BUFFERLIMIT, file);
-    bufferSave = buffer;
+    //The header's result count is only used as a hint, the rows present in the file are what gets returned
+    runChunks(chunks, threadCount, countChunk);
+    uint64_t resultCount = 0;
+    for (int i = 0; i < threadCount; i++)
+        resultCount += chunks[i].valueCount;
+    if (resultCount == 0 || resultCount > UINT32_MAX) {
+        free(chunks);
+        return data;
+    }
 
-    //Grab one line at a time and parse into values.  Currently limited to FP64 types
-    for (int i = 0; i < data.resultCount; i++)
-    {
-        data.resultList[i] = atof(strtok_r(bufferSave, ",", &bufferSave));
+    data.resultCount = (uint32_t) resultCount;
+    data.resultList = (double *) malloc(resultCount * sizeof(double));
+    if (data.resultList == NULL) {
+        free(chunks);
+        return data;
+    }
+    uint64_t resultOffset = 0;
+    for (int i = 0; i < threadCount; i++) {
+        chunks[i].out = data.resultList + resultOffset;
+        resultOffset += chunks[i].valueCount;
     }
 
-    fclose(file);
-    data.isMalformed = 0; //Sets the malform check to false as the operation is complete.
+    runChunks(chunks, threadCount, parseChunk);
+    int failed = 0;
+    for (int i = 0; i < threadCount; i++)
+        failed |= chunks[i].failed;
+    free(chunks);
+
+    data.isMalformed = (uint8_t) failed; //Sets the malform check to false once every chunk parsed cleanly.
+    return data;
+}
+
+CnCData read_CNC_parallel(char fileName[], int threadCount)
+{
+    //Copied for parity with write_CNC
+    //Append .cnc to the testName input.  File type is ALWAYS .cnc
+    char AppendedName[255];
+    strcpy(AppendedName, fileName);
+    strcat_s(AppendedName, 255, ".cnc");
 
+    CnCData data = { .isMalformed = 1 };
+    size_t size;
+    uint8_t *base = loadFile(AppendedName, &size);
+    if (base == NULL)
+        return data;
+
+    //Binary files are identified by their magic and keep their mapping, text and compressed files are decoded and released
+    if (size >= CNC_BINARY_HEADER_SIZE && memcmp(base, CNC_BINARY_MAGIC, 4) == 0 &&
+        toLittle32(((const CnCBinaryHeader *) base)->version) == CNC_FORMAT_COMPRESSED)
+        return readCompressedCNC(base, size);
+    if (size >= 4 && memcmp(base, CNC_BINARY_MAGIC, 4) == 0)
+        return readBinaryCNC(base, size);
+
+    data = readTextCNC((const char *) base, size, threadCount);
+    unloadFile(base, size);
     return data;
 }
 
+CnCData read_CNC(char fileName[])
+{
+    return read_CNC_parallel(fileName, 1);
+}
+
+int64_t read_CNC_range(char fileName[], uint64_t firstRow, uint64_t rowCount, uint32_t column, double *out, size_t outCapacity)
+{
+    char AppendedName[255];
+    strcpy(AppendedName, fileName);
+    strcat_s(AppendedName, 255, ".cnc");
+
+    size_t size;
+    uint8_t *base = loadFile(AppendedName, &size);
+    if (base == NULL)
+        return -1;
+
+    uint32_t columnCount;
+    uint64_t resultCount;
+    int compressed = size >= CNC_BINARY_HEADER_SIZE && memcmp(base, CNC_BINARY_MAGIC, 4) == 0 &&
+                     toLittle32(((const CnCBinaryHeader *) base)->version) == CNC_FORMAT_COMPRESSED;
+    CnCData data = { .isMalformed = 1 };
+    if (compressed) {
+        if (checkBinaryHeader(base, size) != 0) {
+            unloadFile(base, size);
+            return -1;
+        }
+        columnCount = toLittle32(((const CnCBinaryHeader *) base)->columnCount);
+        resultCount = toLittle64(((const CnCBinaryHeader *) base)->resultCount);
+#ifdef __unix__
+        // Only the blocks in range get touched
+        madvise(base, size, MADV_RANDOM);
+#endif
+    }
+    else {
+        unloadFile(base, size);
+        data = read_CNC(fileName);
+        if (data.isMalformed) {
+            free_CNC(&data);
+            return -1;
+        }
+        columnCount = data.columnCount;
+        resultCount = data.resultCount;
+    }
+
+    uint64_t fileRows = (resultCount + columnCount - 1) / columnCount;
+    uint64_t rowsRead = firstRow < fileRows ? fileRows - firstRow : 0;
+    if (rowsRead > rowCount)
+        rowsRead = rowCount;
+    uint64_t width = column == CNC_ALL_COLUMNS ? columnCount : 1;
+    int status = (column != CNC_ALL_COLUMNS && column >= columnCount) || rowsRead * width > outCapacity ? -1 : 0;
+
+    for (uint64_t i = 0; status == 0 && i < rowsRead * width; i++)
+        out[i] = __builtin_nan("");
+    if (status == 0 && rowsRead != 0 && compressed)
+        status = decodeBlocks(base, size, toLittle64(((const CnCBinaryHeader *) base)->payloadOffset), columnCount, resultCount,
+                              firstRow, rowsRead, column, out);
+    for (uint64_t row = 0; status == 0 && !compressed && row < rowsRead; row++) {
+        for (uint64_t c = 0; c < width; c++) {
+            uint64_t index = (firstRow + row) * columnCount + (column == CNC_ALL_COLUMNS ? c : column);
+            if (index < resultCount)
+                out[row * width + c] = data.resultList[index];
+        }
+    }
+
+    if (compressed)
+        unloadFile(base, size);
+    else
+        free_CNC(&data);
+    return status == 0 ? (int64_t) rowsRead : -1;
+}
+
 int write_CNC(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256])
 {
     FILE *file;
@@ -129,4 +1035,306 @@ int write_CNC(char testName[], double resultList[], uint32_t resultCount, uint32
 
     fclose(file);
     return 0;
-}
\ No newline at end of file
+}
+
+// Below this the value in millionths stays under 2^52, where every double has an exact integer and fraction part
+#define FORMAT_FAST_LIMIT 4.0e9
+
+/*
+ * Formats a value the same way "%lf" does, without going through stdio for every value.
+ * The product with 1e6 is rounded, so its rounding error (exact through fma) decides the last digit the way the
+ * decimal value would, ties included.  Magnitudes outside the fast path (and NaN/Inf) fall back to snprintf.
+ * @Param out: Destination, needs room for at least 64 characters.
+ * @Param value: The value to format.
+ * @return: The number of characters written.
+ */
+static size_t formatDouble(char *out, double value)
+{
+    if (!(value > -FORMAT_FAST_LIMIT && value < FORMAT_FAST_LIMIT))
+        return (size_t) snprintf(out, 64, "%lf", value);
+
+    char *cursor = out;
+    if (value < 0 || (value == 0 && __builtin_signbit(value))) {
+        *cursor++ = '-';
+        value = -value;
+    }
+
+    // value * 1e6 is exactly product + error, and product - floor(product) is exact below 2^52
+    double product = value * 1e6;
+    double error = fma(value, 1e6, -product);
+    double floored = floor(product);
+    uint64_t scaled = (uint64_t) floored;
+    double above = product - floored;
+    if (above >= 0.25) {
+        double half = above - 0.5;
+        if (half > -error || (half == -error && (scaled & 1)))
+            scaled++;
+    }
+    uint64_t whole = scaled / 1000000;
+    uint32_t fraction = (uint32_t) (scaled % 1000000);
+
+    // Integer digits come out backwards, so build them in a scratch buffer first
+    char digits[20];
+    int digitCount = 0;
+    do {
+        digits[digitCount++] = (char) ('0' + whole % 10);
+        whole /= 10;
+    } while (whole != 0);
+    while (digitCount > 0)
+        *cursor++ = digits[--digitCount];
+
+    *cursor++ = '.';
+    for (int i = 5; i >= 0; i--) {
+        cursor[i] = (char) ('0' + fraction % 10);
+        fraction /= 10;
+    }
+    cursor += 6;
+
+    return (size_t) (cursor - out);
+}
+
+/*
+ * Writes out whatever is staged in the writer's buffer without touching the header.
+ */
+static int drainWriter(CnCWriter *writer)
+{
+    if (writer->format == CNC_FORMAT_COMPRESSED)
+        return writeBlock(writer);
+    if (writer->bufferUsed != 0 && fwrite(writer->buffer, 1, writer->bufferUsed, writer->file) != writer->bufferUsed)
+        return -1;
+    writer->bufferUsed = 0;
+    return 0;
+}
+
+/*
+ * Appends an arbitrary number of values, rows are split every columnCount values in text files.
+ */
+static int appendValues(CnCWriter *writer, const double values[], uint64_t valueCount)
+{
+    if (writer->format == CNC_FORMAT_COMPRESSED) {
+        for (uint64_t i = 0; i < valueCount; i++) {
+            if (writer->bufferUsed == CNC_BLOCK_VALUES * sizeof(double) && writeBlock(writer) != 0)
+                return -1;
+            memcpy(writer->buffer + writer->bufferUsed, &values[i], sizeof(double));
+            writer->bufferUsed += sizeof(double);
+            writer->resultCount++;
+        }
+        return 0;
+    }
+
+    if (writer->format == CNC_FORMAT_BINARY) {
+        uint64_t byteCount = valueCount * sizeof(double);
+
+        // Large blocks skip the staging buffer entirely
+        if (byteCount >= CNC_WRITER_BUFFER_SIZE && !HOST_IS_BIG_ENDIAN) {
+            if (drainWriter(writer) != 0 || fwrite(values, sizeof(double), valueCount, writer->file) != valueCount)
+                return -1;
+            writer->resultCount += valueCount;
+            return 0;
+        }
+
+        for (uint64_t i = 0; i < valueCount; i++) {
+            if (writer->bufferUsed + sizeof(double) > CNC_WRITER_BUFFER_SIZE && drainWriter(writer) != 0)
+                return -1;
+            uint64_t raw;
+            memcpy(&raw, &values[i], sizeof(raw));
+            raw = toLittle64(raw);
+            memcpy(writer->buffer + writer->bufferUsed, &raw, sizeof(raw));
+            writer->bufferUsed += sizeof(raw);
+            writer->resultCount++;
+        }
+        return 0;
+    }
+
+    // The text header only has room for a 10 digit count
+    if (writer->resultCount + valueCount > UINT32_MAX)
+        return -1;
+    for (uint64_t i = 0; i < valueCount; i++) {
+        // One formatted value plus its delimiter always fits in 66 characters
+        if (writer->bufferUsed + 66 > CNC_WRITER_BUFFER_SIZE && drainWriter(writer) != 0)
+            return -1;
+        writer->bufferUsed += formatDouble(writer->buffer + writer->bufferUsed, values[i]);
+        writer->resultCount++;
+        writer->buffer[writer->bufferUsed++] = (writer->resultCount % writer->columnCount == 0) ? '\n' : ',';
+    }
+    return 0;
+}
+
+CnCWriter *open_CNC(char testName[], uint32_t columnCount, char (*columnNames)[256], uint8_t format, const char metadata[])
+{
+    //Same file name rules as write_CNC
+    if (strlen(testName) > 250 || columnCount == 0)
+        return NULL;
+    if (format != CNC_FORMAT_TEXT && format != CNC_FORMAT_BINARY && format != CNC_FORMAT_COMPRESSED)
+        return NULL;
+
+    char AppendedName[255];
+    strcpy(AppendedName, testName);
+    strcat_s(AppendedName, 255, ".cnc");
+
+    CnCWriter *writer = calloc(1, sizeof(CnCWriter));
+    if (writer == NULL)
+        return NULL;
+    writer->format = format;
+    writer->columnCount = columnCount;
+    writer->buffer = malloc(CNC_WRITER_BUFFER_SIZE);
+
+    //Worst case is 77 bits a value, plus the block tables and the last partial byte of every column
+    if (format == CNC_FORMAT_COMPRESSED)
+        writer->blockBuffer = malloc(sizeof(CnCBlockHeader) + (size_t) columnCount * (sizeof(CnCColumnStream) + 8) + CNC_BLOCK_VALUES * 10);
+    if (writer->buffer == NULL || (format == CNC_FORMAT_COMPRESSED && writer->blockBuffer == NULL) ||
+        (writer->file = fopen(AppendedName, "wb")) == NULL) {
+        free(writer->buffer);
+        free(writer->blockBuffer);
+        free(writer);
+        return NULL;
+    }
+
+    //Metadata shares the text header line, so it can't carry the tab that introduces it or a line break
+    char cleanMetadata[256] = "";
+    if (metadata != NULL) {
+        strncpy(cleanMetadata, metadata, 255);
+        for (char *c = cleanMetadata; *c != 0; c++)
+            if (*c == '\t' || *c == '\r' || *c == '\n')
+                *c = ' ';
+    }
+
+    int status = 0;
+    if (format == CNC_FORMAT_TEXT) {
+        //The result count is zero padded to a fixed width so every flush can rewrite it in place
+        writer->countOffset = fprintf(writer->file, "%u,", VERSIONCODE);
+        fprintf(writer->file, "%010u,%u,%s", 0, columnCount, testName);
+        fprintf(writer->file, cleanMetadata[0] != 0 ? "\t%s\n" : "%s\n", cleanMetadata);
+        for (uint32_t i = 0; i < columnCount; i++)
+            fprintf(writer->file, (i + 1 != columnCount) ? "%s," : "%s\n", columnNames[i]);
+    }
+    else {
+        uint64_t columnTableOffset = CNC_BINARY_HEADER_SIZE;
+        uint64_t payloadOffset = columnTableOffset + (uint64_t) columnCount * 256;
+        payloadOffset = (payloadOffset + CNC_PAYLOAD_ALIGNMENT - 1) & ~((uint64_t) CNC_PAYLOAD_ALIGNMENT - 1);
+
+        CnCBinaryHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CNC_BINARY_MAGIC, 4);
+        header.version = toLittle32(format == CNC_FORMAT_COMPRESSED ? CNC_FORMAT_COMPRESSED : BINARY_VERSIONCODE);
+        header.headerSize = toLittle32(CNC_BINARY_HEADER_SIZE);
+        header.columnCount = toLittle32(columnCount);
+        header.columnTableOffset = toLittle64(columnTableOffset);
+        header.payloadOffset = toLittle64(payloadOffset);
+        strncpy(header.testName, testName, 255);
+        memcpy(header.metadata, cleanMetadata, 256);
+        writer->countOffset = offsetof(CnCBinaryHeader, resultCount);
+
+        //The header and column table are small, so stage them together with the alignment padding in one buffer
+        size_t prefixSize = (size_t) payloadOffset;
+        char *prefix = calloc(1, prefixSize);
+        if (prefix == NULL)
+            status = -1;
+        else {
+            memcpy(prefix, &header, sizeof(header));
+            for (uint32_t i = 0; i < columnCount; i++)
+                strncpy(prefix + columnTableOffset + (uint64_t) i * 256, columnNames[i], 255);
+            if (fwrite(prefix, 1, prefixSize, writer->file) != prefixSize)
+                status = -1;
+            free(prefix);
+        }
+    }
+
+    if (status != 0 || ferror(writer->file)) {
+        fclose(writer->file);
+        free(writer->buffer);
+        free(writer->blockBuffer);
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+int append_CNC(CnCWriter *writer, const double row[])
+{
+    return appendValues(writer, row, writer->columnCount);
+}
+
+int flush_CNC(CnCWriter *writer)
+{
+    if (drainWriter(writer) != 0)
+        return -1;
+
+    //Patch the header so readers see exactly the rows written so far, then go back to the end of the file
+    long end = ftell(writer->file);
+    if (end < 0 || fseek(writer->file, writer->countOffset, SEEK_SET) != 0)
+        return -1;
+
+    int status = 0;
+    if (writer->format == CNC_FORMAT_TEXT) {
+        if (fprintf(writer->file, "%010u", (uint32_t) writer->resultCount) != 10)
+            status = -1;
+    }
+    else {
+        uint64_t count = toLittle64(writer->resultCount);
+        if (fwrite(&count, sizeof(count), 1, writer->file) != 1)
+            status = -1;
+    }
+
+    if (fseek(writer->file, end, SEEK_SET) != 0 || fflush(writer->file) != 0)
+        status = -1;
+    return status;
+}
+
+int close_CNC(CnCWriter *writer)
+{
+    int status = flush_CNC(writer);
+    if (fclose(writer->file) != 0)
+        status = -1;
+    free(writer->buffer);
+    free(writer->blockBuffer);
+    free(writer);
+    return status;
+}
+
+int write_CNC_binary(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256])
+{
+    //Enforce maximum file name limit of 255 or lower in accordance with most restrictive OS limits
+    if(strlen(testName) > 250)
+        return -2;
+
+    CnCWriter *writer = open_CNC(testName, columnCount, columnNames, CNC_FORMAT_BINARY, NULL);
+    if (writer == NULL)
+        return -1;
+
+    int status = appendValues(writer, resultList, resultCount);
+    if (close_CNC(writer) != 0)
+        status = -1;
+    return status;
+}
+
+int write_CNC_compressed(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256])
+{
+    if(strlen(testName) > 250)
+        return -2;
+
+    CnCWriter *writer = open_CNC(testName, columnCount, columnNames, CNC_FORMAT_COMPRESSED, NULL);
+    if (writer == NULL)
+        return -1;
+
+    int status = appendValues(writer, resultList, resultCount);
+    if (close_CNC(writer) != 0)
+        status = -1;
+    return status;
+}
+
+void free_CNC(CnCData *data)
+{
+    if (data->mapping != NULL) {
+        unloadFile(data->mapping, data->mappingSize);
+    }
+    else {
+        free(data->columnNames);
+        free(data->resultList);
+    }
+
+    data->mapping = NULL;
+    data->mappingSize = 0;
+    data->columnNames = NULL;
+    data->resultList = NULL;
+}
@@ -4,40 +4,158 @@
  * Program Name: CnC Common Headers
  * File Name: storage.h
  * Date Created: February 4, 2024
- * Date Updated: November 11, 2024
- * Version: 0.5
+ * Date Updated: October 18, 2026
+ * Version: 0.10
  * Purpose: Provides a struct for storing results and functions for file logging
  */
 #include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
 
 /* Currently the ".cnc" file format is a modified csv with a header row, followed by a
  * single row of strings representing the column names, and then all subsequent rows are the data entry points.
  *
- * Header Row contains 3 metadata entries corresponding to the version number, the result count, and the column count.
+ * Header Row contains 3 metadata entries corresponding to the version number, the result count, and the column count,
+ * followed by the test name.  The name may be followed by a tab and a free form metadata string describing how the
+ * results were produced (no tabs or line breaks), files without one read back with an empty string.
+ *
+ * Data rows may be any length and there may be any number of them, the values present in the file take precedence over
+ * the result count in the header.  Both LF and CRLF line endings are accepted.
  *
  * LIMITATIONS: Currently column names are limited to 255 characters (no commas allowed), and all results are formatted as double precision FP.
- * Differing text and line encoding are also currently untested and potentially unsupported.
+ * Differing text encoding is also currently untested and potentially unsupported.
+ *
+ * Version 2 of the format is binary and laid out so that it can be memory mapped and used in place:
+ *   - A fixed size CnCBinaryHeader (CNC_BINARY_HEADER_SIZE bytes, all integers little-endian).
+ *   - The column table, columnCount entries of 256 bytes each, every entry null terminated.
+ *   - The payload, resultCount little-endian FP64 values in row-major order, starting on a
+ *     CNC_PAYLOAD_ALIGNMENT byte boundary.
+ * read_CNC detects the format from the first bytes of the file, so both versions load through the same call.
+ *
+ * Version 3 is the compressed layout for long per-sample traces.  It keeps the version 2 header and column table,
+ * but the payload is a chain of blocks that each hold up to CNC_BLOCK_VALUES consecutive values of the row-major
+ * result list:
+ *   - A CnCBlockHeader, then a CnCColumnStream entry per column (all integers little-endian).
+ *   - One bit stream per column, back to back in column order.  Columns whose values in the block are all whole
+ *     numbers are stored as Gorilla style delta-of-delta integers (CNC_CODEC_DELTA), every other column as the
+ *     XOR of each value with the one before it (CNC_CODEC_XOR), so slowly varying series take a few bits per value.
+ * Every block header carries its own size and first value index, so a reader can walk to any row range, and pick
+ * out one column within it, without decoding anything else (see read_CNC_range).
  */
 
 #define BUFFERLIMIT 100000 //The max value for input and other read operations
+#define CNC_WRITER_BUFFER_SIZE (1 << 20) //Output buffer used by the streaming writer before it touches the file
+
+#define CNC_FORMAT_TEXT 1
+#define CNC_FORMAT_BINARY 2
+#define CNC_FORMAT_COMPRESSED 3
+
+#define CNC_BINARY_MAGIC "CNCB"
+#define CNC_BINARY_HEADER_SIZE 1024
+#define CNC_PAYLOAD_ALIGNMENT 64
+
+#define CNC_BLOCK_VALUES (CNC_WRITER_BUFFER_SIZE / 8) //Most values in one compressed block, the writer buffer holds exactly one
+#define CNC_CODEC_XOR 0
+#define CNC_CODEC_DELTA 1
+#define CNC_ALL_COLUMNS UINT32_MAX
+
+typedef struct __CnCBinaryHeader
+{
+    char magic[4];              // Always CNC_BINARY_MAGIC, never a digit so it can't be mistaken for a text header
+    uint32_t version;           // Binary format version, 2 for plain FP64 or 3 for compressed blocks
+    uint32_t headerSize;        // Size of this header on disk, lets later versions grow it
+    uint32_t columnCount;
+    uint64_t resultCount;
+    uint64_t columnTableOffset; // Byte offset of the column table from the start of the file
+    uint64_t payloadOffset;     // Byte offset of the FP64 payload (or the first block), a multiple of CNC_PAYLOAD_ALIGNMENT
+    char testName[256];
+    char metadata[256];         // Null terminated, all zero when the writer had none
+    uint8_t reserved[CNC_BINARY_HEADER_SIZE - 552];
+} CnCBinaryHeader;
+
+typedef struct __CnCBlockHeader
+{
+    uint64_t blockSize;         // Bytes from the start of this header to the start of the next block
+    uint64_t firstValue;        // Index of the block's first value in the row-major result list
+    uint32_t valueCount;        // Values in the block, at most CNC_BLOCK_VALUES and not necessarily whole rows
+    uint32_t columnCount;       // Same as the file's, so a block can be checked on its own
+} CnCBlockHeader;
+
+typedef struct __CnCColumnStream
+{
+    uint32_t size;              // Bytes in the column's bit stream
+    uint8_t codec;              // CNC_CODEC_XOR or CNC_CODEC_DELTA
+    uint8_t reserved[3];
+} CnCColumnStream;
 
 typedef struct __CnCData
 {
     uint8_t isMalformed;
     char testName[256];
+    char metadata[256];
     uint32_t resultCount;
     uint32_t columnCount;
     char (*columnNames)[256];
     double *resultList;
+    void *mapping;      // Backing storage when columnNames/resultList point into a loaded binary file, NULL otherwise
+    size_t mappingSize;
 } CnCData; 
 
+/*
+ * State for a .cnc file that is written one row at a time.  Values are staged in a private buffer and the
+ * result count in the header is patched on every flush, so a file is always readable up to its last flush.
+ */
+typedef struct __CnCWriter
+{
+    FILE *file;
+    uint8_t format;         // CNC_FORMAT_TEXT, CNC_FORMAT_BINARY or CNC_FORMAT_COMPRESSED
+    uint32_t columnCount;
+    uint64_t resultCount;   // Values appended so far, including the ones still sitting in the buffer
+    long countOffset;       // File offset of the header's result count
+    char *buffer;           // Compressed files gather a whole block of values here before encoding it
+    size_t bufferUsed;
+    uint8_t *blockBuffer;   // Encoded block, only allocated for compressed files
+} CnCWriter;
+
 /*
  * Reads/parses the specified file and produces a CnCData struct from the data entries.
  * @Param fileName: A char array representing the name of the file to be ingested.
- * @return: a single CnCData struct.  testName = FAILED if the test does not parse successfully.
+ * Binary (version 2) files are memory mapped and resultList/columnNames point straight into the mapping.
+ * @return: a single CnCData struct.  isMalformed is set if the file does not parse successfully.
  */
 CnCData read_CNC(char fileName[]);
 
+/*
+ * Same as read_CNC, but text files large enough to benefit are split into row ranges that are parsed on
+ * separate threads.  Binary files are mapped exactly as read_CNC does.
+ * @Param fileName: A char array representing the name of the file to be ingested.
+ * @Param threadCount: The maximum number of threads to parse with.
+ * @return: a single CnCData struct.  isMalformed is set if the file does not parse successfully.
+ */
+CnCData read_CNC_parallel(char fileName[], int threadCount);
+
+/*
+ * Reads a range of rows, either every column or just one, without loading the rest of the file.  Compressed
+ * (version 3) files only decode the blocks that overlap the range, and within them only the requested column's
+ * stream.  Text and version 2 files are read whole and the range is copied out.
+ * @Param fileName: A char array representing the name of the file to be ingested.
+ * @Param firstRow: First row to read.
+ * @Param rowCount: Number of rows to read.
+ * @Param column: Column to read, or CNC_ALL_COLUMNS for whole rows.
+ * @Param out: Receives the values row-major, one per row for a single column.  Values missing from a partial last
+ *             row are set to NaN.
+ * @Param outCapacity: Number of values out has room for.
+ * @return: The number of rows read, fewer than rowCount at the end of the file, or -1 if the file does not parse
+ *          or out is too small.
+ */
+int64_t read_CNC_range(char fileName[], uint64_t firstRow, uint64_t rowCount, uint32_t column, double *out, size_t outCapacity);
+
+/*
+ * Releases the memory or mapping held by a CnCData struct returned from read_CNC.
+ * @Param data: The struct to release, its pointers are cleared afterwards.
+ */
+void free_CNC(CnCData *data);
+
 /*
  * Writes the stored list of results to a csv file with the .cnc extension
  * @Param TestName: a char array representing the name of the test.
@@ -48,4 +166,52 @@ CnCData read_CNC(char fileName[]);
  */
 
 int write_CNC(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256]);
+
+/*
+ * Writes the stored list of results to a binary (version 2) file with the .cnc extension
+ * Takes the same parameters and returns the same codes as write_CNC.
+ */
+int write_CNC_binary(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256]);
+
+/*
+ * Writes the stored list of results to a compressed (version 3) file with the .cnc extension
+ * Takes the same parameters and returns the same codes as write_CNC.
+ */
+int write_CNC_compressed(char testName[], double resultList[], uint32_t resultCount, uint32_t columnCount, char (*columnNames)[256]);
+
+/*
+ * Creates a .cnc file for streaming output and writes its header and column names.
+ * @Param testName: a char array representing the name of the test, .cnc is appended for the file name.
+ * @Param columnCount: The number of values in every row that will be appended.
+ * @Param columnNames: The name of each column.
+ * @Param format: CNC_FORMAT_TEXT, CNC_FORMAT_BINARY or CNC_FORMAT_COMPRESSED.
+ * @Param metadata: Stored in the header and read back into CnCData.metadata, NULL for none.  Up to 255 characters,
+ *                  tabs and line breaks are replaced with spaces.
+ * @Return: A writer to pass to the other streaming calls, or NULL on failure.
+ */
+CnCWriter *open_CNC(char testName[], uint32_t columnCount, char (*columnNames)[256], uint8_t format, const char metadata[]);
+
+/*
+ * Appends one row to the file.  The row is only guaranteed to be on disk after the next flush_CNC or close_CNC.
+ * Compressed files encode a block whenever CNC_BLOCK_VALUES values have gathered, and on every flush, so flushing
+ * them often costs compression.
+ * @Param writer: The writer returned by open_CNC.
+ * @Param row: columnCount values to append.
+ * @Return: 0 if successful, -1 for IO error or if a text file would go past UINT32_MAX values.
+ */
+int append_CNC(CnCWriter *writer, const double row[]);
+
+/*
+ * Pushes all buffered rows to the file and updates the header so the rows written so far can be read back.
+ * @Param writer: The writer returned by open_CNC.
+ * @Return: 0 if successful, -1 for IO error.
+ */
+int flush_CNC(CnCWriter *writer);
+
+/*
+ * Flushes and closes the file, then releases the writer.
+ * @Param writer: The writer returned by open_CNC, invalid after this call.
+ * @Return: 0 if successful, -1 for IO error.
+ */
+int close_CNC(CnCWriter *writer);
 #endif // STORAGE_H
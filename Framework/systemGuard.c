@@ -0,0 +1,174 @@
+#include <systemGuard.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: systemGuard.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Checks that the system is quiet and clocked steadily enough for a measurement to mean something
+ */
+
+#define FREQUENCY_CHUNK_ITERATIONS 1024 // Eight adds each, a chunk is about 8k cycles between clock reads
+
+// The empty asm makes the compiler keep every add and run them in order, on any architecture.  The step comes
+// from a register the compiler can't see into, recent cores fold chains of add immediate at rename.
+#define DEPENDENT_ADD(x, step) do { (x) += (step); __asm__ volatile("" : "+r"(x)); } while (0)
+
+static uint64_t monotonicNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+double measureCoreFrequency(uint64_t durationNs)
+{
+    uint64_t chain = 0, adds = 0, step = 1;
+    __asm__ volatile("" : "+r"(step));
+    uint64_t begin = monotonicNs(), now;
+    do {
+        for (int i = 0; i < FREQUENCY_CHUNK_ITERATIONS; i++) {
+            DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step);
+            DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step); DEPENDENT_ADD(chain, step);
+        }
+        adds += 8 * FREQUENCY_CHUNK_ITERATIONS;
+        now = monotonicNs();
+    } while (now - begin < durationNs);
+    return chain == adds ? adds * 1000.0 / (now - begin) : 0;
+}
+
+#ifdef __linux__
+
+/*
+ * Reads a single line from a sysfs file, without the trailing newline.
+ */
+static int readSysfsLine(const char *path, char *buffer, size_t size)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+    char *line = fgets(buffer, (int)size, file);
+    fclose(file);
+    if (line == NULL)
+        return -1;
+    buffer[strcspn(buffer, "\n")] = '\0';
+    return 0;
+}
+
+int getCpuFrequencyInfo(int cpu, CpuFrequencyInfo *info)
+{
+    static const char *files[] = { "scaling_governor", "scaling_cur_freq", "scaling_min_freq", "scaling_max_freq" };
+    char path[128], value[32];
+    memset(info, 0, sizeof(CpuFrequencyInfo));
+
+    for (int f = 0; f < 4; f++) {
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/%s", cpu, files[f]);
+        if (readSysfsLine(path, value, sizeof(value)) != 0)
+            return -1;
+        // sysfs reports kHz
+        if (f == 0)
+            snprintf(info->governor, sizeof(info->governor), "%s", value);
+        else if (f == 1)
+            info->currentMHz = atof(value) / 1000.0;
+        else if (f == 2)
+            info->minMHz = atof(value) / 1000.0;
+        else
+            info->maxMHz = atof(value) / 1000.0;
+    }
+    return 0;
+}
+
+int getLoadAverage(double *load)
+{
+    char value[128];
+    if (readSysfsLine("/proc/loadavg", value, sizeof(value)) != 0)
+        return -1;
+    *load = atof(value);
+    return 0;
+}
+
+int getInterruptCounts(uint64_t *counts, int cpuCount)
+{
+    FILE *file = fopen("/proc/interrupts", "r");
+    if (file == NULL)
+        return -1;
+    memset(counts, 0, sizeof(uint64_t) * cpuCount);
+
+    // The header names a column for every online CPU, offline ones have no column at all
+    char *line = NULL;
+    size_t lineSize = 0;
+    int columnCount = 0;
+    int *columnCpu = NULL;
+    if (getline(&line, &lineSize, file) > 0) {
+        for (char *token = strstr(line, "CPU"); token != NULL; token = strstr(token + 3, "CPU"))
+            columnCount++;
+        columnCpu = (int *)malloc(sizeof(int) * (columnCount + 1));
+        char *cursor = line;
+        int consumed;
+        for (int column = 0; columnCpu != NULL && column < columnCount; column++) {
+            if (sscanf(cursor, " CPU%d%n", &columnCpu[column], &consumed) != 1)
+                columnCpu[column] = -1;
+            else
+                cursor += consumed;
+        }
+    }
+    if (columnCpu == NULL) {
+        free(line);
+        fclose(file);
+        return -1;
+    }
+
+    // Every source is "name: count per column" followed by a description, rows that are short (ERR, MIS) are totals
+    while (getline(&line, &lineSize, file) > 0) {
+        char *cursor = strchr(line, ':');
+        if (cursor == NULL)
+            continue;
+        cursor++;
+        uint64_t row[columnCount > 0 ? columnCount : 1];
+        int parsed = 0;
+        for (; parsed < columnCount; parsed++) {
+            char *end;
+            row[parsed] = strtoull(cursor, &end, 10);
+            if (end == cursor)
+                break;
+            cursor = end;
+        }
+        if (parsed != columnCount)
+            continue;
+        for (int column = 0; column < columnCount; column++)
+            if (columnCpu[column] >= 0 && columnCpu[column] < cpuCount)
+                counts[columnCpu[column]] += row[column];
+    }
+
+    free(columnCpu);
+    free(line);
+    fclose(file);
+    return 0;
+}
+
+#else
+
+int getCpuFrequencyInfo(int cpu, CpuFrequencyInfo *info)
+{
+    memset(info, 0, sizeof(CpuFrequencyInfo));
+    return -1;
+}
+
+int getLoadAverage(double *load)
+{
+    *load = 0;
+    return -1;
+}
+
+int getInterruptCounts(uint64_t *counts, int cpuCount)
+{
+    memset(counts, 0, sizeof(uint64_t) * cpuCount);
+    return -1;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SYSTEMGUARD_H
+#define SYSTEMGUARD_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: systemGuard.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.1
+ * Purpose: Checks that the system is quiet and clocked steadily enough for a measurement to mean something
+ */
+
+#include <stdint.h>
+
+/* What cpufreq says about one CPU, everything is left empty or zero when cpufreq isn't exposed */
+typedef struct CpuFrequencyInfo {
+    char governor[32];
+    double currentMHz;   // Last frequency the governor asked for, not necessarily what the core is running at
+    double minMHz;
+    double maxMHz;
+} CpuFrequencyInfo;
+
+/*
+ * Reads the cpufreq governor and frequency limits of a CPU.
+ * @Param cpu: The CPU ID.
+ * @Param info: Receives the settings.
+ * @Return: 0 if successful, -1 if cpufreq isn't available for the CPU.
+ */
+int getCpuFrequencyInfo(int cpu, CpuFrequencyInfo *info);
+
+/*
+ * Measures the clock of the core the calling thread runs on with a chain of dependent adds, each of which
+ * takes exactly one cycle, so it needs no privileges and sees turbo and throttling as they happen.
+ * @Param durationNs: How long to measure for, a few tens of microseconds is plenty.
+ * @Return: The effective frequency in MHz.
+ */
+double measureCoreFrequency(uint64_t durationNs);
+
+/*
+ * Reads the one minute load average.
+ * @Param load: Receives the load average.
+ * @Return: 0 if successful, -1 if it isn't available.
+ */
+int getLoadAverage(double *load);
+
+/*
+ * Reads the number of interrupts every CPU has taken since boot, over every interrupt source.
+ * @Param counts: Array of cpuCount entries indexed by CPU ID, CPUs the kernel doesn't list are set to 0.
+ * @Param cpuCount: One past the highest CPU ID of interest.
+ * @Return: 0 if successful, -1 if the counts aren't available.
+ */
+int getInterruptCounts(uint64_t *counts, int cpuCount);
+
+#endif // SYSTEMGUARD_H
@@ -0,0 +1,286 @@
+#include <platformCode.h>
+#include <threadPool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+/*
+ * Program Name: CnC Common Headers
+ * File Name: threadPool.c
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.2
+ * Purpose: Provides a persistent pool of worker threads, each pinned to one logical CPU, and a spin barrier
+ *          to line them up
+ */
+
+static inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*
+ * Sleeps until the word no longer holds the expected value (or a spurious wakeup), futex backed on Linux.
+ */
+static void parkOn(_Atomic uint32_t *word, uint32_t expected)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    if (atomic_load(word) == expected)
+        sched_yield();
+#endif
+}
+
+static void wakeAll(_Atomic uint32_t *word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *) word, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+    (void) word;
+#endif
+}
+
+/*
+ * Bounded multi-producer queue (Vyukov style), every slot carries a sequence number telling producers and
+ * the consumer whose turn it is, so neither side ever takes a lock.
+ */
+static int queuePush(PoolWorker *worker, PoolJob *job)
+{
+    size_t position = atomic_load_explicit(&worker->enqueuePosition, memory_order_relaxed);
+    for (;;) {
+        PoolQueueSlot *slot = &worker->slots[position & (THREADPOOL_QUEUE_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&worker->enqueuePosition, &position, position + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                slot->job = job;
+                atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+                return 0;
+            }
+        }
+        else if (difference < 0)
+            return -1;
+        else
+            position = atomic_load_explicit(&worker->enqueuePosition, memory_order_relaxed);
+    }
+}
+
+static PoolJob *queuePop(PoolWorker *worker)
+{
+    // Only the owning worker pops, so the dequeue position needs no compare and swap
+    size_t position = atomic_load_explicit(&worker->dequeuePosition, memory_order_relaxed);
+    PoolQueueSlot *slot = &worker->slots[position & (THREADPOOL_QUEUE_SIZE - 1)];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if ((intptr_t) sequence - (intptr_t) (position + 1) < 0)
+        return NULL;
+
+    PoolJob *job = slot->job;
+    atomic_store_explicit(&worker->dequeuePosition, position + 1, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, position + THREADPOOL_QUEUE_SIZE, memory_order_release);
+    return job;
+}
+
+/*
+ * Worker main loop: pin, then run jobs as they arrive, spinning for a while before parking.
+ * @Param param: Pointer to the PoolWorker being run.
+ * @return: Will always return NULL.
+ */
+static void *workerMain(void *param)
+{
+    PoolWorker *worker = (PoolWorker *) param;
+    ThreadPool *pool = worker->pool;
+
+    if (setAffinity(pthread_self(), worker->cpu) != 0) {
+        atomic_store(&worker->ready, -1);
+        return NULL;
+    }
+    atomic_store(&worker->ready, 1);
+
+    for (;;) {
+        PoolJob *job = NULL;
+        for (int spin = 0; spin < THREADPOOL_SPIN_COUNT && job == NULL; spin++) {
+            job = queuePop(worker);
+            if (job == NULL)
+                cpuRelax();
+        }
+
+        if (job == NULL) {
+            // Announce the nap, then check once more so a submit racing with us can't be missed
+            uint32_t sequence = atomic_load(&worker->wakeSequence);
+            atomic_store(&worker->sleeping, 1);
+            job = queuePop(worker);
+            if (job == NULL && !atomic_load(&pool->shutdown))
+                parkOn(&worker->wakeSequence, sequence);
+            atomic_store(&worker->sleeping, 0);
+        }
+
+        if (job != NULL) {
+            job->result = job->func(job->arg);
+            // The job may be released as soon as done is set, so only the worker's own word is touched after that
+            atomic_store_explicit(&job->done, 1, memory_order_release);
+            atomic_fetch_add(&worker->completionSequence, 1);
+            wakeAll(&worker->completionSequence);
+        }
+        else if (atomic_load(&pool->shutdown))
+            return NULL;
+    }
+}
+
+ThreadPool *createThreadPool(const int *cpus, int cpuCount)
+{
+    CpuTopology topology;
+    int *onlineCpus = NULL;
+
+    if (cpus == NULL) {
+        if (getTopology(&topology) != 0)
+            return NULL;
+        onlineCpus = (int *) malloc(topology.cpuCount * sizeof(int));
+        cpuCount = 0;
+        for (int cpu = 0; onlineCpus != NULL && cpu < topology.cpuCount; cpu++)
+            if (topology.cpus[cpu].online)
+                onlineCpus[cpuCount++] = cpu;
+        freeTopology(&topology);
+        if (onlineCpus == NULL)
+            return NULL;
+        cpus = onlineCpus;
+    }
+
+    ThreadPool *pool = (ThreadPool *) calloc(1, sizeof(ThreadPool));
+    int highestCpu = -1;
+    for (int i = 0; i < cpuCount; i++)
+        if (cpus[i] > highestCpu)
+            highestCpu = cpus[i];
+    if (pool != NULL) {
+        pool->cpuCount = highestCpu + 1;
+        pool->workerByCpu = (int *) malloc(pool->cpuCount * sizeof(int));
+        pool->workers = (PoolWorker *) allocateAligned(64, cpuCount * sizeof(PoolWorker));
+    }
+    if (pool == NULL || pool->workerByCpu == NULL || pool->workers == NULL) {
+        if (pool != NULL) {
+            free(pool->workerByCpu);
+            freeAligned(pool->workers);
+        }
+        free(pool);
+        free(onlineCpus);
+        return NULL;
+    }
+
+    memset(pool->workers, 0, cpuCount * sizeof(PoolWorker));
+    memset(pool->workerByCpu, -1, pool->cpuCount * sizeof(int));
+    atomic_store(&pool->shutdown, 0);
+
+    int failed = 0;
+    for (int i = 0; i < cpuCount && !failed; i++) {
+        PoolWorker *worker = &pool->workers[i];
+        worker->cpu = cpus[i];
+        worker->pool = pool;
+        for (size_t slot = 0; slot < THREADPOOL_QUEUE_SIZE; slot++)
+            atomic_store(&worker->slots[slot].sequence, slot);
+        if (pthread_create(&worker->thread, NULL, workerMain, worker) != 0)
+            failed = 1;
+        else {
+            pool->workerByCpu[cpus[i]] = i;
+            pool->workerCount++;
+        }
+    }
+
+    // Nothing gets submitted until every worker sits on its own CPU
+    for (int i = 0; i < pool->workerCount; i++) {
+        while (atomic_load(&pool->workers[i].ready) == 0)
+            sched_yield();
+        if (atomic_load(&pool->workers[i].ready) < 0)
+            failed = 1;
+    }
+
+    free(onlineCpus);
+    if (failed) {
+        destroyThreadPool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void destroyThreadPool(ThreadPool *pool)
+{
+    atomic_store(&pool->shutdown, 1);
+    for (int i = 0; i < pool->workerCount; i++) {
+        atomic_fetch_add(&pool->workers[i].wakeSequence, 1);
+        wakeAll(&pool->workers[i].wakeSequence);
+    }
+    for (int i = 0; i < pool->workerCount; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    free(pool->workerByCpu);
+    freeAligned(pool->workers);
+    free(pool);
+}
+
+void initJob(PoolJob *job, void *(*func)(void *), void *arg)
+{
+    job->func = func;
+    job->arg = arg;
+    job->result = NULL;
+    atomic_store(&job->done, 0);
+}
+
+int submitJob(ThreadPool *pool, int cpu, PoolJob *job)
+{
+    if (cpu < 0 || cpu >= pool->cpuCount || pool->workerByCpu[cpu] < 0)
+        return -1;
+
+    PoolWorker *worker = &pool->workers[pool->workerByCpu[cpu]];
+    job->worker = worker;
+    if (queuePush(worker, job) != 0)
+        return -1;
+
+    // Only pay for the wake syscall when the worker has actually gone to sleep
+    atomic_fetch_add(&worker->wakeSequence, 1);
+    if (atomic_load(&worker->sleeping))
+        wakeAll(&worker->wakeSequence);
+    return 0;
+}
+
+void *waitJob(PoolJob *job)
+{
+    for (int spin = 0; spin < THREADPOOL_SPIN_COUNT; spin++) {
+        if (atomic_load_explicit(&job->done, memory_order_acquire))
+            return job->result;
+        cpuRelax();
+    }
+    PoolWorker *worker = job->worker;
+    for (;;) {
+        uint32_t sequence = atomic_load(&worker->completionSequence);
+        if (atomic_load_explicit(&job->done, memory_order_acquire))
+            return job->result;
+        parkOn(&worker->completionSequence, sequence);
+    }
+}
+
+void initSpinBarrier(SpinBarrier *barrier, uint32_t count)
+{
+    barrier->count = count;
+    atomic_store(&barrier->remaining, count);
+    atomic_store(&barrier->generation, 0);
+}
+
+void spinBarrierWait(SpinBarrier *barrier)
+{
+    uint32_t generation = atomic_load_explicit(&barrier->generation, memory_order_acquire);
+    if (atomic_fetch_sub_explicit(&barrier->remaining, 1, memory_order_acq_rel) == 1) {
+        // Last to arrive rearms the barrier before releasing everyone, so it can be reused straight away
+        atomic_store_explicit(&barrier->remaining, barrier->count, memory_order_relaxed);
+        atomic_store_explicit(&barrier->generation, generation + 1, memory_order_release);
+        return;
+    }
+    while (atomic_load_explicit(&barrier->generation, memory_order_acquire) == generation)
+        cpuRelax();
+}
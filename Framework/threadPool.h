@@ -0,0 +1,114 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+/*
+ * Program Name: CnC Common Headers
+ * File Name: threadPool.h
+ * Date Created: October 18, 2026
+ * Date Updated: October 18, 2026
+ * Version: 0.2
+ * Purpose: Provides a persistent pool of worker threads, each pinned to one logical CPU, and a spin barrier
+ *          to line them up
+ */
+
+#include <platformCode.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define THREADPOOL_QUEUE_SIZE 64 // Jobs that can be queued on one worker at once, must be a power of two
+#define THREADPOOL_SPIN_COUNT 20000 // Empty polls a worker or waiter makes before going to sleep
+
+/* A unit of work for a worker.  The caller owns the job and must keep it alive until waitJob returns. */
+typedef struct PoolJob {
+    void *(*func)(void *);
+    void *arg;
+    void *result;
+    _Atomic uint32_t done;
+    struct PoolWorker *worker; // Set on submit, waiters sleep on this worker's completion sequence
+} PoolJob;
+
+typedef struct PoolQueueSlot {
+    _Atomic size_t sequence;
+    PoolJob *job;
+} PoolQueueSlot;
+
+/* Every worker lives on its own cache lines so one worker's queue traffic never touches another's. */
+typedef struct __attribute__((aligned(64))) PoolWorker {
+    pthread_t thread;
+    int cpu;
+    _Atomic int ready;             // 1 once pinned, -1 if pinning failed
+    _Atomic uint32_t wakeSequence; // Bumped on every submit, workers sleep on it
+    _Atomic int sleeping;
+    _Atomic uint32_t completionSequence; // Bumped after every finished job, waiters sleep on it
+    _Atomic size_t enqueuePosition __attribute__((aligned(64)));
+    _Atomic size_t dequeuePosition __attribute__((aligned(64)));
+    PoolQueueSlot slots[THREADPOOL_QUEUE_SIZE];
+    struct ThreadPool *pool;
+} PoolWorker;
+
+/* Sits alone on its cache line, so arriving threads never contend with the data they are about to measure. */
+typedef struct __attribute__((aligned(64))) SpinBarrier {
+    _Atomic uint32_t remaining;
+    _Atomic uint32_t generation;
+    uint32_t count;
+} SpinBarrier;
+
+typedef struct ThreadPool {
+    int workerCount;
+    int cpuCount;      // Size of workerByCpu
+    int *workerByCpu;  // CPU ID to worker index, -1 where the pool has no worker
+    PoolWorker *workers;
+    _Atomic int shutdown;
+} ThreadPool;
+
+/*
+ * Starts one worker per CPU and waits until every worker is running on its CPU.
+ * @Param cpus: CPU IDs to start workers on, NULL for every online CPU.
+ * @Param cpuCount: Number of entries in cpus, ignored when cpus is NULL.
+ * @Return: The pool, or NULL if a worker could not be started or pinned.
+ */
+ThreadPool *createThreadPool(const int *cpus, int cpuCount);
+
+/*
+ * Stops every worker once its queued jobs are done, and releases the pool.
+ * @Param pool: The pool to destroy.
+ */
+void destroyThreadPool(ThreadPool *pool);
+
+/*
+ * Prepares a job for submission.
+ * @Param job: The job to prepare.
+ * @Param func: The function the worker runs.
+ * @Param arg: Passed to func, its return value ends up in job->result.
+ */
+void initJob(PoolJob *job, void *(*func)(void *), void *arg);
+
+/*
+ * Queues a job on the worker pinned to a CPU.  Never blocks.
+ * @Param pool: The pool to submit to.
+ * @Param cpu: The CPU ID the job has to run on.
+ * @Param job: A job prepared with initJob.
+ * @Return: 0 if queued, -1 if the pool has no worker on that CPU or its queue is full.
+ */
+int submitJob(ThreadPool *pool, int cpu, PoolJob *job);
+
+/*
+ * Waits for a job to finish, spinning briefly before sleeping.
+ * @Param job: A submitted job.
+ * @Return: The value returned by the job's function.
+ */
+void *waitJob(PoolJob *job);
+
+/*
+ * Prepares a barrier for a fixed number of threads.  The barrier resets itself, so it can be reused.
+ * @Param barrier: The barrier to prepare.
+ * @Param count: Number of threads that have to arrive before any of them leave.
+ */
+void initSpinBarrier(SpinBarrier *barrier, uint32_t count);
+
+/*
+ * Busy waits until every thread has arrived.  Never sleeps, so only use it between threads on different CPUs.
+ * @Param barrier: A barrier prepared with initSpinBarrier.
+ */
+void spinBarrierWait(SpinBarrier *barrier);
+
+#endif // THREADPOOL_H
@@ -1,14 +1,132 @@
 #include <time.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <timing.h>
+#include <storage.h>
+
+#ifdef TIMER_HAS_TSC
+#include <cpuid.h>
+#endif
 
 /*
  * Program Name: CnC Common Headers
  * File Name: timing.c
  * Date Created: November 11, 2024
- * Date Updated: November 11, 2024
- * Version: 0.1
- * Purpose: Provides a function to time the execution of the passed in function.
+ * Date Updated: October 18, 2026
+ * Version: 0.3
+ * Purpose: Provides functions to time the execution of the passed in function, once or statistically.
+ */
+
+#define CALIBRATION_ROUNDS 5
+#define CALIBRATION_WINDOW_NS 20000000ULL
+#define OVERHEAD_SAMPLES 10000
+#define STABILITY_CHECK_INTERVAL 8 //How many samples runBenchmark takes between stability checks
+
+static uint64_t rawClockNs()
+{
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+#ifdef TIMER_HAS_TSC
+/*
+ * Reads the TSC frequency straight from CPUID leaf 0x15 when the CPU enumerates it.
+ * @Return: Ticks per nanosecond, or 0 if the leaf is missing or incomplete.
+ */
+static double cpuidTscFrequency()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 0x15)
+        return 0;
+    __cpuid(0x15, eax, ebx, ecx, edx);
+    if (eax == 0 || ebx == 0 || ecx == 0)
+        return 0;
+    return (double) ecx * ebx / eax / 1e9;
+}
+
+/*
+ * Measures TSC ticks against CLOCK_MONOTONIC_RAW over several short windows and keeps the median.
+ * @Return: Ticks per nanosecond.
  */
+static double measureTscFrequency()
+{
+    double rates[CALIBRATION_ROUNDS];
+    for (int round = 0; round < CALIBRATION_ROUNDS; round++) {
+        uint64_t clockStart = rawClockNs();
+        uint64_t tscStart = __rdtsc();
+        uint64_t clockEnd, tscEnd;
+        do {
+            clockEnd = rawClockNs();
+            tscEnd = __rdtsc();
+        } while (clockEnd - clockStart < CALIBRATION_WINDOW_NS);
+        rates[round] = (double) (tscEnd - tscStart) / (double) (clockEnd - clockStart);
+    }
+
+    qsort(rates, CALIBRATION_ROUNDS, sizeof(double), compareDoubles);
+    return rates[CALIBRATION_ROUNDS / 2];
+}
+#endif
+
+int calibrateTimer(TimerInfo *timer)
+{
+    timer->backend = TIMER_BACKEND_CLOCK;
+    timer->hasRdtscp = 0;
+    timer->ticksPerNs = 1.0;
+    timer->overheadTicks = 0;
+
+#ifdef TIMER_HAS_TSC
+    // Only trust the TSC if it ticks at a constant rate through frequency and power state changes
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8))) {
+        __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+        timer->hasRdtscp = (edx & (1 << 27)) != 0;
+
+        // CPUID can describe the crystal without being exact about it, so only use it when it agrees with a measurement
+        double measured = measureTscFrequency();
+        double enumerated = cpuidTscFrequency();
+        if (enumerated > 0 && enumerated > measured * 0.999 && enumerated < measured * 1.001)
+            timer->ticksPerNs = enumerated;
+        else
+            timer->ticksPerNs = measured;
+        timer->backend = TIMER_BACKEND_TSC;
+    }
+#endif
+
+    // The cheapest back to back read is the fixed cost every measurement pays
+    uint64_t overhead = UINT64_MAX;
+    for (int i = 0; i < OVERHEAD_SAMPLES; i++) {
+        uint64_t begin = timerBegin(timer);
+        uint64_t end = timerEnd(timer);
+        if (end - begin < overhead)
+            overhead = end - begin;
+    }
+    timer->overheadTicks = overhead;
+
+    return timer->backend;
+}
+
+void timerElapsed(const TimerInfo *timer, uint64_t begin, uint64_t end, TimerResult *result)
+{
+    uint64_t ticks = (end > begin) ? end - begin : 0;
+    ticks = (ticks > timer->overheadTicks) ? ticks - timer->overheadTicks : 0;
+
+    result->ticks = ticks;
+    result->nanoseconds = (double) ticks / timer->ticksPerNs;
+    result->referenceCycles = (timer->backend == TIMER_BACKEND_TSC) ? ticks : 0;
+}
 
 uint64_t timeExecution(void (*func)(int i), uint64_t iterations) {
     //Only execute on positive values for iterations
@@ -27,4 +145,163 @@ uint64_t timeExecution(void (*func)(int i), uint64_t iterations) {
     {
         return iterations;
     }
-}
\ No newline at end of file
+}
+
+uint64_t timeExecutionPrecise(void (*func)(int i), uint64_t iterations, const TimerInfo *timer, TimerResult *result)
+{
+    //Only execute on positive values for iterations, matching timeExecution
+    if (iterations == 0) {
+        result->ticks = 0;
+        result->nanoseconds = 0;
+        result->referenceCycles = 0;
+        return 0;
+    }
+
+    uint64_t begin = timerBegin(timer);
+    func(iterations);
+    uint64_t end = timerEnd(timer);
+    timerElapsed(timer, begin, end, result);
+    return (uint64_t) result->nanoseconds;
+}
+
+/*
+ * Two sided 95% Student's t critical values for 1 to 30 degrees of freedom, the normal value is used past that.
+ */
+static double tCritical95(uint32_t degreesOfFreedom)
+{
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degreesOfFreedom == 0)
+        return INFINITY;
+    return (degreesOfFreedom <= 30) ? table[degreesOfFreedom - 1] : 1.960;
+}
+
+/*
+ * Linearly interpolated percentile of an already sorted list.
+ */
+static double sortedPercentile(const double *sorted, uint32_t count, double percentile)
+{
+    double position = percentile / 100.0 * (count - 1);
+    uint32_t lower = (uint32_t) position;
+    if (lower + 1 >= count)
+        return sorted[count - 1];
+    return sorted[lower] + (position - lower) * (sorted[lower + 1] - sorted[lower]);
+}
+
+void computeStats(const double *samples, uint32_t count, double outlierMADs, BenchmarkStats *stats, uint8_t *outlierMask)
+{
+    memset(stats, 0, sizeof(BenchmarkStats));
+    stats->sampleCount = count;
+    if (count == 0)
+        return;
+
+    double *sorted = malloc(count * sizeof(double));
+    if (sorted == NULL)
+        return;
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compareDoubles);
+
+    // The median absolute deviation stays put when a few samples are wildly off, unlike the standard deviation
+    double lowerBound = -INFINITY, upperBound = INFINITY;
+    if (outlierMADs > 0 && count >= 3) {
+        double median = sortedPercentile(sorted, count, 50);
+        double *deviations = malloc(count * sizeof(double));
+        if (deviations != NULL) {
+            for (uint32_t i = 0; i < count; i++)
+                deviations[i] = fabs(sorted[i] - median);
+            qsort(deviations, count, sizeof(double), compareDoubles);
+            // 1.4826 scales the MAD to a standard deviation for normally distributed samples
+            double mad = 1.4826 * sortedPercentile(deviations, count, 50);
+            free(deviations);
+            if (mad > 0) {
+                lowerBound = median - outlierMADs * mad;
+                upperBound = median + outlierMADs * mad;
+            }
+        }
+    }
+
+    // Inliers are contiguous in the sorted list
+    uint32_t first = 0, last = count;
+    while (first < count && sorted[first] < lowerBound)
+        first++;
+    while (last > first && sorted[last - 1] > upperBound)
+        last--;
+    uint32_t inliers = last - first;
+    stats->outlierCount = count - inliers;
+    if (outlierMask != NULL)
+        for (uint32_t i = 0; i < count; i++)
+            outlierMask[i] = (samples[i] < lowerBound || samples[i] > upperBound);
+
+    if (inliers != 0) {
+        const double *kept = sorted + first;
+        double sum = 0, squares = 0;
+        for (uint32_t i = 0; i < inliers; i++)
+            sum += kept[i];
+        stats->mean = sum / inliers;
+        for (uint32_t i = 0; i < inliers; i++)
+            squares += (kept[i] - stats->mean) * (kept[i] - stats->mean);
+        stats->stddev = (inliers > 1) ? sqrt(squares / (inliers - 1)) : 0;
+        stats->min = kept[0];
+        stats->median = sortedPercentile(kept, inliers, 50);
+        stats->p90 = sortedPercentile(kept, inliers, 90);
+        stats->p99 = sortedPercentile(kept, inliers, 99);
+        stats->ciHalfWidth = (inliers > 1) ? tCritical95(inliers - 1) * stats->stddev / sqrt(inliers) : INFINITY;
+    }
+
+    free(sorted);
+}
+
+int runBenchmark(void (*func)(int i), const BenchmarkConfig *config, const TimerInfo *timer, BenchmarkStats *stats)
+{
+    uint32_t maxSamples = (config->maxSamples > 0) ? config->maxSamples : 1;
+    uint32_t minSamples = (config->minSamples < 2) ? 2 : config->minSamples;
+    double *samples = malloc(maxSamples * sizeof(double));
+    if (samples == NULL)
+        return -1;
+
+    for (uint32_t i = 0; i < config->warmupRuns; i++)
+        func(config->iterations);
+
+    uint32_t count = 0;
+    uint8_t stable = 0;
+    TimerResult elapsed;
+    while (count < maxSamples && !stable) {
+        timeExecutionPrecise(func, config->iterations, timer, &elapsed);
+        samples[count++] = elapsed.nanoseconds;
+
+        // Re-sorting on every sample would dominate long runs, so only check every few samples
+        if (count >= minSamples && (count - minSamples) % STABILITY_CHECK_INTERVAL == 0) {
+            computeStats(samples, count, config->outlierMADs, stats, NULL);
+            stable = stats->mean > 0 && stats->ciHalfWidth <= config->targetRelativeCI * stats->mean;
+        }
+    }
+
+    uint8_t *outliers = malloc(count);
+    computeStats(samples, count, config->outlierMADs, stats, outliers);
+    stats->stable = stable;
+
+    int status = (outliers == NULL) ? -1 : 0;
+    if (status == 0 && config->outFile != NULL) {
+        // One row per sample: the raw time, and whether it was rejected
+        char names[2][256] = { "SampleNs", "Outlier" };
+        double *rows = malloc(count * 2 * sizeof(double));
+        if (rows == NULL)
+            status = -1;
+        else {
+            for (uint32_t i = 0; i < count; i++) {
+                rows[2 * i] = samples[i];
+                rows[2 * i + 1] = outliers[i];
+            }
+            if (write_CNC(config->outFile, rows, count * 2, 2, names) != 0)
+                status = -1;
+            free(rows);
+        }
+    }
+
+    free(outliers);
+    free(samples);
+    return status;
+}
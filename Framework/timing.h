@@ -4,19 +4,189 @@
  * Program Name: CnC Common Headers
  * File Name: timing.h
  * Date Created: January 24, 2024
- * Date Updated: November 11, 2024
- * Version: 0.6
+ * Date Updated: October 18, 2026
+ * Version: 0.8
  * Purpose: Provides header functionality to timing.c
  */
 
 #include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAS_TSC 1
+#endif
 
 //DO NOT DECLARE GLOBALS
 
+#define TIMER_BACKEND_CLOCK 0 // clock_gettime(CLOCK_MONOTONIC), one tick per nanosecond
+#define TIMER_BACKEND_TSC 1   // Invariant TSC, one tick per reference cycle
+
+/*
+ * Describes the timer picked by calibrateTimer.  Calibrate once at startup and pass the struct to every
+ * reader, the timer functions below are inline so they add as little as possible to the timed region.
+ */
+typedef struct TimerInfo {
+    uint8_t backend;
+    uint8_t hasRdtscp;
+    double ticksPerNs;      // 1 for the clock backend
+    uint64_t overheadTicks; // Cost of an empty timerBegin/timerEnd pair, subtracted by timerElapsed
+} TimerInfo;
+
+typedef struct TimerResult {
+    uint64_t ticks;           // Elapsed ticks with the timer overhead removed
+    double nanoseconds;
+    uint64_t referenceCycles; // Same as ticks on the TSC backend, 0 when the clock backend is in use
+} TimerResult;
+
+/*
+ * Picks the best available timer, measures its frequency against CLOCK_MONOTONIC_RAW and its overhead.
+ * The TSC is only used when CPUID reports it as invariant, otherwise clock_gettime is used.
+ * @Param timer: The struct to fill in.
+ * @Return: The backend that was selected.
+ */
+int calibrateTimer(TimerInfo *timer);
+
+/*
+ * Reads the timer at the start of a timed region.  The fences keep earlier work from leaking into the
+ * region and keep the region from starting before the read.
+ * @Param timer: A calibrated timer.
+ * @Return: The current tick count.
+ */
+static inline uint64_t timerBegin(const TimerInfo *timer)
+{
+#ifdef TIMER_HAS_TSC
+    if (timer->backend == TIMER_BACKEND_TSC) {
+        _mm_lfence();
+        uint64_t ticks = __rdtsc();
+        _mm_lfence();
+        return ticks;
+    }
+#endif
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Reads the timer at the end of a timed region.  rdtscp waits for the region to finish, and the trailing
+ * fence keeps later work from being pulled in before the read.
+ * @Param timer: A calibrated timer.
+ * @Return: The current tick count.
+ */
+static inline uint64_t timerEnd(const TimerInfo *timer)
+{
+#ifdef TIMER_HAS_TSC
+    if (timer->backend == TIMER_BACKEND_TSC) {
+        uint64_t ticks;
+        if (timer->hasRdtscp) {
+            unsigned int aux;
+            ticks = __rdtscp(&aux);
+        }
+        else {
+            _mm_lfence();
+            ticks = __rdtsc();
+        }
+        _mm_lfence();
+        return ticks;
+    }
+#endif
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Reads the timer without any fencing.  Meant for sampling inside a measured loop, where a fence would
+ * change the timing of the loop itself.  Pair it with another timerRead, not with timerBegin/timerEnd.
+ * @Param timer: A calibrated timer.
+ * @Return: The current tick count.
+ */
+static inline uint64_t timerRead(const TimerInfo *timer)
+{
+#ifdef TIMER_HAS_TSC
+    if (timer->backend == TIMER_BACKEND_TSC)
+        return __rdtsc();
+#endif
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Converts a begin/end pair into elapsed time, with the calibrated timer overhead subtracted.
+ * @Param timer: The timer both readings came from.
+ * @Param begin: Value returned by timerBegin.
+ * @Param end: Value returned by timerEnd.
+ * @Param result: Receives ticks, nanoseconds and reference cycles.
+ */
+void timerElapsed(const TimerInfo *timer, uint64_t begin, uint64_t end, TimerResult *result);
+
 /* 
  * @Param func: The pointer of the function being timed.
  * @Return: Time in nanoseconds (up to nanosecond precision).
  */
 uint64_t timeExecution(void (*func)(int i), uint64_t iterations);
 
+/*
+ * Same as timeExecution, but times with the calibrated timer and reports both nanoseconds and reference cycles.
+ * @Param func: The pointer of the function being timed.
+ * @Param iterations: Passed through to func, nothing is timed for zero.
+ * @Param timer: A calibrated timer.
+ * @Param result: Receives the elapsed time.
+ * @Return: Time in nanoseconds, rounded down.
+ */
+uint64_t timeExecutionPrecise(void (*func)(int i), uint64_t iterations, const TimerInfo *timer, TimerResult *result);
+
+/*
+ * Settings for runBenchmark.  Sampling stops as soon as the confidence interval target is met after
+ * minSamples, or at maxSamples, whichever comes first.
+ */
+typedef struct BenchmarkConfig {
+    uint64_t iterations;     // Passed to func for every sample
+    uint32_t warmupRuns;     // Untimed runs before sampling starts
+    uint32_t minSamples;
+    uint32_t maxSamples;
+    double targetRelativeCI; // Stop once the 95% CI half width of the mean is within this fraction of the mean
+    double outlierMADs;      // Samples further than this many median absolute deviations from the median are rejected, 0 keeps all
+    char *outFile;           // All samples are written here through write_CNC, NULL to skip
+} BenchmarkConfig;
+
+/*
+ * Summary of a set of samples.  Everything except sampleCount and outlierCount is computed over the
+ * samples that were not rejected as outliers.
+ */
+typedef struct BenchmarkStats {
+    uint32_t sampleCount;
+    uint32_t outlierCount;
+    uint8_t stable;          // Set when targetRelativeCI was met before maxSamples ran out
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double p90;
+    double p99;
+    double ciHalfWidth;      // 95% confidence interval half width of the mean
+} BenchmarkStats;
+
+/*
+ * Computes summary statistics over a set of samples.
+ * @Param samples: The samples, left untouched.
+ * @Param count: Number of samples.
+ * @Param outlierMADs: Outlier rejection threshold, see BenchmarkConfig.
+ * @Param stats: Receives the summary, stable is left cleared.
+ * @Param outlierMask: Optional, receives 1 for every rejected sample and 0 otherwise.
+ */
+void computeStats(const double *samples, uint32_t count, double outlierMADs, BenchmarkStats *stats, uint8_t *outlierMask);
+
+/*
+ * Repeatedly times func with the calibrated timer until the mean is stable.
+ * @Param func: The pointer of the function being timed.
+ * @Param config: Warmup, sample and stopping settings.
+ * @Param timer: A calibrated timer.
+ * @Param stats: Receives the summary in nanoseconds per call of func.
+ * @Return: 0 if successful, -1 if memory could not be allocated or the samples could not be written.
+ */
+int runBenchmark(void (*func)(int i), const BenchmarkConfig *config, const TimerInfo *timer, BenchmarkStats *stats);
+
 #endif // TIMING_H